@@ -0,0 +1,368 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/*
+ * Fuzzer and micro-benchmark for the bit field kernels of
+ * src/helper/binarybuffer.c.  It checks buf_set_buf(), buf_cmp(),
+ * buf_cmp_mask(), buf_get_u32() and buf_set_u32() against the original
+ * bit at a time implementations kept below, then times both versions.
+ * Built from the top of the source tree:
+ *
+ *   cc -O2 -Isrc -o binarybuffer_bench contrib/binarybuffer_bench.c
+ *   ./binarybuffer_bench [iterations [seed]]
+ *
+ * buf_set_buf() is checked on random offsets and lengths, including the
+ * bytes around the destination field, which must be left untouched.  The
+ * first mismatch is printed and the exit status is 1.
+ */
+
+#define HAVE_SYS_TYPES_H
+#define HAVE_STDINT_H
+#define HAVE_INTTYPES_H
+#define HAVE_STDBOOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+/* binarybuffer.c logs nothing, so keep helper/log.h and with it Jim out */
+#define ERROR_H
+#include "helper/binarybuffer.c"
+
+#define BUF_BYTES	512
+#define BUF_BITS	(BUF_BYTES * 8)
+
+/* the kernels as they were, one bit per iteration */
+
+static void *ref_buf_set_buf(const void *_src, unsigned src_start,
+		void *_dst, unsigned dst_start, unsigned len)
+{
+	const uint8_t *src = _src;
+	uint8_t *dst = _dst;
+
+	unsigned src_idx = src_start, dst_idx = dst_start;
+	for (unsigned i = 0; i < len; i++)
+	{
+		if (((src[src_idx / 8] >> (src_idx % 8)) & 1) == 1)
+			dst[dst_idx / 8] |= 1 << (dst_idx % 8);
+		else
+			dst[dst_idx / 8] &= ~(1 << (dst_idx % 8));
+		dst_idx++;
+		src_idx++;
+	}
+
+	return dst;
+}
+
+static bool ref_buf_cmp_mask(const void *_buf1, const void *_buf2,
+		const void *_mask, unsigned size)
+{
+	const uint8_t *buf1 = _buf1, *buf2 = _buf2, *mask = _mask;
+	unsigned last = size / 8;
+	for (unsigned i = 0; i < last; i++)
+	{
+		if (buf_cmp_masked(buf1[i], buf2[i], mask[i]))
+			return true;
+	}
+	unsigned trailing = size % 8;
+	if (!trailing)
+		return false;
+	return buf_cmp_trailing(buf1[last], buf2[last], mask[last], trailing);
+}
+
+/* bit by bit, the old buf_cmp() missed differences in whole bytes */
+static bool ref_buf_cmp(const void *_buf1, const void *_buf2, unsigned size)
+{
+	const uint8_t *buf1 = _buf1, *buf2 = _buf2;
+	for (unsigned i = 0; i < size; i++)
+	{
+		if (((buf1[i / 8] ^ buf2[i / 8]) >> (i % 8)) & 1)
+			return true;
+	}
+	return false;
+}
+
+static void ref_buf_set_u32(void *_buffer, unsigned first, unsigned num, uint32_t value)
+{
+	uint8_t *buffer = _buffer;
+
+	for (unsigned i = first; i < first + num; i++)
+	{
+		if (((value >> (i - first)) & 1) == 1)
+			buffer[i / 8] |= 1 << (i % 8);
+		else
+			buffer[i / 8] &= ~(1 << (i % 8));
+	}
+}
+
+static uint32_t ref_buf_get_u32(const void *_buffer, unsigned first, unsigned num)
+{
+	const uint8_t *buffer = _buffer;
+	uint32_t result = 0;
+
+	for (unsigned i = first; i < first + num; i++)
+	{
+		if (((buffer[i / 8] >> (i % 8)) & 1) == 1)
+			result |= (uint32_t)1 << (i - first);
+	}
+	return result;
+}
+
+static uint64_t rng_state;
+
+static uint32_t rng(void)
+{
+	/* xorshift64*, good enough and the same on every host */
+	rng_state ^= rng_state >> 12;
+	rng_state ^= rng_state << 25;
+	rng_state ^= rng_state >> 27;
+	return (rng_state * 2685821657736338717ULL) >> 32;
+}
+
+static void rng_fill(uint8_t *buf, unsigned len)
+{
+	for (unsigned i = 0; i < len; i++)
+		buf[i] = rng();
+}
+
+/* mostly short fields, as scans have, sometimes anything up to max */
+static unsigned rng_len(unsigned max)
+{
+	if (max == 0)
+		return 0;
+	if (rng() % 4)
+		return rng() % (max < 70 ? max + 1 : 70);
+	return rng() % (max + 1);
+}
+
+static unsigned rng_mask_byte(void)
+{
+	/* masks are mostly all ones or all zeroes */
+	switch (rng() % 4)
+	{
+	case 0:
+		return 0x00;
+	case 1:
+		return rng() & 0xff;
+	default:
+		return 0xff;
+	}
+}
+
+static int fuzz(unsigned long iterations)
+{
+	static uint8_t src[BUF_BYTES], dst[BUF_BYTES], ref[BUF_BYTES];
+	static uint8_t b1[BUF_BYTES], b2[BUF_BYTES], mask[BUF_BYTES];
+
+	for (unsigned long n = 0; n < iterations; n++)
+	{
+		unsigned src_start = rng() % BUF_BITS;
+		unsigned dst_start = rng() % BUF_BITS;
+		unsigned max = BUF_BITS - (src_start > dst_start ? src_start : dst_start);
+		unsigned len = rng_len(max);
+
+		/* aligned cases take another path, make sure they are covered */
+		if (rng() % 8 == 0)
+			src_start &= ~7u;
+		if (rng() % 8 == 0)
+			dst_start &= ~7u;
+
+		rng_fill(src, BUF_BYTES);
+		rng_fill(dst, BUF_BYTES);
+		memcpy(ref, dst, BUF_BYTES);
+
+		ref_buf_set_buf(src, src_start, ref, dst_start, len);
+		buf_set_buf(src, src_start, dst, dst_start, len);
+		if (memcmp(dst, ref, BUF_BYTES) != 0)
+		{
+			printf("buf_set_buf mismatch: src_start %u dst_start %u len %u\n",
+					src_start, dst_start, len);
+			return 1;
+		}
+
+		unsigned size = rng_len(BUF_BITS);
+		rng_fill(b1, BUF_BYTES);
+		memcpy(b2, b1, BUF_BYTES);
+		for (unsigned i = 0; i < BUF_BYTES; i++)
+			mask[i] = rng_mask_byte();
+		/* flip a few bits, sometimes none */
+		for (unsigned i = rng() % 3; i; i--)
+		{
+			unsigned bit = rng() % BUF_BITS;
+			b2[bit / 8] ^= 1 << (bit % 8);
+		}
+
+		if (buf_cmp(b1, b2, size) != ref_buf_cmp(b1, b2, size))
+		{
+			printf("buf_cmp mismatch: size %u\n", size);
+			return 1;
+		}
+		if (buf_cmp_mask(b1, b2, mask, size) != ref_buf_cmp_mask(b1, b2, mask, size))
+		{
+			printf("buf_cmp_mask mismatch: size %u\n", size);
+			return 1;
+		}
+
+		unsigned first = rng() % (BUF_BITS - 32);
+		unsigned num = rng() % 33;
+		uint32_t value = rng();
+
+		if (buf_get_u32(src, first, num) != ref_buf_get_u32(src, first, num))
+		{
+			printf("buf_get_u32 mismatch: first %u num %u\n", first, num);
+			return 1;
+		}
+
+		memcpy(ref, dst, BUF_BYTES);
+		ref_buf_set_u32(ref, first, num, value);
+		buf_set_u32(dst, first, num, value);
+		if (memcmp(dst, ref, BUF_BYTES) != 0)
+		{
+			printf("buf_set_u32 mismatch: first %u num %u\n", first, num);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static double now_usec(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+/* defeats dead code elimination of the timed calls */
+static volatile unsigned sink;
+
+#define BENCH_REPEAT	2000
+#define BENCH_BITS		30000
+/* room for the field at any offset below eight */
+#define BENCH_BYTES		(BENCH_BITS / 8 + 2)
+
+static void bench_set_buf(const char *name, unsigned src_start, unsigned dst_start)
+{
+	static uint8_t src[BENCH_BYTES], dst[BENCH_BYTES];
+	double t0, t_ref, t_new;
+
+	rng_fill(src, sizeof(src));
+
+	t0 = now_usec();
+	for (unsigned i = 0; i < BENCH_REPEAT; i++)
+	{
+		ref_buf_set_buf(src, src_start, dst, dst_start, BENCH_BITS);
+		sink += dst[i % sizeof(dst)];
+	}
+	t_ref = now_usec() - t0;
+
+	t0 = now_usec();
+	for (unsigned i = 0; i < BENCH_REPEAT; i++)
+	{
+		buf_set_buf(src, src_start, dst, dst_start, BENCH_BITS);
+		sink += dst[i % sizeof(dst)];
+	}
+	t_new = now_usec() - t0;
+
+	printf("buf_set_buf %-9s %u bits: %8.2f us old, %8.2f us new, %6.1fx\n",
+			name, BENCH_BITS, t_ref / BENCH_REPEAT, t_new / BENCH_REPEAT,
+			t_ref / t_new);
+}
+
+static void bench_cmp_mask(void)
+{
+	static uint8_t b1[BENCH_BYTES], b2[BENCH_BYTES], mask[BENCH_BYTES];
+	double t0, t_ref, t_new;
+
+	rng_fill(b1, sizeof(b1));
+	memcpy(b2, b1, sizeof(b2));
+	memset(mask, 0xff, sizeof(mask));
+
+	/* equal buffers, so both walk the whole length */
+	t0 = now_usec();
+	for (unsigned i = 0; i < BENCH_REPEAT; i++)
+		sink += ref_buf_cmp_mask(b1, b2, mask, BENCH_BITS);
+	t_ref = now_usec() - t0;
+
+	t0 = now_usec();
+	for (unsigned i = 0; i < BENCH_REPEAT; i++)
+		sink += buf_cmp_mask(b1, b2, mask, BENCH_BITS);
+	t_new = now_usec() - t0;
+
+	printf("buf_cmp_mask          %u bits: %8.2f us old, %8.2f us new, %6.1fx\n",
+			BENCH_BITS, t_ref / BENCH_REPEAT, t_new / BENCH_REPEAT,
+			t_ref / t_new);
+}
+
+#define BENCH_U32_REPEAT	10000000
+
+static void bench_u32(void)
+{
+	static uint8_t buf[16];
+	double t0, t_ref, t_new;
+
+	rng_fill(buf, sizeof(buf));
+
+	/* unaligned 32 bit fields, the byte aligned case was always fast */
+	t0 = now_usec();
+	for (unsigned i = 0; i < BENCH_U32_REPEAT; i++)
+	{
+		unsigned first = 1 + i % 64;
+		ref_buf_set_u32(buf, first, 32, ref_buf_get_u32(buf, first + 1, 32) + i);
+	}
+	t_ref = now_usec() - t0;
+	sink += buf[0];
+
+	t0 = now_usec();
+	for (unsigned i = 0; i < BENCH_U32_REPEAT; i++)
+	{
+		unsigned first = 1 + i % 64;
+		buf_set_u32(buf, first, 32, buf_get_u32(buf, first + 1, 32) + i);
+	}
+	t_new = now_usec() - t0;
+	sink += buf[0];
+
+	printf("buf_get/set_u32 unaligned pair: %8.2f ns old, %8.2f ns new, %6.1fx\n",
+			t_ref * 1000 / BENCH_U32_REPEAT, t_new * 1000 / BENCH_U32_REPEAT,
+			t_ref / t_new);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long iterations = 1000000;
+
+	rng_state = 0x9e3779b97f4a7c15ULL;
+	if (argc > 1)
+		iterations = strtoul(argv[1], NULL, 0);
+	if (argc > 2)
+		rng_state = strtoull(argv[2], NULL, 0) | 1;
+
+	if (fuzz(iterations))
+		return 1;
+	printf("fuzz: %lu iterations passed\n", iterations);
+
+	bench_set_buf("aligned", 0, 0);
+	bench_set_buf("src +3", 3, 0);
+	bench_set_buf("dst +5", 0, 5);
+	bench_set_buf("both +3", 3, 3);
+	bench_set_buf("3 to 6", 3, 6);
+	bench_cmp_mask();
+	bench_u32();
+
+	return 0;
+}
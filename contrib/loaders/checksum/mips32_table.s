@@ -0,0 +1,125 @@
+/***************************************************************************
+ *   Copyright (C) 2010 by Spencer Oliver                                  *
+ *   spen@spen-soft.co.uk                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+	.global main
+	.text
+	.set noreorder
+	.set noat
+
+/* Table driven crc32, same result as the bit serial mips32.s.
+ * Aligned words are loaded whole and fed to the table msb first,
+ * unaligned head and tail bytes go through the table one by one.
+ *
+ * params:
+ * $a0 address in
+ * $a1 byte count
+ * $a2 crc table, 256 words in target endianness
+ * $a3 0 on big endian targets, otherwise words are byte swapped
+ *
+ * result:
+ * $v0 crc
+ *
+ * temps:
+ * $t0, $t1, $t3
+ */
+
+.ent main
+main:
+	addiu	$v0, $zero, -1
+
+bytes:
+	beq		$a1, $zero, done
+	andi	$t0, $a0, 3
+	bne		$t0, $zero, byte	/* unaligned */
+	sltiu	$t0, $a1, 4
+	beq		$t0, $zero, word	/* at least one word left */
+	nop
+
+byte:
+	lbu		$t0, 0($a0)
+	addiu	$a0, $a0, 1
+	addiu	$a1, $a1, -1
+	srl		$t1, $v0, 24
+	xor		$t1, $t1, $t0
+	sll		$t1, $t1, 2
+	addu	$t1, $t1, $a2
+	lw		$t1, 0($t1)
+	sll		$v0, $v0, 8
+	b		bytes
+	xor		$v0, $v0, $t1
+
+word:
+	lw		$t0, 0($a0)
+	beq		$a3, $zero, msb
+	addiu	$a0, $a0, 4
+
+	/* little endian, first byte to the msb */
+	srl		$t3, $t0, 24
+	srl		$t1, $t0, 8
+	andi	$t1, $t1, 0xff00
+	or		$t3, $t3, $t1
+	andi	$t1, $t0, 0xff00
+	sll		$t1, $t1, 8
+	or		$t3, $t3, $t1
+	sll		$t1, $t0, 24
+	or		$t0, $t3, $t1
+
+msb:
+	xor		$v0, $v0, $t0
+
+	srl		$t1, $v0, 24
+	sll		$t1, $t1, 2
+	addu	$t1, $t1, $a2
+	lw		$t1, 0($t1)
+	sll		$v0, $v0, 8
+	xor		$v0, $v0, $t1
+
+	srl		$t1, $v0, 24
+	sll		$t1, $t1, 2
+	addu	$t1, $t1, $a2
+	lw		$t1, 0($t1)
+	sll		$v0, $v0, 8
+	xor		$v0, $v0, $t1
+
+	srl		$t1, $v0, 24
+	sll		$t1, $t1, 2
+	addu	$t1, $t1, $a2
+	lw		$t1, 0($t1)
+	sll		$v0, $v0, 8
+	xor		$v0, $v0, $t1
+
+	srl		$t1, $v0, 24
+	sll		$t1, $t1, 2
+	addu	$t1, $t1, $a2
+	lw		$t1, 0($t1)
+	sll		$v0, $v0, 8
+	xor		$v0, $v0, $t1
+
+	addiu	$a1, $a1, -4
+	sltiu	$t0, $a1, 4
+	beq		$t0, $zero, word
+	nop
+	b		bytes
+	nop
+
+done:
+	sdbbp
+
+.end main
@@ -0,0 +1,78 @@
+/***************************************************************************
+ *   Copyright (C) 2010 by Spencer Oliver                                  *
+ *   spen@spen-soft.co.uk                                                  *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+	.global main
+	.text
+	.set noreorder
+	.set noat
+
+/* Blank check, ands the region into one word.
+ * Aligned words are checked whole, unaligned head and tail bytes one by
+ * one. Stops at the first word that is not all ones.
+ *
+ * params:
+ * $a0 address in
+ * $a1 byte count
+ *
+ * result:
+ * $v0 and of all words, folded to a byte by the debugger
+ *
+ * temps:
+ * $t0, $t1
+ */
+
+.ent main
+main:
+	addiu	$v0, $zero, -1
+
+bytes:
+	beq		$a1, $zero, done
+	andi	$t0, $a0, 3
+	bne		$t0, $zero, byte	/* unaligned */
+	sltiu	$t0, $a1, 4
+	beq		$t0, $zero, word	/* at least one word left */
+	nop
+
+byte:
+	lbu		$t0, 0($a0)
+	addiu	$a0, $a0, 1
+	addiu	$a1, $a1, -1
+	addiu	$t1, $zero, -256
+	or		$t0, $t0, $t1
+	b		bytes
+	and		$v0, $v0, $t0
+
+word:
+	lw		$t0, 0($a0)
+	addiu	$a0, $a0, 4
+	addiu	$a1, $a1, -4
+	and		$v0, $v0, $t0
+	addiu	$t1, $v0, 1
+	bne		$t1, $zero, done	/* not all ones */
+	sltiu	$t0, $a1, 4
+	beq		$t0, $zero, word
+	nop
+	b		bytes
+	nop
+
+done:
+	sdbbp
+
+.end main
@@ -123,7 +123,7 @@ waitflash:
 	nop
 	/* check for errors */
 	lw		$s1, 0($t2)
-	andi	$s1, $zero, 0x3000
+	andi	$s1, $s1, 0x3000
 	bne		$s1, $zero, error
 	sw		$t5, 4($t2)		/* clear NVMWREN */
 	jr		$ra
@@ -0,0 +1,161 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+	.text
+	.arch m4k
+	.set noreorder
+	.set noat
+
+/* Debug mode stream loader, see mips32_pracc_fastdata_stream().
+ * Runs once per row: the row is taken from the fastdata area into a ram
+ * buffer, then the previous row is waited for and the new one started.
+ * A row write returns while the row is programmed, so the host streams
+ * the next row meanwhile. Shorter runs are written word by word.
+ * A run without data waits for the last row and clears NVMWREN.
+ *
+ * params:
+ * $t0 fastdata area
+ * $t1 ram buffer start - virtual addr
+ * $t2 ram buffer end
+ * $t3 dest adr - flash, real addr
+ * $t4 NVMCON row (0x4003) or word (0x4001) write cmd
+ *
+ * result:
+ * NVMCON, stored to the debug segment (param out)
+ *
+ * temps:
+ * $t5, $t6, $t8, $t9
+ *
+ * the debugger saves $t0..$t6, $t8, $t9 in the 9 words below main,
+ * $t7 is restored from DeSave on the way back to the debug vector
+ */
+
+	.type main, @function
+	.global main
+
+.ent main
+main:
+	lui		$t6, 0xbf80
+	ori		$t6, 0xf400				/* NVMCON */
+	addu	$t9, $t1, $zero
+
+copy:
+	/* take the data from the probe */
+	beq		$t9, $t2, wait
+	nop
+	lw		$t8, 0($t0)
+	sw		$t8, 0($t9)
+	beq		$zero, $zero, copy
+	addiu	$t9, $t9, 4
+
+wait:
+	/* wait for a row still being programmed */
+	lw		$t5, 0($t6)
+	andi	$t8, $t5, 0x8000
+	bne		$t8, $zero, wait
+	nop
+
+	/* following is to comply with errata #34
+	 * 500ns delay required */
+	nop
+	nop
+	nop
+	nop
+	lw		$t5, 0($t6)				/* status of the previous row */
+
+	beq		$t1, $t2, finish		/* no data, just wait */
+	addu	$t9, $t1, $zero
+	ori		$t8, $zero, 0x4003
+	bne		$t4, $t8, word
+	nop
+
+	/* perform row write 512 bytes, don't wait for it */
+	lui		$t8, 0x1fff
+	ori		$t8, 0xffff
+	and		$t8, $t1, $t8			/* convert to real addr */
+	sw		$t8, 64($t6)	/* set NVMSRCADDR with src addr - real addr */
+	sw		$t3, 32($t6)	/* set NVMADDR with dest addr - real addr */
+	sw		$t4, 0($t6)		/* set NVMWREN */
+	lui		$t8, 0xaa99
+	ori		$t8, 0x6655
+	sw		$t8, 16($t6)	/* write NVMKEY1 */
+	lui		$t8, 0x5566
+	ori		$t8, 0x99aa
+	sw		$t8, 16($t6)	/* write NVMKEY2 */
+	ori		$t8, $zero, 0x8000
+	beq		$zero, $zero, done
+	sw		$t8, 8($t6)		/* start operation */
+
+word:
+	/* write 32bit words */
+	lw		$t8, 0($t9)		/* load data - from virtual addr */
+	sw		$t8, 48($t6)	/* set NVMDATA with data */
+	sw		$t3, 32($t6)	/* set NVMADDR with dest addr - real addr */
+	sw		$t4, 0($t6)		/* set NVMWREN */
+	lui		$t8, 0xaa99
+	ori		$t8, 0x6655
+	sw		$t8, 16($t6)	/* write NVMKEY1 */
+	lui		$t8, 0x5566
+	ori		$t8, 0x99aa
+	sw		$t8, 16($t6)	/* write NVMKEY2 */
+	ori		$t8, $zero, 0x8000
+	sw		$t8, 8($t6)		/* start operation */
+
+wait_word:
+	lw		$t5, 0($t6)
+	andi	$t8, $t5, 0x8000
+	bne		$t8, $zero, wait_word
+	nop
+
+	/* errata #34 */
+	nop
+	nop
+	nop
+	nop
+	/* check for errors */
+	lw		$t5, 0($t6)
+	andi	$t8, $t5, 0x3000
+	bne		$t8, $zero, done
+	addiu	$t3, $t3, 4
+	addiu	$t9, $t9, 4
+	bne		$t9, $t2, word
+	nop
+
+finish:
+	ori		$t8, $zero, 0x4000
+	sw		$t8, 4($t6)		/* clear NVMWREN */
+
+done:
+	sw		$t5, 0x2000($t0)		/* report NVMCON */
+
+	/* restore registers */
+	lw		$t0, -36($t7)
+	lw		$t1, -32($t7)
+	lw		$t2, -28($t7)
+	lw		$t3, -24($t7)
+	lw		$t4, -20($t7)
+	lw		$t5, -16($t7)
+	lw		$t6, -12($t7)
+	lw		$t8, -8($t7)
+	lw		$t9, -4($t7)
+
+	/* back to the debug vector */
+	lui		$t7, 0xff20
+	ori		$t7, 0x0200
+	jr		$t7
+	mfc0	$t7, $31				/* restore $t7 from DeSave */
+.end main
@@ -0,0 +1,613 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the
+ * Free Software Foundation, Inc.,
+ * 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/*
+ * Reference peer for the remote_jtag interface driver: it simulates a scan
+ * chain of TAPs, so the whole JTAG stack of OpenOCD can be exercised and
+ * benchmarked without hardware.  The protocol is described at the top of
+ * src/jtag/drivers/remote_jtag.c.
+ *
+ *   cc -O2 -o remote_jtag_sim remote_jtag_sim.c
+ *   ./remote_jtag_sim -t 4:0x4ba00477 -t 5:0x06413041:64
+ *
+ * Each -t irlen[:idcode[:drlen]] adds a TAP; as with "jtag newtap", the
+ * first one is closest to TDO.  Without -t the chain is a single Cortex-M3
+ * style TAP, "-t 4:0x4ba00477".
+ *
+ * Every TAP captures 0b01 into its IR.  After Test-Logic-Reset it selects
+ * IDCODE, or BYPASS if its idcode is 0.  Instruction 1 selects IDCODE, all
+ * ones BYPASS, and any other value a data register of drlen bits (32 by
+ * default) which captures the value last updated into it.
+ *
+ * Statistics are printed when the client disconnects.
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define VERSION			1
+
+#define CMD_HELLO		0x01
+#define CMD_SHIFT		0x02
+#define CMD_RESET		0x03
+
+#define SHIFT_TMS		(1 << 0)
+#define SHIFT_TDI		(1 << 1)
+#define SHIFT_TDO		(1 << 2)
+
+#define STATUS_OK		0
+#define STATUS_BAD_COMMAND	1
+#define STATUS_BAD_VERSION	2
+
+#define MAX_MESSAGE		(1 << 20)
+#define MAX_TAPS		32
+
+enum tap_state {
+	RESET, IDLE,
+	DRSELECT, DRCAPTURE, DRSHIFT, DREXIT1, DRPAUSE, DREXIT2, DRUPDATE,
+	IRSELECT, IRCAPTURE, IRSHIFT, IREXIT1, IRPAUSE, IREXIT2, IRUPDATE,
+};
+
+/* next state for TMS low and TMS high */
+static const enum tap_state next_state[16][2] = {
+	[RESET]     = { IDLE,      RESET },
+	[IDLE]      = { IDLE,      DRSELECT },
+	[DRSELECT]  = { DRCAPTURE, IRSELECT },
+	[DRCAPTURE] = { DRSHIFT,   DREXIT1 },
+	[DRSHIFT]   = { DRSHIFT,   DREXIT1 },
+	[DREXIT1]   = { DRPAUSE,   DRUPDATE },
+	[DRPAUSE]   = { DRPAUSE,   DREXIT2 },
+	[DREXIT2]   = { DRSHIFT,   DRUPDATE },
+	[DRUPDATE]  = { IDLE,      DRSELECT },
+	[IRSELECT]  = { IRCAPTURE, RESET },
+	[IRCAPTURE] = { IRSHIFT,   IREXIT1 },
+	[IRSHIFT]   = { IRSHIFT,   IREXIT1 },
+	[IREXIT1]   = { IRPAUSE,   IRUPDATE },
+	[IRPAUSE]   = { IRPAUSE,   IREXIT2 },
+	[IREXIT2]   = { IRSHIFT,   IRUPDATE },
+	[IRUPDATE]  = { IDLE,      DRSELECT },
+};
+
+/* A shift register of len bits kept as a ring: bit head leaves on TDO
+ * and is replaced by the bit coming from TDI, so shifting is O(1). */
+struct shift_reg {
+	uint8_t *bits;
+	unsigned len;
+	unsigned head;
+};
+
+struct tap {
+	unsigned irlen;
+	uint32_t idcode;
+	unsigned drlen;
+	uint32_t ir;
+	uint8_t *data;		/* value of the data register */
+	struct shift_reg ir_reg;
+	struct shift_reg dr_reg;
+	struct shift_reg *dr;	/* register selected by ir */
+	struct shift_reg bypass;
+	struct shift_reg id;
+};
+
+static struct tap taps[MAX_TAPS];
+static unsigned num_taps;
+static enum tap_state state = RESET;
+static bool verbose;
+
+static struct {
+	unsigned long messages;
+	unsigned long long cycles;
+	unsigned long long tdo_bits;
+	unsigned long long bytes_in;
+	unsigned long long bytes_out;
+} stats;
+
+static int get_bit(const uint8_t *buf, unsigned i)
+{
+	return (buf[i / 8] >> (i % 8)) & 1;
+}
+
+static void set_bit(uint8_t *buf, unsigned i, int value)
+{
+	if (value)
+		buf[i / 8] |= 1 << (i % 8);
+	else
+		buf[i / 8] &= ~(1 << (i % 8));
+}
+
+static void reg_init(struct shift_reg *reg, unsigned len)
+{
+	reg->len = len;
+	reg->head = 0;
+	reg->bits = calloc((len + 7) / 8, 1);
+	if (!reg->bits) {
+		perror("calloc");
+		exit(1);
+	}
+}
+
+static int reg_shift(struct shift_reg *reg, int in)
+{
+	int out = get_bit(reg->bits, reg->head);
+
+	set_bit(reg->bits, reg->head, in);
+	if (++reg->head == reg->len)
+		reg->head = 0;
+	return out;
+}
+
+static void reg_load(struct shift_reg *reg, const uint8_t *value)
+{
+	unsigned i;
+
+	reg->head = 0;
+	for (i = 0; i < reg->len; i++)
+		set_bit(reg->bits, i, get_bit(value, i));
+}
+
+static void reg_store(const struct shift_reg *reg, uint8_t *value)
+{
+	unsigned i;
+
+	for (i = 0; i < reg->len; i++)
+		set_bit(value, i, get_bit(reg->bits, (reg->head + i) % reg->len));
+}
+
+static uint32_t tap_bypass(const struct tap *tap)
+{
+	return (tap->irlen >= 32) ? 0xffffffff : ((1u << tap->irlen) - 1);
+}
+
+static void tap_select(struct tap *tap)
+{
+	if (tap->ir == tap_bypass(tap))
+		tap->dr = &tap->bypass;
+	else if (tap->ir == 1 && tap->idcode)
+		tap->dr = &tap->id;
+	else
+		tap->dr = &tap->dr_reg;
+}
+
+static void tap_reset(struct tap *tap)
+{
+	tap->ir = tap->idcode ? 1 : tap_bypass(tap);
+	tap_select(tap);
+}
+
+static void tap_capture_dr(struct tap *tap)
+{
+	uint8_t id[4];
+
+	if (tap->dr == &tap->id) {
+		id[0] = tap->idcode;
+		id[1] = tap->idcode >> 8;
+		id[2] = tap->idcode >> 16;
+		id[3] = tap->idcode >> 24;
+		reg_load(&tap->id, id);
+	} else if (tap->dr == &tap->bypass) {
+		uint8_t zero = 0;
+		reg_load(&tap->bypass, &zero);
+	} else
+		reg_load(&tap->dr_reg, tap->data);
+}
+
+static void tap_update_dr(struct tap *tap)
+{
+	if (tap->dr == &tap->dr_reg)
+		reg_store(&tap->dr_reg, tap->data);
+}
+
+static void tap_capture_ir(struct tap *tap)
+{
+	uint8_t value[4] = { 0x01, 0, 0, 0 };
+
+	reg_load(&tap->ir_reg, value);
+}
+
+static void tap_update_ir(struct tap *tap)
+{
+	uint8_t value[4] = { 0, 0, 0, 0 };
+
+	reg_store(&tap->ir_reg, value);
+	tap->ir = value[0] | (value[1] << 8) | (value[2] << 16)
+		| ((uint32_t)value[3] << 24);
+	tap_select(tap);
+}
+
+static void reset_chain(void)
+{
+	unsigned i;
+
+	state = RESET;
+	for (i = 0; i < num_taps; i++)
+		tap_reset(&taps[i]);
+}
+
+/* one TCK cycle; returns TDO as seen before the rising edge */
+static int clock_cycle(int tms, int tdi)
+{
+	int bit = 0;
+	int i;
+
+	switch (state) {
+	case DRCAPTURE:
+		for (i = 0; i < (int)num_taps; i++)
+			tap_capture_dr(&taps[i]);
+		break;
+	case IRCAPTURE:
+		for (i = 0; i < (int)num_taps; i++)
+			tap_capture_ir(&taps[i]);
+		break;
+	case DRSHIFT:
+		bit = tdi;
+		for (i = num_taps - 1; i >= 0; i--)
+			bit = reg_shift(taps[i].dr, bit);
+		break;
+	case IRSHIFT:
+		bit = tdi;
+		for (i = num_taps - 1; i >= 0; i--)
+			bit = reg_shift(&taps[i].ir_reg, bit);
+		break;
+	default:
+		break;
+	}
+
+	state = next_state[state][tms];
+
+	switch (state) {
+	case RESET:
+		for (i = 0; i < (int)num_taps; i++)
+			tap_reset(&taps[i]);
+		break;
+	case DRUPDATE:
+		for (i = 0; i < (int)num_taps; i++)
+			tap_update_dr(&taps[i]);
+		break;
+	case IRUPDATE:
+		for (i = 0; i < (int)num_taps; i++)
+			tap_update_ir(&taps[i]);
+		break;
+	default:
+		break;
+	}
+
+	return bit;
+}
+
+static void add_tap(const char *spec)
+{
+	struct tap *tap;
+	char *end;
+
+	if (num_taps == MAX_TAPS) {
+		fprintf(stderr, "at most %d TAPs\n", MAX_TAPS);
+		exit(1);
+	}
+	tap = &taps[num_taps++];
+
+	tap->irlen = strtoul(spec, &end, 0);
+	tap->idcode = 0;
+	tap->drlen = 32;
+	if (*end == ':')
+		tap->idcode = strtoul(end + 1, &end, 0);
+	if (*end == ':')
+		tap->drlen = strtoul(end + 1, &end, 0);
+	if (*end || tap->irlen < 2 || tap->irlen > 32 || tap->drlen < 1) {
+		fprintf(stderr, "bad TAP '%s', expected irlen[:idcode[:drlen]]\n",
+			spec);
+		exit(1);
+	}
+
+	reg_init(&tap->ir_reg, tap->irlen);
+	reg_init(&tap->dr_reg, tap->drlen);
+	reg_init(&tap->bypass, 1);
+	reg_init(&tap->id, 32);
+	tap->data = calloc((tap->drlen + 7) / 8, 1);
+	if (!tap->data) {
+		perror("calloc");
+		exit(1);
+	}
+	tap_reset(tap);
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = value;
+	buf[1] = value >> 8;
+	buf[2] = value >> 16;
+	buf[3] = value >> 24;
+}
+
+static bool read_all(int fd, uint8_t *buf, size_t size)
+{
+	while (size) {
+		ssize_t n = read(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf += n;
+		size -= n;
+		stats.bytes_in += n;
+	}
+	return true;
+}
+
+static bool write_all(int fd, const uint8_t *buf, size_t size)
+{
+	while (size) {
+		ssize_t n = write(fd, buf, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		buf += n;
+		size -= n;
+		stats.bytes_out += n;
+	}
+	return true;
+}
+
+/* Execute the commands of one message, appending TDO vectors to reply.
+ * Returns the status and the reply length in *reply_len. */
+static uint32_t execute(const uint8_t *cmd, size_t len,
+		uint8_t *reply, size_t *reply_len)
+{
+	const uint8_t *end = cmd + len;
+
+	*reply_len = 0;
+	while (cmd < end) {
+		switch (cmd[0]) {
+		case CMD_HELLO:
+			if (end - cmd < 5)
+				return STATUS_BAD_COMMAND;
+			if (get_u32(cmd + 1) != VERSION)
+				return STATUS_BAD_VERSION;
+			cmd += 5;
+			break;
+
+		case CMD_RESET:
+			if (end - cmd < 3)
+				return STATUS_BAD_COMMAND;
+			if (verbose)
+				printf("reset trst %d srst %d\n", cmd[1], cmd[2]);
+			if (cmd[1])
+				reset_chain();
+			cmd += 3;
+			break;
+
+		case CMD_SHIFT: {
+			const uint8_t *tms = NULL, *tdi = NULL;
+			uint8_t *tdo = NULL;
+			uint8_t flags;
+			uint32_t bits, bytes, i;
+
+			if (end - cmd < 6)
+				return STATUS_BAD_COMMAND;
+			flags = cmd[1];
+			bits = get_u32(cmd + 2);
+			bytes = (bits + 7) / 8;
+			cmd += 6;
+
+			if (flags & SHIFT_TMS) {
+				tms = cmd;
+				cmd += bytes;
+			}
+			if (flags & SHIFT_TDI) {
+				tdi = cmd;
+				cmd += bytes;
+			}
+			if (cmd > end)
+				return STATUS_BAD_COMMAND;
+			if (flags & SHIFT_TDO) {
+				if (*reply_len + bytes > MAX_MESSAGE)
+					return STATUS_BAD_COMMAND;
+				tdo = reply + *reply_len;
+				memset(tdo, 0, bytes);
+				*reply_len += bytes;
+				stats.tdo_bits += bits;
+			}
+
+			for (i = 0; i < bits; i++) {
+				int bit = clock_cycle(tms ? get_bit(tms, i) : 0,
+						tdi ? get_bit(tdi, i) : 0);
+				if (tdo && bit)
+					tdo[i / 8] |= 1 << (i % 8);
+			}
+			stats.cycles += bits;
+			break;
+		}
+
+		default:
+			return STATUS_BAD_COMMAND;
+		}
+	}
+
+	return STATUS_OK;
+}
+
+static void serve(int fd)
+{
+	static uint8_t msg[MAX_MESSAGE], reply[12 + MAX_MESSAGE];
+	struct timeval start, stop;
+	uint8_t header[8];
+	double seconds;
+
+	memset(&stats, 0, sizeof(stats));
+	gettimeofday(&start, NULL);
+
+	while (read_all(fd, header, sizeof(header))) {
+		uint32_t seq = get_u32(header);
+		uint32_t len = get_u32(header + 4);
+		uint32_t status;
+		size_t reply_len;
+
+		if (len > MAX_MESSAGE || !read_all(fd, msg, len)) {
+			fprintf(stderr, "bad message %u, closing\n", (unsigned)seq);
+			break;
+		}
+
+		status = execute(msg, len, reply + 12, &reply_len);
+		if (status != STATUS_OK)
+			fprintf(stderr, "message %u: status %u\n",
+				(unsigned)seq, (unsigned)status);
+
+		put_u32(reply, seq);
+		put_u32(reply + 4, status);
+		put_u32(reply + 8, reply_len);
+		if (!write_all(fd, reply, 12 + reply_len))
+			break;
+		stats.messages++;
+	}
+
+	gettimeofday(&stop, NULL);
+	seconds = (stop.tv_sec - start.tv_sec)
+		+ (stop.tv_usec - start.tv_usec) / 1e6;
+
+	printf("%lu messages, %llu cycles (%llu read back), "
+		"%llu bytes in, %llu bytes out, %.3f s",
+		stats.messages, stats.cycles, stats.tdo_bits,
+		stats.bytes_in, stats.bytes_out, seconds);
+	if (seconds > 0)
+		printf(", %.0f cycles/s", stats.cycles / seconds);
+	printf("\n");
+	fflush(stdout);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-p port | -u path] [-v] "
+		"[-t irlen[:idcode[:drlen]]]...\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	int port = 5555;
+	int listen_fd;
+	int c;
+
+	while ((c = getopt(argc, argv, "p:u:t:v")) != -1) {
+		switch (c) {
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'u':
+			path = optarg;
+			break;
+		case 't':
+			add_tap(optarg);
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc)
+		usage(argv[0]);
+	if (!num_taps)
+		add_tap("4:0x4ba00477");
+
+	if (path) {
+		struct sockaddr_un addr;
+
+		if (strlen(path) >= sizeof(addr.sun_path)) {
+			fprintf(stderr, "socket path too long\n");
+			return 1;
+		}
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, path);
+		unlink(path);
+
+		listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr,
+				sizeof(addr)) < 0) {
+			perror(path);
+			return 1;
+		}
+	} else {
+		struct sockaddr_in addr;
+		int one = 1;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = htons(port);
+
+		listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (listen_fd < 0) {
+			perror("socket");
+			return 1;
+		}
+		setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+			perror("bind");
+			return 1;
+		}
+	}
+
+	if (listen(listen_fd, 1) < 0) {
+		perror("listen");
+		return 1;
+	}
+
+	if (path)
+		printf("simulating %u TAP(s), listening on %s\n", num_taps, path);
+	else
+		printf("simulating %u TAP(s), listening on localhost:%d\n",
+			num_taps, port);
+	fflush(stdout);
+
+	for (;;) {
+		int one = 1;
+		int fd = accept(listen_fd, NULL, NULL);
+
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("accept");
+			return 1;
+		}
+		if (!path)
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		serve(fd);
+		close(fd);
+		reset_chain();
+	}
+
+	return 0;
+}
@@ -31,6 +31,7 @@
 #include <target/arm.h>
 #include <target/arm7_9_common.h>
 #include <target/armv7m.h>
+#include <target/mips32.h>
 #include <helper/binarybuffer.h>
 #include <target/algorithm.h>
 
@@ -41,6 +42,9 @@
 /* defines internal maximum size for code fragment in cfi_intel_write_block() */
 #define CFI_MAX_INTEL_CODESIZE 256
 
+/* same for the MIPS32 loaders in cfi_mips32_write_block() */
+#define CFI_MAX_MIPS32_CODESIZE 64
+
 static struct cfi_unlock_addresses cfi_unlock_addresses[] =
 {
 	[CFI_UNLOCK_555_2AA] = { .unlock1 = 0x555, .unlock2 = 0x2aa },
@@ -1184,6 +1188,13 @@ static void cfi_fix_code_endian(struct target *target, uint8_t *dest,
 	}
 }
 
+static int cfi_is_mips32(struct target *target)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+
+	return mips32 && (mips32->common_magic == MIPS32_COMMON_MAGIC);
+}
+
 static uint32_t cfi_command_val(struct flash_bank *bank, uint8_t cmd)
 {
 	struct target *target = bank->target;
@@ -1207,6 +1218,627 @@ static uint32_t cfi_command_val(struct flash_bank *bank, uint8_t cmd)
 	}
 }
 
+/* MIPS32 block writes share this: reg_params[0..3] are $a0..$a3 (source,
+ * destination, bus words, buffer size in bus words) and reg_params[4] is
+ * $v0 (result), the command set registers follow and are set up by the
+ * caller. A result with any of the error_mask bits set stops the write.
+ * All buffers are run in one algorithm session, so the core context is
+ * saved and restored once rather than per buffer.
+ */
+static int cfi_mips32_write_block(struct flash_bank *bank,
+		const uint32_t *code, uint32_t code_size,
+		struct reg_param *reg_params, int num_reg_params, uint32_t error_mask,
+		uint8_t *buffer, uint32_t address, uint32_t count, uint32_t *result)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	struct target *target = bank->target;
+	struct mips32_algorithm mips32_info;
+	struct working_area *source = NULL;
+	uint32_t buffer_size = 32768;
+	uint8_t target_code[4 * CFI_MAX_MIPS32_CODESIZE];
+	int retval, retval2;
+
+	if (code_size > sizeof(target_code))
+	{
+		LOG_WARNING("Internal error - target code buffer to small. "
+				"Increase CFI_MAX_MIPS32_CODESIZE and recompile.");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	mips32_info.common_magic = MIPS32_COMMON_MAGIC;
+	mips32_info.isa_mode = MIPS32_ISA_MIPS32;
+
+	if (!cfi_info->write_algorithm)
+	{
+		cfi_fix_code_endian(target, target_code, code, code_size / 4);
+
+		if (target_alloc_working_area(target, code_size,
+				&cfi_info->write_algorithm) != ERROR_OK)
+		{
+			LOG_WARNING("No working area available, can't do block memory writes");
+			return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		}
+
+		if ((retval = target_write_buffer(target, cfi_info->write_algorithm->address,
+				code_size, target_code)) != ERROR_OK)
+		{
+			LOG_ERROR("Unable to write block write code to target");
+			goto cleanup;
+		}
+	}
+
+	while (target_alloc_working_area_try(target, buffer_size, &source) != ERROR_OK)
+	{
+		buffer_size /= 2;
+		if (buffer_size <= 256)
+		{
+			LOG_WARNING("no large enough working area available, can't do block memory writes");
+			retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+			goto cleanup;
+		}
+	}
+
+	if ((retval = mips32_algorithm_session_begin(target)) != ERROR_OK)
+		goto cleanup;
+
+	LOG_DEBUG("Using target buffer at 0x%08" PRIx32 " and of size 0x%04" PRIx32
+			", write buffer %" PRIu32 " bus words", source->address, buffer_size,
+			buf_get_u32(reg_params[3].value, 0, 32));
+
+	while (count > 0)
+	{
+		uint32_t thisrun_count = (count > buffer_size) ? buffer_size : count;
+
+		if ((retval = target_write_buffer(target, source->address,
+				thisrun_count, buffer)) != ERROR_OK)
+			break;
+
+		buf_set_u32(reg_params[0].value, 0, 32, source->address);
+		buf_set_u32(reg_params[1].value, 0, 32, address);
+		buf_set_u32(reg_params[2].value, 0, 32, thisrun_count / bank->bus_width);
+
+		/* the loaders end with sdbbp, the exit point is the last word */
+		if ((retval = target_run_algorithm(target, 0, NULL,
+				num_reg_params, reg_params,
+				cfi_info->write_algorithm->address,
+				cfi_info->write_algorithm->address + code_size - sizeof(uint32_t),
+				10000, &mips32_info)) != ERROR_OK)
+		{
+			LOG_ERROR("Execution of flash algorithm failed");
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+
+		*result = buf_get_u32(reg_params[4].value, 0, 32);
+		if (*result & error_mask)
+		{
+			retval = ERROR_FLASH_OPERATION_FAILED;
+			break;
+		}
+
+		buffer += thisrun_count;
+		address += thisrun_count;
+		count -= thisrun_count;
+
+		keep_alive();
+	}
+
+	retval2 = mips32_algorithm_session_end(target);
+	if (retval == ERROR_OK)
+		retval = retval2;
+
+cleanup:
+	if (source)
+		target_free_working_area(target, source);
+
+	if (cfi_info->write_algorithm)
+	{
+		target_free_working_area(target, cfi_info->write_algorithm);
+		cfi_info->write_algorithm = NULL;
+	}
+
+	return retval;
+}
+
+/* write buffer size in bus words for the MIPS32 loaders, 0 selects
+ * single word programming */
+static uint32_t cfi_mips32_buffer_words(struct flash_bank *bank)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	uint32_t bufferwsize;
+
+	if ((cfi_info->buf_write_timeout_typ == 0) || (cfi_info->max_buf_write_size == 0))
+		return 0;
+
+	/* buffer size per chip in chip words, which is the bus words
+	 * of the interleaved buffers */
+	bufferwsize = (1UL << cfi_info->max_buf_write_size) / bank->chip_width;
+
+	/* the word count - 1 has to fit a chip lane */
+	if ((bank->chip_width == 1) && (bufferwsize > 256))
+		bufferwsize = 256;
+
+	return (bufferwsize > 1) ? bufferwsize : 0;
+}
+
+static int cfi_intel_write_block_mips32(struct flash_bank *bank, uint8_t *buffer,
+		uint32_t address, uint32_t count)
+{
+	struct reg_param reg_params[10];
+	const uint32_t *target_code_src;
+	uint32_t target_code_size;
+	uint32_t bufferwsize, error_pattern_val, status = 0;
+	int retval, i;
+
+	/* algorithm register usage:
+	 * a0: source address (in RAM)
+	 * a1: target address (in Flash)
+	 * a2: count
+	 * a3: write buffer size in bus words, 0 for single word programming
+	 * v0: status register (returned to host)
+	 * t0: flash write command, 0x40 or 0xe8
+	 * t1: busy test pattern
+	 * t2: error test pattern
+	 * t3: buffer confirm command
+	 * t4: 0x01 per chip, scales the buffer word count
+	 */
+
+	/* see contrib/loaders/flash/mips32_cfi_intel.S for src */
+	static const uint32_t word_32_code[] = {
+	0x10e0001b,		/* main: beq $a3, $zero, word */
+	0x00000000,		/* nop */
+	0x00056882,		/* srl $t5, $a1, 2 */
+	0x24eeffff,		/* addiu $t6, $a3, -1 */
+	0x01ae6824,		/* and $t5, $t5, $t6 */
+	0x00ed6823,		/* subu $t5, $a3, $t5 */
+	0x00cd702b,		/* sltu $t6, $a2, $t5 */
+	0x11c00002,		/* beq $t6, $zero, buf_start */
+	0x00000000,		/* nop */
+	0x00c06821,		/* addu $t5, $a2, $zero */
+	0xaca80000,		/* buf_start: sw $t0, 0($a1) */
+	0x8ca20000,		/* buf_ready: lw $v0, 0($a1) */
+	0x00497024,		/* and $t6, $v0, $t1 */
+	0x15c9fffd,		/* bne $t6, $t1, buf_ready */
+	0x00000000,		/* nop */
+	0x25aeffff,		/* addiu $t6, $t5, -1 */
+	0x71cc7002,		/* mul $t6, $t6, $t4 */
+	0xacae0000,		/* sw $t6, 0($a1) */
+	0x00cd3023,		/* subu $a2, $a2, $t5 */
+	0x8c8e0000,		/* buf_fill: lw $t6, 0($a0) */
+	0xacae0000,		/* sw $t6, 0($a1) */
+	0x24840004,		/* addiu $a0, $a0, 4 */
+	0x25adffff,		/* addiu $t5, $t5, -1 */
+	0x15a0fffb,		/* bne $t5, $zero, buf_fill */
+	0x24a50004,		/* addiu $a1, $a1, 4 */
+	0x24affffc,		/* addiu $t7, $a1, -4 */
+	0x10000008,		/* b busy */
+	0xadeb0000,		/* sw $t3, 0($t7) */
+	0xaca80000,		/* word: sw $t0, 0($a1) */
+	0x8c8e0000,		/* lw $t6, 0($a0) */
+	0xacae0000,		/* sw $t6, 0($a1) */
+	0x00a07821,		/* addu $t7, $a1, $zero */
+	0x24840004,		/* addiu $a0, $a0, 4 */
+	0x24a50004,		/* addiu $a1, $a1, 4 */
+	0x24c6ffff,		/* addiu $a2, $a2, -1 */
+	0x8de20000,		/* busy: lw $v0, 0($t7) */
+	0x00497024,		/* and $t6, $v0, $t1 */
+	0x15c9fffd,		/* bne $t6, $t1, busy */
+	0x00000000,		/* nop */
+	0x004a7024,		/* and $t6, $v0, $t2 */
+	0x15c00003,		/* bne $t6, $zero, done */
+	0x00000000,		/* nop */
+	0x14c0ffd5,		/* bne $a2, $zero, main */
+	0x00000000,		/* nop */
+	0x7000003f		/* done: sdbbp */
+	};
+
+	/* see contrib/loaders/flash/mips32_cfi_intel.S for src */
+	static const uint32_t word_16_code[] = {
+	0x10e0001b,		/* main: beq $a3, $zero, word */
+	0x00000000,		/* nop */
+	0x00056842,		/* srl $t5, $a1, 1 */
+	0x24eeffff,		/* addiu $t6, $a3, -1 */
+	0x01ae6824,		/* and $t5, $t5, $t6 */
+	0x00ed6823,		/* subu $t5, $a3, $t5 */
+	0x00cd702b,		/* sltu $t6, $a2, $t5 */
+	0x11c00002,		/* beq $t6, $zero, buf_start */
+	0x00000000,		/* nop */
+	0x00c06821,		/* addu $t5, $a2, $zero */
+	0xa4a80000,		/* buf_start: sh $t0, 0($a1) */
+	0x94a20000,		/* buf_ready: lhu $v0, 0($a1) */
+	0x00497024,		/* and $t6, $v0, $t1 */
+	0x15c9fffd,		/* bne $t6, $t1, buf_ready */
+	0x00000000,		/* nop */
+	0x25aeffff,		/* addiu $t6, $t5, -1 */
+	0x71cc7002,		/* mul $t6, $t6, $t4 */
+	0xa4ae0000,		/* sh $t6, 0($a1) */
+	0x00cd3023,		/* subu $a2, $a2, $t5 */
+	0x948e0000,		/* buf_fill: lhu $t6, 0($a0) */
+	0xa4ae0000,		/* sh $t6, 0($a1) */
+	0x24840002,		/* addiu $a0, $a0, 2 */
+	0x25adffff,		/* addiu $t5, $t5, -1 */
+	0x15a0fffb,		/* bne $t5, $zero, buf_fill */
+	0x24a50002,		/* addiu $a1, $a1, 2 */
+	0x24affffe,		/* addiu $t7, $a1, -2 */
+	0x10000008,		/* b busy */
+	0xa5eb0000,		/* sh $t3, 0($t7) */
+	0xa4a80000,		/* word: sh $t0, 0($a1) */
+	0x948e0000,		/* lhu $t6, 0($a0) */
+	0xa4ae0000,		/* sh $t6, 0($a1) */
+	0x00a07821,		/* addu $t7, $a1, $zero */
+	0x24840002,		/* addiu $a0, $a0, 2 */
+	0x24a50002,		/* addiu $a1, $a1, 2 */
+	0x24c6ffff,		/* addiu $a2, $a2, -1 */
+	0x95e20000,		/* busy: lhu $v0, 0($t7) */
+	0x00497024,		/* and $t6, $v0, $t1 */
+	0x15c9fffd,		/* bne $t6, $t1, busy */
+	0x00000000,		/* nop */
+	0x004a7024,		/* and $t6, $v0, $t2 */
+	0x15c00003,		/* bne $t6, $zero, done */
+	0x00000000,		/* nop */
+	0x14c0ffd5,		/* bne $a2, $zero, main */
+	0x00000000,		/* nop */
+	0x7000003f		/* done: sdbbp */
+	};
+
+	/* see contrib/loaders/flash/mips32_cfi_intel.S for src */
+	static const uint32_t word_8_code[] = {
+	0x10e0001b,		/* main: beq $a3, $zero, word */
+	0x00000000,		/* nop */
+	0x00056802,		/* srl $t5, $a1, 0 */
+	0x24eeffff,		/* addiu $t6, $a3, -1 */
+	0x01ae6824,		/* and $t5, $t5, $t6 */
+	0x00ed6823,		/* subu $t5, $a3, $t5 */
+	0x00cd702b,		/* sltu $t6, $a2, $t5 */
+	0x11c00002,		/* beq $t6, $zero, buf_start */
+	0x00000000,		/* nop */
+	0x00c06821,		/* addu $t5, $a2, $zero */
+	0xa0a80000,		/* buf_start: sb $t0, 0($a1) */
+	0x90a20000,		/* buf_ready: lbu $v0, 0($a1) */
+	0x00497024,		/* and $t6, $v0, $t1 */
+	0x15c9fffd,		/* bne $t6, $t1, buf_ready */
+	0x00000000,		/* nop */
+	0x25aeffff,		/* addiu $t6, $t5, -1 */
+	0x71cc7002,		/* mul $t6, $t6, $t4 */
+	0xa0ae0000,		/* sb $t6, 0($a1) */
+	0x00cd3023,		/* subu $a2, $a2, $t5 */
+	0x908e0000,		/* buf_fill: lbu $t6, 0($a0) */
+	0xa0ae0000,		/* sb $t6, 0($a1) */
+	0x24840001,		/* addiu $a0, $a0, 1 */
+	0x25adffff,		/* addiu $t5, $t5, -1 */
+	0x15a0fffb,		/* bne $t5, $zero, buf_fill */
+	0x24a50001,		/* addiu $a1, $a1, 1 */
+	0x24afffff,		/* addiu $t7, $a1, -1 */
+	0x10000008,		/* b busy */
+	0xa1eb0000,		/* sb $t3, 0($t7) */
+	0xa0a80000,		/* word: sb $t0, 0($a1) */
+	0x908e0000,		/* lbu $t6, 0($a0) */
+	0xa0ae0000,		/* sb $t6, 0($a1) */
+	0x00a07821,		/* addu $t7, $a1, $zero */
+	0x24840001,		/* addiu $a0, $a0, 1 */
+	0x24a50001,		/* addiu $a1, $a1, 1 */
+	0x24c6ffff,		/* addiu $a2, $a2, -1 */
+	0x91e20000,		/* busy: lbu $v0, 0($t7) */
+	0x00497024,		/* and $t6, $v0, $t1 */
+	0x15c9fffd,		/* bne $t6, $t1, busy */
+	0x00000000,		/* nop */
+	0x004a7024,		/* and $t6, $v0, $t2 */
+	0x15c00003,		/* bne $t6, $zero, done */
+	0x00000000,		/* nop */
+	0x14c0ffd5,		/* bne $a2, $zero, main */
+	0x00000000,		/* nop */
+	0x7000003f		/* done: sdbbp */
+	};
+
+	switch (bank->bus_width)
+	{
+	case 1 :
+		target_code_src = word_8_code;
+		target_code_size = sizeof(word_8_code);
+		break;
+	case 2 :
+		target_code_src = word_16_code;
+		target_code_size = sizeof(word_16_code);
+		break;
+	case 4 :
+		target_code_src = word_32_code;
+		target_code_size = sizeof(word_32_code);
+		break;
+	default:
+		LOG_ERROR("Unsupported bank buswidth %d, can't do block memory writes", bank->bus_width);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	cfi_intel_clear_status_register(bank);
+
+	bufferwsize = cfi_mips32_buffer_words(bank);
+	error_pattern_val = cfi_command_val(bank, 0x7e);
+
+	init_reg_param(&reg_params[0], "a0", 32, PARAM_OUT);
+	init_reg_param(&reg_params[1], "a1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[2], "a2", 32, PARAM_OUT);
+	init_reg_param(&reg_params[3], "a3", 32, PARAM_OUT);
+	init_reg_param(&reg_params[4], "v0", 32, PARAM_IN);
+	init_reg_param(&reg_params[5], "t0", 32, PARAM_OUT);
+	init_reg_param(&reg_params[6], "t1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[7], "t2", 32, PARAM_OUT);
+	init_reg_param(&reg_params[8], "t3", 32, PARAM_OUT);
+	init_reg_param(&reg_params[9], "t4", 32, PARAM_OUT);
+
+	buf_set_u32(reg_params[3].value, 0, 32, bufferwsize);
+	buf_set_u32(reg_params[5].value, 0, 32, cfi_command_val(bank, bufferwsize ? 0xe8 : 0x40));
+	buf_set_u32(reg_params[6].value, 0, 32, cfi_command_val(bank, 0x80));
+	buf_set_u32(reg_params[7].value, 0, 32, error_pattern_val);
+	buf_set_u32(reg_params[8].value, 0, 32, cfi_command_val(bank, 0xd0));
+	buf_set_u32(reg_params[9].value, 0, 32, cfi_command_val(bank, 0x01));
+
+	retval = cfi_mips32_write_block(bank, target_code_src, target_code_size,
+			reg_params, 10, error_pattern_val, buffer, address, count, &status);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+	{
+		/* read status register (outputs debug inforation) */
+		uint8_t sr;
+		LOG_ERROR("flash write block failed status: 0x%" PRIx32, status);
+		cfi_intel_wait_status_busy(bank, 100, &sr);
+		cfi_intel_clear_status_register(bank);
+	}
+
+	for (i = 0; i < 10; i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
+static int cfi_spansion_write_block_mips32(struct flash_bank *bank, uint8_t *buffer,
+		uint32_t address, uint32_t count)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	struct cfi_spansion_pri_ext *pri_ext = cfi_info->pri_ext;
+	struct reg_param reg_params[14];
+	const uint32_t *target_code_src;
+	uint32_t target_code_size;
+	uint32_t bufferwsize, status = 0;
+	int retval, i;
+
+	/* algorithm register usage:
+	 * a0: source address (in RAM)
+	 * a1: target address (in Flash)
+	 * a2: count
+	 * a3: write buffer size in bus words, 0 for single word programming
+	 * v0: 0 ok, otherwise the failing DQ7 bits (returned to host)
+	 * t0: flash write command, 0xa0 or 0x25
+	 * t1: program buffer to flash command
+	 * t2: DQ7 mask
+	 * t3: DQ5 mask, 0 for DQ7 polling only
+	 * t4..t7: unlock1 address and command, unlock2 address and command
+	 * t8: 0x01 per chip, scales the buffer word count
+	 */
+
+	/* see contrib/loaders/flash/mips32_cfi_span.S for src */
+	static const uint32_t word_32_code[] = {
+	0xad8d0000,		/* main: sw $t5, 0($t4) */
+	0xadcf0000,		/* sw $t7, 0($t6) */
+	0x10e00017,		/* beq $a3, $zero, word */
+	0x00000000,		/* nop */
+	0x00051882,		/* srl $v1, $a1, 2 */
+	0x24f9ffff,		/* addiu $t9, $a3, -1 */
+	0x00791824,		/* and $v1, $v1, $t9 */
+	0x00e31823,		/* subu $v1, $a3, $v1 */
+	0x00c3c82b,		/* sltu $t9, $a2, $v1 */
+	0x13200002,		/* beq $t9, $zero, buf_start */
+	0x00000000,		/* nop */
+	0x00c01821,		/* addu $v1, $a2, $zero */
+	0xaca80000,		/* buf_start: sw $t0, 0($a1) */
+	0x2479ffff,		/* addiu $t9, $v1, -1 */
+	0x7338c802,		/* mul $t9, $t9, $t8 */
+	0xacb90000,		/* sw $t9, 0($a1) */
+	0x00c33023,		/* subu $a2, $a2, $v1 */
+	0x8c900000,		/* buf_fill: lw $s0, 0($a0) */
+	0xacb00000,		/* sw $s0, 0($a1) */
+	0x24840004,		/* addiu $a0, $a0, 4 */
+	0x2463ffff,		/* addiu $v1, $v1, -1 */
+	0x1460fffb,		/* bne $v1, $zero, buf_fill */
+	0x24a50004,		/* addiu $a1, $a1, 4 */
+	0x24b1fffc,		/* addiu $s1, $a1, -4 */
+	0x10000008,		/* b busy */
+	0xae290000,		/* sw $t1, 0($s1) */
+	0xad880000,		/* word: sw $t0, 0($t4) */
+	0x8c900000,		/* lw $s0, 0($a0) */
+	0xacb00000,		/* sw $s0, 0($a1) */
+	0x00a08821,		/* addu $s1, $a1, $zero */
+	0x24840004,		/* addiu $a0, $a0, 4 */
+	0x24a50004,		/* addiu $a1, $a1, 4 */
+	0x24c6ffff,		/* addiu $a2, $a2, -1 */
+	0x8e220000,		/* busy: lw $v0, 0($s1) */
+	0x0050c826,		/* xor $t9, $v0, $s0 */
+	0x032ac824,		/* and $t9, $t9, $t2 */
+	0x13200009,		/* beq $t9, $zero, next */
+	0x00000000,		/* nop */
+	0x004bc824,		/* and $t9, $v0, $t3 */
+	0x1320fff9,		/* beq $t9, $zero, busy */
+	0x00000000,		/* nop */
+	0x8e220000,		/* lw $v0, 0($s1) */
+	0x0050c826,		/* xor $t9, $v0, $s0 */
+	0x032ac824,		/* and $t9, $t9, $t2 */
+	0x17200003,		/* bne $t9, $zero, done */
+	0x03201021,		/* addu $v0, $t9, $zero */
+	0x14c0ffd1,		/* next: bne $a2, $zero, main */
+	0x00001021,		/* addu $v0, $zero, $zero */
+	0x7000003f		/* done: sdbbp */
+	};
+
+	/* see contrib/loaders/flash/mips32_cfi_span.S for src */
+	static const uint32_t word_16_code[] = {
+	0xa58d0000,		/* main: sh $t5, 0($t4) */
+	0xa5cf0000,		/* sh $t7, 0($t6) */
+	0x10e00017,		/* beq $a3, $zero, word */
+	0x00000000,		/* nop */
+	0x00051842,		/* srl $v1, $a1, 1 */
+	0x24f9ffff,		/* addiu $t9, $a3, -1 */
+	0x00791824,		/* and $v1, $v1, $t9 */
+	0x00e31823,		/* subu $v1, $a3, $v1 */
+	0x00c3c82b,		/* sltu $t9, $a2, $v1 */
+	0x13200002,		/* beq $t9, $zero, buf_start */
+	0x00000000,		/* nop */
+	0x00c01821,		/* addu $v1, $a2, $zero */
+	0xa4a80000,		/* buf_start: sh $t0, 0($a1) */
+	0x2479ffff,		/* addiu $t9, $v1, -1 */
+	0x7338c802,		/* mul $t9, $t9, $t8 */
+	0xa4b90000,		/* sh $t9, 0($a1) */
+	0x00c33023,		/* subu $a2, $a2, $v1 */
+	0x94900000,		/* buf_fill: lhu $s0, 0($a0) */
+	0xa4b00000,		/* sh $s0, 0($a1) */
+	0x24840002,		/* addiu $a0, $a0, 2 */
+	0x2463ffff,		/* addiu $v1, $v1, -1 */
+	0x1460fffb,		/* bne $v1, $zero, buf_fill */
+	0x24a50002,		/* addiu $a1, $a1, 2 */
+	0x24b1fffe,		/* addiu $s1, $a1, -2 */
+	0x10000008,		/* b busy */
+	0xa6290000,		/* sh $t1, 0($s1) */
+	0xa5880000,		/* word: sh $t0, 0($t4) */
+	0x94900000,		/* lhu $s0, 0($a0) */
+	0xa4b00000,		/* sh $s0, 0($a1) */
+	0x00a08821,		/* addu $s1, $a1, $zero */
+	0x24840002,		/* addiu $a0, $a0, 2 */
+	0x24a50002,		/* addiu $a1, $a1, 2 */
+	0x24c6ffff,		/* addiu $a2, $a2, -1 */
+	0x96220000,		/* busy: lhu $v0, 0($s1) */
+	0x0050c826,		/* xor $t9, $v0, $s0 */
+	0x032ac824,		/* and $t9, $t9, $t2 */
+	0x13200009,		/* beq $t9, $zero, next */
+	0x00000000,		/* nop */
+	0x004bc824,		/* and $t9, $v0, $t3 */
+	0x1320fff9,		/* beq $t9, $zero, busy */
+	0x00000000,		/* nop */
+	0x96220000,		/* lhu $v0, 0($s1) */
+	0x0050c826,		/* xor $t9, $v0, $s0 */
+	0x032ac824,		/* and $t9, $t9, $t2 */
+	0x17200003,		/* bne $t9, $zero, done */
+	0x03201021,		/* addu $v0, $t9, $zero */
+	0x14c0ffd1,		/* next: bne $a2, $zero, main */
+	0x00001021,		/* addu $v0, $zero, $zero */
+	0x7000003f		/* done: sdbbp */
+	};
+
+	/* see contrib/loaders/flash/mips32_cfi_span.S for src */
+	static const uint32_t word_8_code[] = {
+	0xa18d0000,		/* main: sb $t5, 0($t4) */
+	0xa1cf0000,		/* sb $t7, 0($t6) */
+	0x10e00017,		/* beq $a3, $zero, word */
+	0x00000000,		/* nop */
+	0x00051802,		/* srl $v1, $a1, 0 */
+	0x24f9ffff,		/* addiu $t9, $a3, -1 */
+	0x00791824,		/* and $v1, $v1, $t9 */
+	0x00e31823,		/* subu $v1, $a3, $v1 */
+	0x00c3c82b,		/* sltu $t9, $a2, $v1 */
+	0x13200002,		/* beq $t9, $zero, buf_start */
+	0x00000000,		/* nop */
+	0x00c01821,		/* addu $v1, $a2, $zero */
+	0xa0a80000,		/* buf_start: sb $t0, 0($a1) */
+	0x2479ffff,		/* addiu $t9, $v1, -1 */
+	0x7338c802,		/* mul $t9, $t9, $t8 */
+	0xa0b90000,		/* sb $t9, 0($a1) */
+	0x00c33023,		/* subu $a2, $a2, $v1 */
+	0x90900000,		/* buf_fill: lbu $s0, 0($a0) */
+	0xa0b00000,		/* sb $s0, 0($a1) */
+	0x24840001,		/* addiu $a0, $a0, 1 */
+	0x2463ffff,		/* addiu $v1, $v1, -1 */
+	0x1460fffb,		/* bne $v1, $zero, buf_fill */
+	0x24a50001,		/* addiu $a1, $a1, 1 */
+	0x24b1ffff,		/* addiu $s1, $a1, -1 */
+	0x10000008,		/* b busy */
+	0xa2290000,		/* sb $t1, 0($s1) */
+	0xa1880000,		/* word: sb $t0, 0($t4) */
+	0x90900000,		/* lbu $s0, 0($a0) */
+	0xa0b00000,		/* sb $s0, 0($a1) */
+	0x00a08821,		/* addu $s1, $a1, $zero */
+	0x24840001,		/* addiu $a0, $a0, 1 */
+	0x24a50001,		/* addiu $a1, $a1, 1 */
+	0x24c6ffff,		/* addiu $a2, $a2, -1 */
+	0x92220000,		/* busy: lbu $v0, 0($s1) */
+	0x0050c826,		/* xor $t9, $v0, $s0 */
+	0x032ac824,		/* and $t9, $t9, $t2 */
+	0x13200009,		/* beq $t9, $zero, next */
+	0x00000000,		/* nop */
+	0x004bc824,		/* and $t9, $v0, $t3 */
+	0x1320fff9,		/* beq $t9, $zero, busy */
+	0x00000000,		/* nop */
+	0x92220000,		/* lbu $v0, 0($s1) */
+	0x0050c826,		/* xor $t9, $v0, $s0 */
+	0x032ac824,		/* and $t9, $t9, $t2 */
+	0x17200003,		/* bne $t9, $zero, done */
+	0x03201021,		/* addu $v0, $t9, $zero */
+	0x14c0ffd1,		/* next: bne $a2, $zero, main */
+	0x00001021,		/* addu $v0, $zero, $zero */
+	0x7000003f		/* done: sdbbp */
+	};
+
+	switch (bank->bus_width)
+	{
+	case 1 :
+		target_code_src = word_8_code;
+		target_code_size = sizeof(word_8_code);
+		break;
+	case 2 :
+		target_code_src = word_16_code;
+		target_code_size = sizeof(word_16_code);
+		break;
+	case 4 :
+		target_code_src = word_32_code;
+		target_code_size = sizeof(word_32_code);
+		break;
+	default:
+		LOG_ERROR("Unsupported bank buswidth %d, can't do block memory writes", bank->bus_width);
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	bufferwsize = cfi_mips32_buffer_words(bank);
+
+	init_reg_param(&reg_params[0], "a0", 32, PARAM_OUT);
+	init_reg_param(&reg_params[1], "a1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[2], "a2", 32, PARAM_OUT);
+	init_reg_param(&reg_params[3], "a3", 32, PARAM_OUT);
+	init_reg_param(&reg_params[4], "v0", 32, PARAM_IN);
+	init_reg_param(&reg_params[5], "t0", 32, PARAM_OUT);
+	init_reg_param(&reg_params[6], "t1", 32, PARAM_OUT);
+	init_reg_param(&reg_params[7], "t2", 32, PARAM_OUT);
+	init_reg_param(&reg_params[8], "t3", 32, PARAM_OUT);
+	init_reg_param(&reg_params[9], "t4", 32, PARAM_OUT);
+	init_reg_param(&reg_params[10], "t5", 32, PARAM_OUT);
+	init_reg_param(&reg_params[11], "t6", 32, PARAM_OUT);
+	init_reg_param(&reg_params[12], "t7", 32, PARAM_OUT);
+	init_reg_param(&reg_params[13], "t8", 32, PARAM_OUT);
+
+	buf_set_u32(reg_params[3].value, 0, 32, bufferwsize);
+	buf_set_u32(reg_params[5].value, 0, 32, cfi_command_val(bank, bufferwsize ? 0x25 : 0xa0));
+	buf_set_u32(reg_params[6].value, 0, 32, cfi_command_val(bank, 0x29));
+	buf_set_u32(reg_params[7].value, 0, 32, cfi_command_val(bank, 0x80));
+	/* without DQ5 support only DQ7 data# polling is used */
+	buf_set_u32(reg_params[8].value, 0, 32, (cfi_info->status_poll_mask & (1 << 5)) ?
+			cfi_command_val(bank, 0x20) : 0);
+	buf_set_u32(reg_params[9].value, 0, 32, flash_address(bank, 0, pri_ext->_unlock1));
+	buf_set_u32(reg_params[10].value, 0, 32, cfi_command_val(bank, 0xaa));
+	buf_set_u32(reg_params[11].value, 0, 32, flash_address(bank, 0, pri_ext->_unlock2));
+	buf_set_u32(reg_params[12].value, 0, 32, cfi_command_val(bank, 0x55));
+	buf_set_u32(reg_params[13].value, 0, 32, cfi_command_val(bank, 0x01));
+
+	retval = cfi_mips32_write_block(bank, target_code_src, target_code_size,
+			reg_params, 14, 0xffffffff, buffer, address, count, &status);
+
+	if (retval == ERROR_FLASH_OPERATION_FAILED)
+	{
+		LOG_ERROR("flash write block failed status: 0x%" PRIx32, status);
+		/* back to read array mode */
+		cfi_send_command(bank, 0xf0, flash_address(bank, 0, 0x0));
+	}
+
+	for (i = 0; i < 14; i++)
+		destroy_reg_param(&reg_params[i]);
+
+	return retval;
+}
+
 static int cfi_intel_write_block(struct flash_bank *bank, uint8_t *buffer,
 		uint32_t address, uint32_t count)
 {
@@ -1286,6 +1918,8 @@ static int cfi_intel_write_block(struct flash_bank *bank, uint8_t *buffer,
 	uint32_t target_code_size;
 	int retval = ERROR_OK;
 
+	if (cfi_is_mips32(target))
+		return cfi_intel_write_block_mips32(bank, buffer, address, count);
 
 	cfi_intel_clear_status_register(bank);
 
@@ -1645,6 +2279,9 @@ static int cfi_spansion_write_block(struct flash_bank *bank, uint8_t *buffer,
 		0xeafffffe		/* b	8204 <sp_8_done>		*/
 	};
 
+	if (cfi_is_mips32(target))
+		return cfi_spansion_write_block_mips32(bank, buffer, address, count);
+
 	if (is_armv7m(target_to_armv7m(target))) /* Cortex-M3 target */
 	{
 		armv4_5_info.common_magic = ARMV7M_COMMON_MAGIC;
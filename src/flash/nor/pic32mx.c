@@ -353,13 +353,150 @@ static const uint32_t pic32mx_flash_write_code[] = {
 	0x00000000,		/* nop */
 	0x00000000,		/* nop */
 	0x8D510000,		/* lw $s1, 0($t2) */
-	0x30113000,		/* andi $s1, $zero, 0x3000 */
+	0x32313000,		/* andi $s1, $s1, 0x3000 */
 	0x1620FFEF,		/* bne $s1, $zero, error */
 	0xAD4D0004,		/* sw $t5, 4($t2) */
 	0x03E00008,		/* jr $ra */
 	0x00000000		/* nop */
 };
 
+/* see contib/loaders/flash/pic32mx_stream.s for src */
+
+static const uint32_t pic32mx_flash_stream_code[] = {
+					/* main: */
+	0x3C0EBF80,		/* lui $t6, 0xbf80 */
+	0x35CEF400,		/* ori $t6, 0xf400 */
+	0x0120C821,		/* addu $t9, $t1, $zero */
+					/* copy: */
+	0x132A0005,		/* beq $t9, $t2, wait */
+	0x00000000,		/* nop */
+	0x8D180000,		/* lw $t8, 0($t0) */
+	0xAF380000,		/* sw $t8, 0($t9) */
+	0x1000FFFB,		/* beq $zero, $zero, copy */
+	0x27390004,		/* addiu $t9, $t9, 4 */
+					/* wait: */
+	0x8DCD0000,		/* lw $t5, 0($t6) */
+	0x31B88000,		/* andi $t8, $t5, 0x8000 */
+	0x1700FFFD,		/* bne $t8, $zero, wait */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x8DCD0000,		/* lw $t5, 0($t6) */
+	0x112A002E,		/* beq $t1, $t2, finish */
+	0x0120C821,		/* addu $t9, $t1, $zero */
+	0x34184003,		/* ori $t8, $zero, 0x4003 */
+	0x15980010,		/* bne $t4, $t8, word */
+	0x00000000,		/* nop */
+	0x3C181FFF,		/* lui $t8, 0x1fff */
+	0x3718FFFF,		/* ori $t8, 0xffff */
+	0x0138C024,		/* and $t8, $t1, $t8 */
+	0xADD80040,		/* sw $t8, 64($t6) */
+	0xADCB0020,		/* sw $t3, 32($t6) */
+	0xADCC0000,		/* sw $t4, 0($t6) */
+	0x3C18AA99,		/* lui $t8, 0xaa99 */
+	0x37186655,		/* ori $t8, 0x6655 */
+	0xADD80010,		/* sw $t8, 16($t6) */
+	0x3C185566,		/* lui $t8, 0x5566 */
+	0x371899AA,		/* ori $t8, 0x99aa */
+	0xADD80010,		/* sw $t8, 16($t6) */
+	0x34188000,		/* ori $t8, $zero, 0x8000 */
+	0x1000001E,		/* beq $zero, $zero, done */
+	0xADD80008,		/* sw $t8, 8($t6) */
+					/* word: */
+	0x8F380000,		/* lw $t8, 0($t9) */
+	0xADD80030,		/* sw $t8, 48($t6) */
+	0xADCB0020,		/* sw $t3, 32($t6) */
+	0xADCC0000,		/* sw $t4, 0($t6) */
+	0x3C18AA99,		/* lui $t8, 0xaa99 */
+	0x37186655,		/* ori $t8, 0x6655 */
+	0xADD80010,		/* sw $t8, 16($t6) */
+	0x3C185566,		/* lui $t8, 0x5566 */
+	0x371899AA,		/* ori $t8, 0x99aa */
+	0xADD80010,		/* sw $t8, 16($t6) */
+	0x34188000,		/* ori $t8, $zero, 0x8000 */
+	0xADD80008,		/* sw $t8, 8($t6) */
+					/* wait_word: */
+	0x8DCD0000,		/* lw $t5, 0($t6) */
+	0x31B88000,		/* andi $t8, $t5, 0x8000 */
+	0x1700FFFD,		/* bne $t8, $zero, wait_word */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x00000000,		/* nop */
+	0x8DCD0000,		/* lw $t5, 0($t6) */
+	0x31B83000,		/* andi $t8, $t5, 0x3000 */
+	0x17000006,		/* bne $t8, $zero, done */
+	0x256B0004,		/* addiu $t3, $t3, 4 */
+	0x27390004,		/* addiu $t9, $t9, 4 */
+	0x172AFFE6,		/* bne $t9, $t2, word */
+	0x00000000,		/* nop */
+					/* finish: */
+	0x34184000,		/* ori $t8, $zero, 0x4000 */
+	0xADD80004,		/* sw $t8, 4($t6) */
+					/* done: */
+	0xAD0D2000,		/* sw $t5, 0x2000($t0) */
+	0x8DE8FFDC,		/* lw $t0, -36($t7) */
+	0x8DE9FFE0,		/* lw $t1, -32($t7) */
+	0x8DEAFFE4,		/* lw $t2, -28($t7) */
+	0x8DEBFFE8,		/* lw $t3, -24($t7) */
+	0x8DECFFEC,		/* lw $t4, -20($t7) */
+	0x8DEDFFF0,		/* lw $t5, -16($t7) */
+	0x8DEEFFF4,		/* lw $t6, -12($t7) */
+	0x8DF8FFF8,		/* lw $t8, -8($t7) */
+	0x8DF9FFFC,		/* lw $t9, -4($t7) */
+	0x3C0FFF20,		/* lui $t7, 0xff20 */
+	0x35EF0200,		/* ori $t7, 0x0200 */
+	0x01E00008,		/* jr $t7 */
+	0x400FF800,		/* mfc0 $t7, $31 */
+};
+
+/* rows buffered in the working area: the loader programs one row
+ * in the background while the next one is streamed into another */
+#define PIC32MX_ROW_SIZE		512
+#define PIC32MX_STREAM_SLOTS	2
+
+static int pic32mx_check_write_status(uint32_t status)
+{
+	if (status & NVMCON_NVMERR)
+	{
+		LOG_ERROR("Flash write error NVMERR (status = 0x%08" PRIx32 ")", status);
+		return ERROR_FLASH_OPERATION_FAILED;
+	}
+
+	if (status & NVMCON_LVDERR)
+	{
+		LOG_ERROR("Flash write error LVDERR (status = 0x%08" PRIx32 ")", status);
+		return ERROR_FLASH_OPERATION_FAILED;
+	}
+
+	return ERROR_OK;
+}
+
+/* run the loader without data: it waits for the row programmed in the
+ * background and returns its status */
+static int pic32mx_wait_row(struct target *target, uint32_t entry,
+		struct working_area *source)
+{
+	uint32_t args[4];
+	uint32_t status;
+	int retval;
+
+	args[0] = args[1] = source->address;
+	args[2] = args[3] = 0;
+
+	if ((retval = mips32_stream_algorithm(target, entry, 4, args,
+			0, NULL, &status, 1000)) != ERROR_OK)
+	{
+		LOG_WARNING("error executing pic32mx flash stream loader");
+		return retval;
+	}
+
+	return pic32mx_check_write_status(status);
+}
+
 static int pic32mx_write_block(struct flash_bank *bank, uint8_t *buffer,
 		uint32_t offset, uint32_t count)
 {
@@ -410,6 +547,12 @@ static int pic32mx_write_block(struct flash_bank *bank, uint8_t *buffer,
 	init_reg_param(&reg_params[1], "a1", 32, PARAM_OUT);
 	init_reg_param(&reg_params[2], "a2", 32, PARAM_OUT);
 
+	/* keep the core context on the target for all buffers */
+	if ((retval = mips32_algorithm_session_begin(target)) != ERROR_OK)
+	{
+		count = 0;
+	}
+
 	while (count > 0)
 	{
 		uint32_t status;
@@ -455,6 +598,8 @@ static int pic32mx_write_block(struct flash_bank *bank, uint8_t *buffer,
 		count -= thisrun_count;
 	}
 
+	mips32_algorithm_session_end(target);
+
 	target_free_working_area(target, source);
 	target_free_working_area(target, pic32mx_info->write_algorithm);
 
@@ -465,6 +610,134 @@ static int pic32mx_write_block(struct flash_bank *bank, uint8_t *buffer,
 	return retval;
 }
 
+static int pic32mx_stream_block(struct flash_bank *bank, uint8_t *buffer,
+		uint32_t offset, uint32_t count)
+{
+	struct target *target = bank->target;
+	struct working_area *source;
+	uint32_t address = bank->base + offset;
+	uint32_t words[PIC32MX_ROW_SIZE / 4];
+	uint32_t args[4];
+	uint32_t entry, status;
+	int row_pending = 0;
+	int slot = 0;
+	int retval = ERROR_OK;
+	uint32_t i;
+
+	struct pic32mx_flash_bank *pic32mx_info = bank->driver_priv;
+	struct mips32_common *mips32 = target->arch_info;
+
+	/* the loader is fed through the queued PrAcc engine */
+	if (!mips32->ejtag_info.queued_pracc)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	/* flash write code, below it the loader saves its registers */
+	if (target_alloc_working_area(target,
+			MIPS32_PRACC_STREAM_SAVE_SIZE + sizeof(pic32mx_flash_stream_code),
+			&pic32mx_info->write_algorithm) != ERROR_OK)
+	{
+		LOG_WARNING("no working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	};
+
+	entry = pic32mx_info->write_algorithm->address + MIPS32_PRACC_STREAM_SAVE_SIZE;
+
+	if ((retval = target_write_buffer(target, entry,
+			sizeof(pic32mx_flash_stream_code),
+			(uint8_t*)pic32mx_flash_stream_code)) != ERROR_OK)
+	{
+		target_free_working_area(target, pic32mx_info->write_algorithm);
+		return retval;
+	}
+
+	/* ring of row buffers */
+	if (target_alloc_working_area(target, PIC32MX_STREAM_SLOTS * PIC32MX_ROW_SIZE,
+			&source) != ERROR_OK)
+	{
+		target_free_working_area(target, pic32mx_info->write_algorithm);
+
+		LOG_WARNING("no large enough working area available, can't do block memory writes");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	while (count > 0)
+	{
+		uint32_t slot_address = source->address + slot * PIC32MX_ROW_SIZE;
+		uint32_t row_offset = Virt2Phys(address) % PIC32MX_ROW_SIZE;
+		uint32_t thisrun_count;
+		uint32_t op;
+		int check_status;
+
+		/* a row write needs a whole, aligned row; up to the next row
+		 * boundary the words are written one by one */
+		if ((row_offset == 0) && (count >= PIC32MX_ROW_SIZE / 4))
+		{
+			thisrun_count = PIC32MX_ROW_SIZE / 4;
+			op = NVMCON_NVMWREN | NVMCON_OP_ROW_PROG;
+		}
+		else
+		{
+			thisrun_count = (PIC32MX_ROW_SIZE - row_offset) / 4;
+			if (thisrun_count > count)
+				thisrun_count = count;
+			op = NVMCON_NVMWREN | NVMCON_OP_WORD_PROG;
+		}
+
+		/* the status of a word run replaces the one of the row still
+		 * being programmed, so collect that first */
+		if (row_pending && (thisrun_count < PIC32MX_ROW_SIZE / 4))
+		{
+			row_pending = 0;
+			if ((retval = pic32mx_wait_row(target, entry, source)) != ERROR_OK)
+				break;
+		}
+
+		for (i = 0; i < thisrun_count; i++)
+			words[i] = target_buffer_get_u32(target, buffer + i * 4);
+
+		args[0] = slot_address;
+		args[1] = slot_address + thisrun_count * 4;
+		args[2] = Virt2Phys(address);
+		args[3] = op;
+
+		if ((retval = mips32_stream_algorithm(target, entry, 4, args,
+				thisrun_count, words, &status, 1000)) != ERROR_OK)
+		{
+			LOG_WARNING("error executing pic32mx flash stream loader");
+			row_pending = 0;
+			break;
+		}
+
+		/* the status is the one of the row started by the previous run,
+		 * or of the words just written */
+		check_status = row_pending || (thisrun_count < PIC32MX_ROW_SIZE / 4);
+		row_pending = (thisrun_count == PIC32MX_ROW_SIZE / 4);
+
+		if (check_status && ((retval = pic32mx_check_write_status(status)) != ERROR_OK))
+			break;
+
+		buffer += thisrun_count * 4;
+		address += thisrun_count * 4;
+		count -= thisrun_count;
+		slot = (slot + 1) % PIC32MX_STREAM_SLOTS;
+	}
+
+	/* wait for the last row, it is programmed in the background; the
+	 * first error is the one reported */
+	if (row_pending)
+	{
+		int finish_retval = pic32mx_wait_row(target, entry, source);
+
+		if (retval == ERROR_OK)
+			retval = finish_retval;
+	}
+
+	target_free_working_area(target, source);
+	target_free_working_area(target, pic32mx_info->write_algorithm);
+
+	return retval;
+}
+
 static int pic32mx_write_word(struct flash_bank *bank, uint32_t address, uint32_t word)
 {
 	struct target *target = bank->target;
@@ -502,8 +775,13 @@ static int pic32mx_write(struct flash_bank *bank, uint8_t *buffer, uint32_t offs
 	/* multiple words (4-byte) to be programmed? */
 	if (words_remaining > 0)
 	{
-		/* try using a block write */
-		if ((retval = pic32mx_write_block(bank, buffer, offset, words_remaining)) != ERROR_OK)
+		/* try streaming the rows, then a block write; a failed stream
+		 * is written again from the start by the block write */
+		retval = pic32mx_stream_block(bank, buffer, offset, words_remaining);
+		if ((retval != ERROR_OK) && (retval != ERROR_FLASH_OPERATION_FAILED))
+			retval = pic32mx_write_block(bank, buffer, offset, words_remaining);
+
+		if (retval != ERROR_OK)
 		{
 			if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
 			{
@@ -83,7 +83,7 @@ bool buf_cmp(const void *_buf1, const void *_buf2, unsigned size)
 
 	unsigned last = size / 8;
 	if (memcmp(_buf1, _buf2, last) != 0)
-		return false;
+		return true;
 
 	unsigned trailing = size % 8;
 	if (!trailing)
@@ -101,7 +101,19 @@ bool buf_cmp_mask(const void *_buf1, const void *_buf2,
 
 	const uint8_t *buf1 = _buf1, *buf2 = _buf2, *mask = _mask;
 	unsigned last = size / 8;
-	for (unsigned i = 0; i < last; i++)
+	unsigned i = 0;
+
+	/* eight bytes at a time, byte order does not matter here */
+	for (; i + 8 <= last; i += 8)
+	{
+		uint64_t a, b, m;
+		memcpy(&a, buf1 + i, 8);
+		memcpy(&b, buf2 + i, 8);
+		memcpy(&m, mask + i, 8);
+		if ((a ^ b) & m)
+			return true;
+	}
+	for (; i < last; i++)
 	{
 		if (buf_cmp_masked(buf1[i], buf2[i], mask[i]))
 			return true;
@@ -128,23 +140,96 @@ void* buf_set_ones(void *_buf, unsigned size)
 	return buf;
 }
 
+/* little endian load and store of 64 bits, any alignment */
+static inline uint64_t buf_load_u64(const uint8_t *p)
+{
+	return ((uint64_t)p[0]) | ((uint64_t)p[1] << 8) |
+		((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+		((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) |
+		((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline void buf_store_u64(uint8_t *p, uint64_t v)
+{
+	for (unsigned i = 0; i < 8; i++, v >>= 8)
+		p[i] = v;
+}
+
+/* up to 8 bits of src starting at bit start, only touching bytes
+ * that hold some of them */
+static inline uint8_t buf_get_bits(const uint8_t *src, unsigned start, unsigned num)
+{
+	unsigned idx = start / 8, shift = start % 8;
+	unsigned bits = src[idx] >> shift;
+
+	if (shift + num > 8)
+		bits |= src[idx + 1] << (8 - shift);
+
+	return bits & ((1 << num) - 1);
+}
+
+/* replace num (at most 8, not crossing a byte) bits of dst at bit start */
+static inline void buf_put_bits(uint8_t *dst, unsigned start, unsigned num, uint8_t bits)
+{
+	uint8_t mask = ((1 << num) - 1) << (start % 8);
+
+	dst[start / 8] = (dst[start / 8] & ~mask) | ((bits << (start % 8)) & mask);
+}
+
 void* buf_set_buf(const void *_src, unsigned src_start,
 		void *_dst, unsigned dst_start, unsigned len)
 {
 	const uint8_t *src = _src;
 	uint8_t *dst = _dst;
+	unsigned n;
 
-	unsigned src_idx = src_start, dst_idx = dst_start;
-	for (unsigned i = 0; i < len; i++)
+	/* byte aligned on both sides: plain copy */
+	if ((src_start % 8) == 0 && (dst_start % 8) == 0)
 	{
-		if (((src[src_idx / 8] >> (src_idx % 8)) & 1) == 1)
-			dst[dst_idx / 8] |= 1 << (dst_idx % 8);
-		else
-			dst[dst_idx / 8] &= ~(1 << (dst_idx % 8));
-		dst_idx++;
-		src_idx++;
+		memcpy(dst + dst_start / 8, src + src_start / 8, len / 8);
+		if (len % 8)
+			buf_put_bits(dst, dst_start + (len & ~7u), len % 8,
+					src[(src_start + len) / 8]);
+		return dst;
+	}
+
+	/* bring the destination to a byte boundary */
+	if (dst_start % 8)
+	{
+		n = 8 - (dst_start % 8);
+		if (n > len)
+			n = len;
+		buf_put_bits(dst, dst_start, n, buf_get_bits(src, src_start, n));
+		src_start += n;
+		dst_start += n;
+		len -= n;
 	}
 
+	uint8_t *d = dst + dst_start / 8;
+	const uint8_t *s = src + src_start / 8;
+	unsigned shift = src_start % 8;
+
+	if (shift == 0)
+	{
+		memcpy(d, s, len / 8);
+		d += len / 8;
+		s += len / 8;
+	}
+	else
+	{
+		/* 64 bits per step, shift-merging in the first bits of the
+		 * following source byte, which always exists when shift != 0 */
+		for (n = len / 64; n; n--, d += 8, s += 8)
+			buf_store_u64(d, (buf_load_u64(s) >> shift) |
+					((uint64_t)s[8] << (64 - shift)));
+
+		for (n = (len % 64) / 8; n; n--, d++, s++)
+			*d = (s[0] >> shift) | (s[1] << (8 - shift));
+	}
+
+	if (len % 8)
+		buf_put_bits(d, 0, len % 8, buf_get_bits(s, shift, len % 8));
+
 	return dst;
 }
 
@@ -48,14 +48,14 @@ static inline void buf_set_u32(void *_buffer,
 		buffer[2] = (value >> 16) & 0xff;
 		buffer[1] = (value >> 8) & 0xff;
 		buffer[0] = (value >> 0) & 0xff;
-	} else {
-		for (unsigned i = first; i < first + num; i++)
-		{
-			if (((value >> (i - first)) & 1) == 1)
-				buffer[i / 8] |= 1 << (i % 8);
-			else
-				buffer[i / 8] &= ~(1 << (i % 8));
-		}
+	} else if (num) {
+		/* merge a byte at a time, the field spans at most five bytes */
+		unsigned last = (first + num - 1) / 8;
+		uint64_t mask = ((((uint64_t)1) << num) - 1) << (first % 8);
+		uint64_t bits = ((uint64_t)value) << (first % 8);
+
+		for (unsigned i = first / 8; i <= last; i++, mask >>= 8, bits >>= 8)
+			buffer[i] = (buffer[i] & ~(uint8_t)mask) | (bits & mask);
 	}
 }
 /**
@@ -77,15 +77,17 @@ static inline uint32_t buf_get_u32(const void *_buffer,
 			(((uint32_t)buffer[2]) << 16) |
 			(((uint32_t)buffer[1]) << 8) |
 			(((uint32_t)buffer[0]) << 0);
-	} else {
-		uint32_t result = 0;
-		for (unsigned i = first; i < first + num; i++)
-		{
-			if (((buffer[i / 8] >> (i % 8)) & 1) == 1)
-				result |= 1 << (i - first);
-		}
-		return result;
+	} else if (num) {
+		/* gather the bytes the field spans, then shift it into place */
+		unsigned last = (first + num - 1) / 8;
+		uint64_t bits = 0;
+
+		for (unsigned i = first / 8, shift = 0; i <= last; i++, shift += 8)
+			bits |= ((uint64_t)buffer[i]) << shift;
+		return (bits >> (first % 8)) & ((((uint64_t)1) << num) - 1);
 	}
+
+	return 0;
 }
 
 /**
@@ -36,12 +36,25 @@
 
 struct cmd_queue_page {
 	void *address;
+	size_t size;
 	size_t used;
 	struct cmd_queue_page *next;
 };
 
 #define CMD_QUEUE_PAGE_SIZE (1024 * 1024)
+
+/* Pages are kept across queue resets and handed out again in list order.
+ * cmd_queue_tail is the page allocations currently come from, the pages
+ * after it are empty and waiting for reuse. */
 static struct cmd_queue_page *cmd_queue_pages = NULL;
+static struct cmd_queue_page *cmd_queue_tail = NULL;
+
+/* pages used by the queue being built, and the decaying high-water mark
+ * of that count which decides how many pages survive a reset */
+static unsigned cmd_queue_pages_in_use = 0;
+static unsigned cmd_queue_high_water = 0;
+
+static struct cmd_queue_stats cmd_queue_stats;
 
 struct jtag_command *jtag_command_queue = NULL;
 static struct jtag_command **next_command_pointer = &jtag_command_queue;
@@ -60,11 +73,73 @@ void jtag_queue_command(struct jtag_command * cmd)
 	next_command_pointer = &cmd->next;
 }
 
+static struct cmd_queue_page *cmd_queue_page_new(size_t size)
+{
+	struct cmd_queue_page *page = malloc(sizeof(struct cmd_queue_page));
+	if (page == NULL)
+		return NULL;
+
+	page->address = malloc(size);
+	if (page->address == NULL)
+	{
+		free(page);
+		return NULL;
+	}
+	page->size = size;
+	page->used = 0;
+	page->next = NULL;
+
+	cmd_queue_stats.pages_allocated++;
+	cmd_queue_stats.pages_held++;
+
+	return page;
+}
+
+static void cmd_queue_page_free(struct cmd_queue_page *page)
+{
+	free(page->address);
+	free(page);
+
+	cmd_queue_stats.pages_freed++;
+	cmd_queue_stats.pages_held--;
+}
+
+/* make room for size bytes at the tail, reusing a retained page if it fits */
+static struct cmd_queue_page *cmd_queue_next_page(size_t size)
+{
+	struct cmd_queue_page *page;
+	struct cmd_queue_page **link;
+
+	link = cmd_queue_tail ? &cmd_queue_tail->next : &cmd_queue_pages;
+	page = *link;
+
+	if (page && (page->size >= size))
+	{
+		cmd_queue_stats.pages_reused++;
+	}
+	else
+	{
+		/* oversized requests get a page of their own */
+		page = cmd_queue_page_new((size > CMD_QUEUE_PAGE_SIZE) ? size : CMD_QUEUE_PAGE_SIZE);
+		if (page == NULL)
+			return NULL;
+		page->next = *link;
+		*link = page;
+	}
+
+	page->used = 0;
+	cmd_queue_tail = page;
+
+	if (++cmd_queue_pages_in_use > cmd_queue_stats.peak_pages)
+		cmd_queue_stats.peak_pages = cmd_queue_pages_in_use;
+
+	return page;
+}
+
 void* cmd_queue_alloc(size_t size)
 {
-	struct cmd_queue_page **p_page = &cmd_queue_pages;
-	int offset;
-	uint8_t *t;
+	struct cmd_queue_page *page = cmd_queue_tail;
+	size_t offset;
 
 	/*
 	 * WARNING:
@@ -98,50 +173,313 @@ void* cmd_queue_alloc(size_t size)
 	size = (size + ALIGN_SIZE -1) & (~(ALIGN_SIZE-1));
 	/* Done... */
 
-	if (*p_page)
+	if ((page == NULL) || (page->size - page->used < size))
 	{
-		while ((*p_page)->next)
-			p_page = &((*p_page)->next);
-		if (CMD_QUEUE_PAGE_SIZE - (*p_page)->used < size)
-			p_page = &((*p_page)->next);
+		page = cmd_queue_next_page(size);
+		if (page == NULL)
+		{
+			LOG_ERROR("out of memory for the JTAG command queue");
+			return NULL;
+		}
 	}
 
-	if (!*p_page)
-	{
-		*p_page = malloc(sizeof(struct cmd_queue_page));
-		(*p_page)->used = 0;
-		(*p_page)->address = malloc(CMD_QUEUE_PAGE_SIZE);
-		(*p_page)->next = NULL;
-	}
+	offset = page->used;
+	page->used += size;
 
-	offset = (*p_page)->used;
-	(*p_page)->used += size;
+	cmd_queue_stats.allocs++;
+	cmd_queue_stats.bytes += size;
 
-	t = (uint8_t *)((*p_page)->address);
-	return t + offset;
+	return (uint8_t *)page->address + offset;
 }
 
+/* Rewind the arena. Pages beyond the high-water mark are released, the
+ * mark decays by one page per reset so memory taken by one huge queue is
+ * given back gradually once the load drops. */
 static void cmd_queue_free(void)
 {
-	struct cmd_queue_page *page = cmd_queue_pages;
+	struct cmd_queue_page **link = &cmd_queue_pages;
+	unsigned kept = 0;
+
+	if (cmd_queue_pages_in_use >= cmd_queue_high_water)
+		cmd_queue_high_water = cmd_queue_pages_in_use;
+	else
+		cmd_queue_high_water--;
 
-	while (page)
+	while (*link)
 	{
-		struct cmd_queue_page *last = page;
-		free(page->address);
-		page = page->next;
-		free(last);
+		struct cmd_queue_page *page = *link;
+
+		if ((kept < cmd_queue_high_water) && (page->size == CMD_QUEUE_PAGE_SIZE))
+		{
+			page->used = 0;
+			link = &page->next;
+			kept++;
+			continue;
+		}
+
+		*link = page->next;
+		cmd_queue_page_free(page);
 	}
 
-	cmd_queue_pages = NULL;
+	cmd_queue_tail = NULL;
+	cmd_queue_pages_in_use = 0;
+	cmd_queue_stats.resets++;
+}
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats)
+{
+	*stats = cmd_queue_stats;
 }
 
+/* an IR capture owed to a dropped scan, taken from the scan that stays */
+struct jtag_capture_copy {
+	const uint8_t *src;
+	uint8_t *dst;
+	int num_bits;
+	struct jtag_capture_copy *next;
+};
+
+static struct jtag_capture_copy *jtag_capture_copies;
+
 void jtag_command_queue_reset(void)
 {
 	cmd_queue_free();
 
 	jtag_command_queue = NULL;
 	next_command_pointer = &jtag_command_queue;
+	jtag_capture_copies = NULL;
+}
+
+static bool jtag_queue_optimize_enabled = false;
+static struct jtag_queue_optimize_stats jtag_queue_optimize_stats;
+
+void jtag_set_queue_optimize(bool enable)
+{
+	jtag_queue_optimize_enabled = enable;
+}
+
+bool jtag_get_queue_optimize(void)
+{
+	return jtag_queue_optimize_enabled;
+}
+
+void jtag_get_queue_optimize_stats(struct jtag_queue_optimize_stats *stats)
+{
+	*stats = jtag_queue_optimize_stats;
+}
+
+static bool jtag_scan_same_out(const uint8_t *a, const uint8_t *b, int num_bits)
+{
+	if (!a || !b)
+		return a == b;
+
+	return !buf_cmp(a, b, num_bits);
+}
+
+/*
+ * True if scan b loads the IR with what scan a left there.  Capture-IR
+ * loads the same pattern whatever the instruction, so b may capture a
+ * TAP that a captures too, as the IR capture check does by default;
+ * b's capture is then copied from a's, see jtag_scan_owe_capture().
+ */
+static bool jtag_scan_same_ir(const struct scan_command *a,
+		const struct scan_command *b)
+{
+	int i;
+
+	if (a->num_fields != b->num_fields)
+		return false;
+
+	for (i = 0; i < b->num_fields; i++)
+	{
+		if (a->fields[i].num_bits != b->fields[i].num_bits)
+			return false;
+		if (b->fields[i].in_value && !a->fields[i].in_value)
+			return false;
+		if (!jtag_scan_same_out(a->fields[i].out_value, b->fields[i].out_value,
+				b->fields[i].num_bits))
+			return false;
+	}
+
+	return true;
+}
+
+/* queue copying what a captures into the in_values of the dropped scan b */
+static void jtag_scan_owe_capture(const struct scan_command *a,
+		const struct scan_command *b)
+{
+	int i;
+
+	for (i = 0; i < b->num_fields; i++)
+	{
+		struct jtag_capture_copy *copy;
+
+		if (!b->fields[i].in_value)
+			continue;
+
+		copy = cmd_queue_alloc(sizeof(struct jtag_capture_copy));
+		copy->src = a->fields[i].in_value;
+		copy->dst = b->fields[i].in_value;
+		copy->num_bits = b->fields[i].num_bits;
+		copy->next = jtag_capture_copies;
+		jtag_capture_copies = copy;
+	}
+}
+
+void jtag_command_queue_copy_captures(void)
+{
+	struct jtag_capture_copy *copy;
+
+	for (copy = jtag_capture_copies; copy; copy = copy->next)
+		buf_cpy(copy->src, copy->dst, copy->num_bits);
+}
+
+/* Scan b can continue scan a in the same shift when a parks in the pause
+ * state of the same register: leaving pause goes back to shift without
+ * passing capture or update, so the data register never sees the split. */
+static bool jtag_scan_fusable(const struct scan_command *a,
+		const struct scan_command *b)
+{
+	if (a->ir_scan != b->ir_scan)
+		return false;
+
+	return a->end_state == (a->ir_scan ? TAP_IRPAUSE : TAP_DRPAUSE);
+}
+
+/*
+ * Append b's fields to a's.  Runs of scans fuse into the same command, so
+ * the field array grows geometrically; *room is the capacity of a's array
+ * when an earlier fuse allocated it, else 0.
+ */
+static void jtag_scan_fuse(struct scan_command *a, const struct scan_command *b, int *room)
+{
+	int num_fields = a->num_fields + b->num_fields;
+
+	if (num_fields > *room)
+	{
+		struct scan_field *fields;
+
+		*room = num_fields * 2;
+		if (*room < 16)
+			*room = 16;
+		fields = cmd_queue_alloc(*room * sizeof(struct scan_field));
+		memcpy(fields, a->fields, a->num_fields * sizeof(struct scan_field));
+		a->fields = fields;
+	}
+	memcpy(a->fields + a->num_fields, b->fields, b->num_fields * sizeof(struct scan_field));
+
+	a->num_fields = num_fields;
+	a->end_state = b->end_state;
+}
+
+/*
+ * Rewrite the queue into an equivalent, shorter one:
+ * - IR scans that reload the instruction already in the IR, from the
+ *   state they would end in anyway, are dropped;
+ * - runtest and stableclocks commands spent in Run-Test/Idle are merged;
+ * - a scan parked in its pause state is fused with the following scan
+ *   of the same register.
+ * The state of the TAPs and the IR are only tracked within the queue,
+ * anything that may reset or move them unpredictably forgets them.
+ */
+void jtag_command_queue_optimize(void)
+{
+	struct jtag_command **link = &jtag_command_queue;
+	struct jtag_command *prev = NULL;
+	struct scan_command *ir = NULL;
+	tap_state_t state = TAP_INVALID;
+	/* capacity of prev's fields, once fusing has grown them */
+	int fused_room = 0;
+
+	if (!jtag_queue_optimize_enabled)
+		return;
+
+	while (*link)
+	{
+		struct jtag_command *cmd = *link;
+		bool drop = false;
+
+		jtag_queue_optimize_stats.commands++;
+
+		switch (cmd->type)
+		{
+		case JTAG_SCAN:
+		{
+			struct scan_command *scan = cmd->cmd.scan;
+
+			if (scan->ir_scan && ir && (state == scan->end_state)
+					&& jtag_scan_same_ir(ir, scan))
+			{
+				jtag_scan_owe_capture(ir, scan);
+				jtag_queue_optimize_stats.ir_scans_dropped++;
+				drop = true;
+			}
+			else if (prev && (prev->type == JTAG_SCAN)
+					&& jtag_scan_fusable(prev->cmd.scan, scan))
+			{
+				jtag_scan_fuse(prev->cmd.scan, scan, &fused_room);
+				jtag_queue_optimize_stats.scans_fused++;
+				drop = true;
+				/* the IR now holds the tail of the fused scan */
+				if (scan->ir_scan)
+					ir = NULL;
+			}
+			else if (scan->ir_scan)
+				ir = scan;
+
+			state = scan->end_state;
+			break;
+		}
+		case JTAG_RUNTEST:
+			if (prev && (prev->type == JTAG_RUNTEST)
+					&& (prev->cmd.runtest->end_state == TAP_IDLE))
+			{
+				prev->cmd.runtest->num_cycles += cmd->cmd.runtest->num_cycles;
+				prev->cmd.runtest->end_state = cmd->cmd.runtest->end_state;
+				jtag_queue_optimize_stats.clocks_merged++;
+				drop = true;
+			}
+			state = cmd->cmd.runtest->end_state;
+			break;
+		case JTAG_STABLECLOCKS:
+			if (prev && (prev->type == JTAG_STABLECLOCKS))
+			{
+				prev->cmd.stableclocks->num_cycles += cmd->cmd.stableclocks->num_cycles;
+				jtag_queue_optimize_stats.clocks_merged++;
+				drop = true;
+			}
+			else if (prev && (prev->type == JTAG_RUNTEST)
+					&& (prev->cmd.runtest->end_state == TAP_IDLE))
+			{
+				prev->cmd.runtest->num_cycles += cmd->cmd.stableclocks->num_cycles;
+				jtag_queue_optimize_stats.clocks_merged++;
+				drop = true;
+			}
+			break;
+		case JTAG_SLEEP:
+			break;
+		case JTAG_TLR_RESET:
+			state = TAP_RESET;
+			ir = NULL;
+			break;
+		default:
+			state = TAP_INVALID;
+			ir = NULL;
+			break;
+		}
+
+		if (drop)
+		{
+			*link = cmd->next;
+			continue;
+		}
+
+		prev = cmd;
+		fused_room = 0;
+		link = &cmd->next;
+	}
+
+	next_command_pointer = link;
 }
 
 enum scan_type jtag_scan_type(const struct scan_command *cmd)
@@ -174,16 +512,13 @@ int jtag_scan_size(const struct scan_command *cmd)
 	return bit_count;
 }
 
-int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
+/* pack the out_value of all fields into buffer, fields without one
+ * are shifted out as zeroes */
+static int jtag_fill_buffer(const struct scan_command *cmd, uint8_t *buffer)
 {
 	int bit_count = 0;
 	int i;
 
-	bit_count = jtag_scan_size(cmd);
-	*buffer = calloc(1,DIV_ROUND_UP(bit_count, 8));
-
-	bit_count = 0;
-
 	DEBUG_JTAG_IO("%s num_fields: %i",
 			cmd->ir_scan ? "IRSCAN" : "DRSCAN",
 			cmd->num_fields);
@@ -202,7 +537,7 @@ int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
 					cmd->fields[i].num_bits, char_buf);
 			free(char_buf);
 #endif
-			buf_set_buf(cmd->fields[i].out_value, 0, *buffer,
+			buf_set_buf(cmd->fields[i].out_value, 0, buffer,
 					bit_count, cmd->fields[i].num_bits);
 		}
 		else
@@ -219,27 +554,61 @@ int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
 	return bit_count;
 }
 
-int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
+int jtag_build_buffer(const struct scan_command *cmd, uint8_t **buffer)
 {
+	*buffer = calloc(1, DIV_ROUND_UP(jtag_scan_size(cmd), 8));
+
+	return jtag_fill_buffer(cmd, *buffer);
+}
+
+uint8_t *jtag_scan_buffer(int num_bits)
+{
+	return cmd_queue_alloc(DIV_ROUND_UP(num_bits, 8));
+}
+
+int jtag_build_queue_buffer(const struct scan_command *cmd, uint8_t **buffer)
+{
+	int num_bytes = DIV_ROUND_UP(jtag_scan_size(cmd), 8);
 	int i;
-	int bit_count = 0;
-	int retval;
 
-	/* we return ERROR_OK, unless a check fails, or a handler reports a problem */
-	retval = ERROR_OK;
+	*buffer = cmd_queue_alloc(num_bytes);
+
+	/* queue memory is recycled, clear it only if some bits are not
+	 * covered by an out_value */
+	for (i = 0; i < cmd->num_fields; i++)
+	{
+		if (cmd->fields[i].out_value == NULL)
+		{
+			memset(*buffer, 0, num_bytes);
+			break;
+		}
+	}
+
+	return jtag_fill_buffer(cmd, *buffer);
+}
+
+int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
+{
+	return jtag_read_buffer_at(buffer, 0, cmd);
+}
+
+int jtag_read_buffer_at(const uint8_t *buffer, int first, const struct scan_command *cmd)
+{
+	int i;
+	int bit_count = first;
 
 	for (i = 0; i < cmd->num_fields; i++)
 	{
-		/* if neither in_value nor in_handler
-		 * are specified we don't have to examine this field
-		 */
+		/* if no in_value is specified we don't have to examine this field */
 		if (cmd->fields[i].in_value)
 		{
 			int num_bits = cmd->fields[i].num_bits;
-			uint8_t *captured = buf_set_buf(buffer, bit_count, malloc(DIV_ROUND_UP(num_bits, 8)), 0, num_bits);
+
+			/* straight from the receive buffer into the field */
+			buf_set_buf(buffer, bit_count, cmd->fields[i].in_value, 0, num_bits);
 
 #ifdef _DEBUG_JTAG_IO_
-			char *char_buf = buf_to_str(captured,
+			char *char_buf = buf_to_str(cmd->fields[i].in_value,
 					(num_bits > DEBUG_JTAG_IOZ)
 						? DEBUG_JTAG_IOZ
 						: num_bits, 16);
@@ -248,18 +617,11 @@ int jtag_read_buffer(uint8_t *buffer, const struct scan_command *cmd)
 					i, num_bits, char_buf);
 			free(char_buf);
 #endif
-
-			if (cmd->fields[i].in_value)
-			{
-				buf_cpy(captured, cmd->fields[i].in_value, num_bits);
-			}
-
-			free(captured);
 		}
 		bit_count += cmd->fields[i].num_bits;
 	}
 
-	return retval;
+	/* checks and handlers run later as queue callbacks */
+	return ERROR_OK;
 }
 
-
@@ -166,12 +166,80 @@ extern struct jtag_command* jtag_command_queue;
 
 void* cmd_queue_alloc(size_t size);
 
+/// Allocation counters of the command queue arena, cumulative since startup.
+struct cmd_queue_stats {
+	/// number of cmd_queue_alloc() calls
+	uint64_t allocs;
+	/// bytes handed out, after alignment
+	uint64_t bytes;
+	/// queue resets
+	uint64_t resets;
+	/// pages obtained from malloc()
+	uint64_t pages_allocated;
+	/// retained pages handed out again
+	uint64_t pages_reused;
+	/// pages returned to the heap by the trim policy
+	uint64_t pages_freed;
+	/// pages currently owned by the arena
+	unsigned pages_held;
+	/// most pages used by a single queue
+	unsigned peak_pages;
+};
+
+void cmd_queue_get_stats(struct cmd_queue_stats *stats);
+
 void jtag_queue_command(struct jtag_command *cmd);
 void jtag_command_queue_reset(void);
 
+/// Counters of the queue optimizer, cumulative since startup.
+struct jtag_queue_optimize_stats {
+	/// commands examined
+	uint64_t commands;
+	/// IR scans removed because the IR already held the instruction
+	uint64_t ir_scans_dropped;
+	/// runtest and stableclocks commands merged into their predecessor
+	uint64_t clocks_merged;
+	/// scans fused into the preceding scan of the same register
+	uint64_t scans_fused;
+};
+
+void jtag_set_queue_optimize(bool enable);
+bool jtag_get_queue_optimize(void);
+void jtag_get_queue_optimize_stats(struct jtag_queue_optimize_stats *stats);
+
+/**
+ * When enabled with jtag_set_queue_optimize(), rewrite the command queue
+ * into an equivalent one with fewer commands. Called right before the
+ * queue is handed to the interface driver.
+ */
+void jtag_command_queue_optimize(void);
+
+/**
+ * Fill in the captures of IR scans dropped by jtag_command_queue_optimize()
+ * from the scans they duplicate. Called once the driver has executed the
+ * queue, before the callbacks run.
+ */
+void jtag_command_queue_copy_captures(void);
+
 enum scan_type jtag_scan_type(const struct scan_command* cmd);
 int jtag_scan_size(const struct scan_command* cmd);
 int jtag_read_buffer(uint8_t* buffer, const struct scan_command* cmd);
 int jtag_build_buffer(const struct scan_command* cmd, uint8_t** buffer);
 
+/**
+ * Like jtag_build_buffer(), but the buffer is taken from the command queue
+ * and released together with it. The caller must not free() it.
+ */
+int jtag_build_queue_buffer(const struct scan_command* cmd, uint8_t** buffer);
+/**
+ * A bit buffer for at least @a num_bits, taken from the command queue and
+ * valid until the queue is reset. The contents are undefined.
+ */
+uint8_t* jtag_scan_buffer(int num_bits);
+/**
+ * Scatter the captured bits of a scan, starting at bit @a first of the
+ * driver's receive buffer, straight into the in_value of its fields.
+ */
+int jtag_read_buffer_at(const uint8_t* buffer, int first, const struct scan_command* cmd);
+
 #endif // JTAG_COMMANDS_H
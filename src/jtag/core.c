@@ -34,6 +34,7 @@
 #include "jtag.h"
 #include "interface.h"
 #include "transport.h"
+#include "stats.h"
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -815,7 +816,6 @@ void jtag_check_value_mask(struct scan_field *field, uint8_t *value, uint8_t *ma
 }
 
 
-
 int default_interface_jtag_execute_queue(void)
 {
 	if (NULL == jtag)
@@ -832,7 +832,9 @@ int default_interface_jtag_execute_queue(void)
 void jtag_execute_queue_noclear(void)
 {
 	jtag_flush_queue_count++;
+	jtag_stats_flush_begin();
 	jtag_set_error(interface_jtag_execute_queue());
+	jtag_stats_flush_end();
 
 	if (jtag_flush_queue_sleep > 0)
 	{
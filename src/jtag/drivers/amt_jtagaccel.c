@@ -372,13 +372,11 @@ static int amt_jtagaccel_execute_queue(void)
 				LOG_DEBUG("scan end in %i", cmd->cmd.scan->end_state);
 #endif
 				amt_jtagaccel_end_state(cmd->cmd.scan->end_state);
-				scan_size = jtag_build_buffer(cmd->cmd.scan, &buffer);
+				scan_size = jtag_build_queue_buffer(cmd->cmd.scan, &buffer);
 				type = jtag_scan_type(cmd->cmd.scan);
 				amt_jtagaccel_scan(cmd->cmd.scan->ir_scan, type, buffer, scan_size);
 				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
-				if (buffer)
-					free(buffer);
 				break;
 			case JTAG_SLEEP:
 #ifdef _DEBUG_JTAG_IO_
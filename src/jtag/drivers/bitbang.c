@@ -74,19 +74,71 @@ static void bitbang_end_state(tap_state_t state)
 	}
 }
 
+/* first error reported by a batched driver in this queue */
+static int bitbang_batch_error;
+
+static bool bitbang_batched(void)
+{
+	return bitbang_interface->clock_bits && bitbang_interface->flush;
+}
+
+/* Clock num cycles with TMS and TDI from the bit arrays (NULL for zeroes),
+ * sampling TDO into tdo unless it is NULL. tdo may be the tdi buffer. */
+static void bitbang_clock_bits(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned num)
+{
+	int tms_bit = 0;
+
+	if (bitbang_batched())
+	{
+		int retval = bitbang_interface->clock_bits(tms, tdi, tdo, num);
+		if ((retval != ERROR_OK) && (bitbang_batch_error == ERROR_OK))
+			bitbang_batch_error = retval;
+		return;
+	}
+
+	for (unsigned i = 0; i < num; i++)
+	{
+		int val = 0;
+		int tdi_bit = 0;
+		int bytec = i / 8;
+		int bcval = 1 << (i % 8);
+
+		if (tms)
+			tms_bit = (tms[bytec] & bcval) ? 1 : 0;
+
+		/* if we're just reading the scan, but don't care about the output
+		 * default to outputting 'low', this also makes valgrind traces more readable,
+		 * as it removes the dependency on an uninitialised value
+		 */
+		if (tdi && (tdi[bytec] & bcval))
+			tdi_bit = 1;
+
+		bitbang_interface->write(0, tms_bit, tdi_bit);
+
+		if (tdo)
+			val = bitbang_interface->read();
+
+		bitbang_interface->write(1, tms_bit, tdi_bit);
+
+		if (tdo)
+		{
+			if (val)
+				tdo[bytec] |= bcval;
+			else
+				tdo[bytec] &= ~bcval;
+		}
+	}
+	bitbang_interface->write(CLOCK_IDLE(), tms_bit, 0);
+}
+
 static void bitbang_state_move(int skip)
 {
-	int i = 0, tms = 0;
 	uint8_t tms_scan = tap_get_tms_path(tap_get_state(), tap_get_end_state());
 	int tms_count = tap_get_tms_path_len(tap_get_state(), tap_get_end_state());
 
-	for (i = skip; i < tms_count; i++)
-	{
-		tms = (tms_scan >> i) & 1;
-		bitbang_interface->write(0, tms, 0);
-		bitbang_interface->write(1, tms, 0);
-	}
-	bitbang_interface->write(CLOCK_IDLE(), tms, 0);
+	tms_scan >>= skip;
+	bitbang_clock_bits(&tms_scan, NULL, NULL, tms_count - skip);
 
 	tap_set_state(tap_get_end_state());
 }
@@ -103,14 +155,7 @@ static int bitbang_execute_tms(struct jtag_command *cmd)
 
 	DEBUG_JTAG_IO("TMS: %d bits", num_bits);
 
-	int tms = 0;
-	for (unsigned i = 0; i < num_bits; i++)
-	{
-		tms = ((bits[i/8] >> (i % 8)) & 1);
-		bitbang_interface->write(0, tms, 0);
-		bitbang_interface->write(1, tms, 0);
-	}
-	bitbang_interface->write(CLOCK_IDLE(), tms, 0);
+	bitbang_clock_bits(bits, NULL, NULL, num_bits);
 
 	return ERROR_OK;
 }
@@ -120,18 +165,19 @@ static void bitbang_path_move(struct pathmove_command *cmd)
 {
 	int num_states = cmd->num_states;
 	int state_count;
-	int tms = 0;
+	uint8_t *tms = jtag_scan_buffer(num_states);
 
-	state_count = 0;
-	while (num_states)
+	memset(tms, 0, DIV_ROUND_UP(num_states, 8));
+
+	for (state_count = 0; state_count < num_states; state_count++)
 	{
 		if (tap_state_transition(tap_get_state(), false) == cmd->path[state_count])
 		{
-			tms = 0;
+			/* TMS low */
 		}
 		else if (tap_state_transition(tap_get_state(), true) == cmd->path[state_count])
 		{
-			tms = 1;
+			tms[state_count / 8] |= 1 << (state_count % 8);
 		}
 		else
 		{
@@ -139,23 +185,16 @@ static void bitbang_path_move(struct pathmove_command *cmd)
 			exit(-1);
 		}
 
-		bitbang_interface->write(0, tms, 0);
-		bitbang_interface->write(1, tms, 0);
-
 		tap_set_state(cmd->path[state_count]);
-		state_count++;
-		num_states--;
 	}
 
-	bitbang_interface->write(CLOCK_IDLE(), tms, 0);
+	bitbang_clock_bits(tms, NULL, NULL, num_states);
 
 	tap_set_end_state(tap_get_state());
 }
 
 static void bitbang_runtest(int num_cycles)
 {
-	int i;
-
 	tap_state_t saved_end_state = tap_get_end_state();
 
 	/* only do a state_move when we're not already in IDLE */
@@ -166,12 +205,7 @@ static void bitbang_runtest(int num_cycles)
 	}
 
 	/* execute num_cycles */
-	for (i = 0; i < num_cycles; i++)
-	{
-		bitbang_interface->write(0, 0, 0);
-		bitbang_interface->write(1, 0, 0);
-	}
-	bitbang_interface->write(CLOCK_IDLE(), 0, 0);
+	bitbang_clock_bits(NULL, NULL, NULL, num_cycles);
 
 	/* finish in end_state */
 	bitbang_end_state(saved_end_state);
@@ -182,15 +216,17 @@ static void bitbang_runtest(int num_cycles)
 
 static void bitbang_stableclocks(int num_cycles)
 {
-	int tms = (tap_get_state() == TAP_RESET ? 1 : 0);
-	int i;
+	uint8_t *tms = NULL;
 
-	/* send num_cycles clocks onto the cable */
-	for (i = 0; i < num_cycles; i++)
+	/* TMS stays high in RESET, low in the other stable states */
+	if (tap_get_state() == TAP_RESET)
 	{
-		bitbang_interface->write(1, tms, 0);
-		bitbang_interface->write(0, tms, 0);
+		tms = jtag_scan_buffer(num_cycles);
+		memset(tms, 0xff, DIV_ROUND_UP(num_cycles, 8));
 	}
+
+	/* send num_cycles clocks onto the cable */
+	bitbang_clock_bits(tms, NULL, NULL, num_cycles);
 }
 
 
@@ -198,7 +234,7 @@ static void bitbang_stableclocks(int num_cycles)
 static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int scan_size)
 {
 	tap_state_t saved_end_state = tap_get_end_state();
-	int bit_cnt;
+	uint8_t *tms;
 
 	if (!((!ir_scan && (tap_get_state() == TAP_DRSHIFT)) || (ir_scan && (tap_get_state() == TAP_IRSHIFT))))
 	{
@@ -211,37 +247,13 @@ static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int
 		bitbang_end_state(saved_end_state);
 	}
 
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++)
-	{
-		int val = 0;
-		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
-		int tdi;
-		int bytec = bit_cnt/8;
-		int bcval = 1 << (bit_cnt % 8);
-
-		/* if we're just reading the scan, but don't care about the output
-		 * default to outputting 'low', this also makes valgrind traces more readable,
-		 * as it removes the dependency on an uninitialised value
-		 */
-		tdi = 0;
-		if ((type != SCAN_IN) && (buffer[bytec] & bcval))
-			tdi = 1;
-
-		bitbang_interface->write(0, tms, tdi);
+	/* TMS goes high with the last bit, leaving the shift state */
+	tms = jtag_scan_buffer(scan_size);
+	memset(tms, 0, DIV_ROUND_UP(scan_size, 8));
+	tms[(scan_size - 1) / 8] |= 1 << ((scan_size - 1) % 8);
 
-		if (type != SCAN_OUT)
-			val = bitbang_interface->read();
-
-		bitbang_interface->write(1, tms, tdi);
-
-		if (type != SCAN_OUT)
-		{
-			if (val)
-				buffer[bytec] |= bcval;
-			else
-				buffer[bytec] &= ~bcval;
-		}
-	}
+	bitbang_clock_bits(tms, (type != SCAN_IN) ? buffer : NULL,
+			(type != SCAN_OUT) ? buffer : NULL, scan_size);
 
 	if (tap_get_state() != tap_get_end_state())
 	{
@@ -253,6 +265,63 @@ static void bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer, int
 	}
 }
 
+/* scans whose captured bits arrive with the next batched flush */
+struct bitbang_pending_scan {
+	struct scan_command *scan;
+	uint8_t *buffer;
+};
+
+static struct bitbang_pending_scan *bitbang_pending;
+static unsigned bitbang_num_pending;
+static unsigned bitbang_max_pending;
+
+static int bitbang_add_pending(struct scan_command *scan, uint8_t *buffer)
+{
+	if (bitbang_num_pending == bitbang_max_pending)
+	{
+		unsigned max = bitbang_max_pending ? (bitbang_max_pending * 2) : 64;
+		struct bitbang_pending_scan *pending;
+
+		pending = realloc(bitbang_pending, max * sizeof(*pending));
+		if (pending == NULL)
+			return ERROR_FAIL;
+		bitbang_pending = pending;
+		bitbang_max_pending = max;
+	}
+
+	bitbang_pending[bitbang_num_pending].scan = scan;
+	bitbang_pending[bitbang_num_pending].buffer = buffer;
+	bitbang_num_pending++;
+
+	return ERROR_OK;
+}
+
+/* execute the batched cycles, then hand the captured bits to the scans */
+static int bitbang_flush(void)
+{
+	int retval;
+
+	if (!bitbang_batched())
+		return ERROR_OK;
+
+	/* flush even after an error, transfers may still be in flight */
+	retval = bitbang_interface->flush();
+	if (bitbang_batch_error != ERROR_OK)
+		retval = bitbang_batch_error;
+
+	for (unsigned i = 0; i < bitbang_num_pending; i++)
+	{
+		if ((retval == ERROR_OK) && (jtag_read_buffer(bitbang_pending[i].buffer,
+				bitbang_pending[i].scan) != ERROR_OK))
+			retval = ERROR_JTAG_QUEUE_FAILED;
+	}
+
+	bitbang_num_pending = 0;
+	bitbang_batch_error = ERROR_OK;
+
+	return retval;
+}
+
 int bitbang_execute_queue(void)
 {
 	struct jtag_command *cmd = jtag_command_queue; /* currently processed command */
@@ -287,6 +356,8 @@ int bitbang_execute_queue(void)
 				{
 					tap_set_state(TAP_RESET);
 				}
+				if (bitbang_flush() != ERROR_OK)
+					retval = ERROR_JTAG_QUEUE_FAILED;
 				bitbang_interface->reset(cmd->cmd.reset->trst, cmd->cmd.reset->srst);
 				break;
 			case JTAG_RUNTEST:
@@ -323,18 +394,23 @@ int bitbang_execute_queue(void)
 				LOG_DEBUG("%s scan end in %s",  (cmd->cmd.scan->ir_scan) ? "IR" : "DR", tap_state_name(cmd->cmd.scan->end_state));
 #endif
 				bitbang_end_state(cmd->cmd.scan->end_state);
-				scan_size = jtag_build_buffer(cmd->cmd.scan, &buffer);
+				scan_size = jtag_build_queue_buffer(cmd->cmd.scan, &buffer);
 				type = jtag_scan_type(cmd->cmd.scan);
 				bitbang_scan(cmd->cmd.scan->ir_scan, type, buffer, scan_size);
-				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
+				if (bitbang_batched())
+				{
+					if ((type != SCAN_OUT) && (bitbang_add_pending(cmd->cmd.scan, buffer) != ERROR_OK))
+						retval = ERROR_JTAG_QUEUE_FAILED;
+				}
+				else if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
-				if (buffer)
-					free(buffer);
 				break;
 			case JTAG_SLEEP:
 #ifdef _DEBUG_JTAG_IO_
 				LOG_DEBUG("sleep %" PRIi32, cmd->cmd.sleep->us);
 #endif
+				if (bitbang_flush() != ERROR_OK)
+					retval = ERROR_JTAG_QUEUE_FAILED;
 				jtag_sleep(cmd->cmd.sleep->us);
 				break;
 			case JTAG_TMS:
@@ -346,6 +422,10 @@ int bitbang_execute_queue(void)
 		}
 		cmd = cmd->next;
 	}
+
+	if (bitbang_flush() != ERROR_OK)
+		retval = ERROR_JTAG_QUEUE_FAILED;
+
 	if (bitbang_interface->blink)
 		bitbang_interface->blink(0);
 
@@ -30,6 +30,21 @@ struct bitbang_interface {
 	void (*write)(int tck, int tms, int tdi);
 	void (*reset)(int trst, int srst);
 	void (*blink)(int on);
+
+	/* optional batched callbacks, used instead of read() and write()
+	 * when a driver provides both
+	 */
+	/**
+	 * Queue @a num TCK cycles. TMS and TDI of cycle i are bit i of
+	 * @a tms and @a tdi, a NULL pointer stands for all zeroes; both are
+	 * consumed before the call returns. If @a tdo is not NULL, TDO of
+	 * cycle i is stored in its bit i by the next flush(). TCK is left
+	 * low after the last cycle.
+	 */
+	int (*clock_bits)(const uint8_t *tms, const uint8_t *tdi,
+			uint8_t *tdo, unsigned num);
+	/** Execute all queued cycles and store the sampled TDO bits. */
+	int (*flush)(void);
 };
 
 int bitbang_execute_queue(void);
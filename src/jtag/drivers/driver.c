@@ -35,12 +35,11 @@
 #include <jtag/interface.h>
 #include <jtag/commands.h>
 #include <jtag/minidriver.h>
+#include <jtag/stats.h>
 #include <helper/command.h>
 
 struct jtag_callback_entry
 {
-	struct jtag_callback_entry *next;
-
 	jtag_callback_t callback;
 	jtag_callback_data_t data0;
 	jtag_callback_data_t data1;
@@ -48,13 +47,17 @@ struct jtag_callback_entry
 	jtag_callback_data_t data3;
 };
 
-static struct jtag_callback_entry *jtag_callback_queue_head = NULL;
-static struct jtag_callback_entry *jtag_callback_queue_tail = NULL;
+/* Callbacks are kept in one array which grows as needed and is reused
+ * across flushes, so queueing one is a store and running them a walk
+ * over contiguous memory. */
+#define JTAG_CALLBACK_QUEUE_MIN 256
+static struct jtag_callback_entry *jtag_callback_queue = NULL;
+static unsigned jtag_callback_queue_len = 0;
+static unsigned jtag_callback_queue_max = 0;
 
 static void jtag_callback_queue_reset(void)
 {
-	jtag_callback_queue_head = NULL;
-	jtag_callback_queue_tail = NULL;
+	jtag_callback_queue_len = 0;
 }
 
 /**
@@ -455,24 +458,29 @@ int interface_jtag_add_sleep(uint32_t us)
 /* add callback to end of queue */
 void interface_jtag_add_callback4(jtag_callback_t callback, jtag_callback_data_t data0, jtag_callback_data_t data1, jtag_callback_data_t data2, jtag_callback_data_t data3)
 {
-	struct jtag_callback_entry *entry = cmd_queue_alloc(sizeof(struct jtag_callback_entry));
+	struct jtag_callback_entry *entry;
+
+	if (jtag_callback_queue_len == jtag_callback_queue_max)
+	{
+		unsigned max = jtag_callback_queue_max ? (jtag_callback_queue_max * 2) : JTAG_CALLBACK_QUEUE_MIN;
 
-	entry->next = NULL;
+		entry = realloc(jtag_callback_queue, max * sizeof(struct jtag_callback_entry));
+		if (entry == NULL)
+		{
+			LOG_ERROR("out of memory for JTAG callbacks");
+			jtag_set_error(ERROR_FAIL);
+			return;
+		}
+		jtag_callback_queue = entry;
+		jtag_callback_queue_max = max;
+	}
+
+	entry = &jtag_callback_queue[jtag_callback_queue_len++];
 	entry->callback = callback;
 	entry->data0 = data0;
 	entry->data1 = data1;
 	entry->data2 = data2;
 	entry->data3 = data3;
-
-	if (jtag_callback_queue_head == NULL)
-	{
-		jtag_callback_queue_head = entry;
-		jtag_callback_queue_tail = entry;
-	} else
-	{
-		jtag_callback_queue_tail->next = entry;
-		jtag_callback_queue_tail = entry;
-	}
 }
 
 int interface_jtag_execute_queue(void)
@@ -482,11 +490,26 @@ int interface_jtag_execute_queue(void)
 	assert(reentry==0);
 	reentry++;
 
+	jtag_command_queue_optimize();
+
+	unsigned commands = 0, scan_bits = 0;
+	for (struct jtag_command *cmd = jtag_command_queue; cmd != NULL; cmd = cmd->next)
+	{
+		commands++;
+		if (cmd->type == JTAG_SCAN)
+			scan_bits += jtag_scan_size(cmd->cmd.scan);
+	}
+	jtag_stats_queue(commands, scan_bits);
+
 	int retval = default_interface_jtag_execute_queue();
 	if (retval == ERROR_OK)
 	{
-		struct jtag_callback_entry *entry;
-		for (entry = jtag_callback_queue_head; entry != NULL; entry = entry->next)
+		jtag_command_queue_copy_captures();
+
+		const struct jtag_callback_entry *entry = jtag_callback_queue;
+		const struct jtag_callback_entry *end = entry + jtag_callback_queue_len;
+
+		for (; entry < end; entry++)
 		{
 			retval = entry->callback(entry->data0, entry->data1, entry->data2, entry->data3);
 			if (retval != ERROR_OK)
@@ -82,6 +82,7 @@
 /* project specific includes */
 #include <jtag/interface.h>
 #include <jtag/transport.h>
+#include <jtag/stats.h>
 #include <helper/time_support.h>
 
 #if IS_CYGWIN == 1
@@ -150,11 +151,13 @@ enum ftdi_interface
  * @returns ERROR_OK on success, or ERROR_JTAG_QUEUE_FAILED on failure.
  */
 static int ft2232_stableclocks(int num_cycles, struct jtag_command* cmd);
+static int ft2232_large_scan_chunk(enum scan_type type);
 
 static char *       ft2232_device_desc_A = NULL;
 static char*        ft2232_device_desc = NULL;
 static char*        ft2232_serial  = NULL;
 static uint8_t		ft2232_latency = 2;
+static bool		ft2232_latency_set;
 static unsigned		ft2232_max_tck = FTDI_2232C_MAX_TCK;
 
 #define MAX_USB_IDS 8
@@ -380,6 +383,14 @@ static int             ft2232_buffer_size  = 0;
 static int             ft2232_read_pointer = 0;
 static int             ft2232_expect_read  = 0;
 
+/* The TDO bytes of a block are only read after the next block has been
+ * written, see ft2232_send_and_recv(). They are received here. */
+static uint8_t*             ft2232_recv_buffer = NULL;
+static int             ft2232_recv_size = 0;
+static struct jtag_command* ft2232_pending_first;
+static struct jtag_command* ft2232_pending_last;
+static int             ft2232_pending_read = 0;
+
 /**
  * Function buffer_write
  * writes a byte into the byte buffer, "ft2232_buffer", which must be sent later.
@@ -394,13 +405,13 @@ static inline void buffer_write(uint8_t val)
 
 /**
  * Function buffer_read
- * returns a byte from the byte buffer.
+ * returns a byte from the receive buffer, "ft2232_recv_buffer".
  */
 static inline uint8_t buffer_read(void)
 {
-	assert(ft2232_buffer);
-	assert(ft2232_read_pointer < ft2232_buffer_size);
-	return ft2232_buffer[ft2232_read_pointer++];
+	assert(ft2232_recv_buffer);
+	assert(ft2232_read_pointer < ft2232_recv_size);
+	return ft2232_recv_buffer[ft2232_read_pointer++];
 }
 
 /**
@@ -495,7 +506,7 @@ static void move_to_state(tap_state_t goal_state)
 	clock_tms(0x4b,  tms_bits, tms_count, 0);
 }
 
-static int ft2232_write(uint8_t* buf, int size, uint32_t* bytes_written)
+static int ft2232_write_data(uint8_t* buf, int size, uint32_t* bytes_written)
 {
 #if BUILD_FT2232_FTD2XX == 1
 	FT_STATUS status;
@@ -536,7 +547,7 @@ static int ft2232_write(uint8_t* buf, int size, uint32_t* bytes_written)
 	return ERROR_OK;
 }
 
-static int ft2232_read(uint8_t* buf, uint32_t size, uint32_t* bytes_read)
+static int ft2232_read_data(uint8_t* buf, uint32_t size, uint32_t* bytes_read)
 {
 #if BUILD_FT2232_FTD2XX == 1
 	DWORD dw_bytes_read;
@@ -586,6 +597,25 @@ static int ft2232_read(uint8_t* buf, uint32_t size, uint32_t* bytes_read)
 	return ERROR_OK;
 }
 
+/* the transfers themselves, timed for jtag_stats */
+static int ft2232_write(uint8_t* buf, int size, uint32_t* bytes_written)
+{
+	int64_t start = jtag_stats_time_us();
+	int retval = ft2232_write_data(buf, size, bytes_written);
+
+	jtag_stats_driver_write(*bytes_written, jtag_stats_time_us() - start);
+	return retval;
+}
+
+static int ft2232_read(uint8_t* buf, uint32_t size, uint32_t* bytes_read)
+{
+	int64_t start = jtag_stats_time_us();
+	int retval = ft2232_read_data(buf, size, bytes_read);
+
+	jtag_stats_driver_read(*bytes_read, jtag_stats_time_us() - start);
+	return retval;
+}
+
 static bool ft2232_device_is_highspeed(void)
 {
 #if BUILD_FT2232_FTD2XX == 1
@@ -595,6 +625,27 @@ static bool ft2232_device_is_highspeed(void)
 #endif
 }
 
+static int ft2232_set_latency(uint8_t latency)
+{
+#if BUILD_FT2232_FTD2XX == 1
+	FT_STATUS status;
+
+	if ((status = FT_SetLatencyTimer(ftdih, latency)) != FT_OK)
+	{
+		LOG_ERROR("unable to set latency timer: %lu", status);
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+#elif BUILD_FT2232_LIBFTDI == 1
+	if (ftdi_set_latency_timer(&ftdic, latency) < 0)
+	{
+		LOG_ERROR("unable to set latency timer");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+#endif
+
+	return ERROR_OK;
+}
+
 /*
  * Commands that only apply to the FT2232H and FT4232H devices.
  * See chapter 6 in http://www.ftdichip.com/Documents/AppNotes/
@@ -768,15 +819,15 @@ static void ft2232_read_scan(enum scan_type type, uint8_t* buffer, int scan_size
 	buffer[cur_byte] = (buffer[cur_byte] | (((buffer_read()) << 1) & 0x80)) >> (8 - bits_left);
 }
 
-static void ft2232_debug_dump_buffer(void)
+static void ft2232_debug_dump_buffer(const uint8_t* buf, int size)
 {
 	int i;
 	char line[256];
 	char* line_p = line;
 
-	for (i = 0; i < ft2232_buffer_size; i++)
+	for (i = 0; i < size; i++)
 	{
-		line_p += snprintf(line_p, sizeof(line) - (line_p - line), "%2.2x ", ft2232_buffer[i]);
+		line_p += snprintf(line_p, sizeof(line) - (line_p - line), "%2.2x ", buf[i]);
 		if (i % 16 == 15)
 		{
 			LOG_DEBUG("%s", line);
@@ -788,93 +839,63 @@ static void ft2232_debug_dump_buffer(void)
 		LOG_DEBUG("%s", line);
 }
 
-static int ft2232_send_and_recv(struct jtag_command* first, struct jtag_command* last)
+/**
+ * Reads the TDO bytes of the block left pending by ft2232_send_and_recv()
+ * and hands them to its scan commands. Does nothing if no block is pending.
+ */
+static int ft2232_recv(void)
 {
 	struct jtag_command* cmd;
 	uint8_t* buffer;
 	int scan_size;
 	enum scan_type  type;
 	int retval;
-	uint32_t bytes_written = 0;
 	uint32_t bytes_read = 0;
 
 #ifdef _DEBUG_USB_IO_
-	struct timeval  start, inter, inter2, end;
-	struct timeval  d_inter, d_inter2, d_end;
+	struct timeval  start, end, d_end;
 #endif
 
-#ifdef _DEBUG_USB_COMMS_
-	LOG_DEBUG("write buffer (size %i):", ft2232_buffer_size);
-	ft2232_debug_dump_buffer();
-#endif
+	if (!ft2232_pending_read)
+		return ERROR_OK;
 
 #ifdef _DEBUG_USB_IO_
 	gettimeofday(&start, NULL);
 #endif
 
-	if ((retval = ft2232_write(ft2232_buffer, ft2232_buffer_size, &bytes_written)) != ERROR_OK)
+	retval = ft2232_read(ft2232_recv_buffer, ft2232_pending_read, &bytes_read);
+	if (retval != ERROR_OK)
 	{
-		LOG_ERROR("couldn't write MPSSE commands to FT2232");
+		ft2232_pending_read = 0;
+		LOG_ERROR("couldn't read from FT2232");
 		return retval;
 	}
 
 #ifdef _DEBUG_USB_IO_
-	gettimeofday(&inter, NULL);
+	gettimeofday(&end, NULL);
+	timeval_subtract(&d_end, &end, &start);
+	LOG_INFO("read: %u.%06u", (unsigned)d_end.tv_sec, (unsigned)d_end.tv_usec);
 #endif
 
-	if (ft2232_expect_read)
-	{
-		/* FIXME this "timeout" is never changed ... */
-		int timeout = LIBFTDI_READ_RETRY_COUNT;
-		ft2232_buffer_size = 0;
+	ft2232_recv_size = bytes_read;
 
-#ifdef _DEBUG_USB_IO_
-		gettimeofday(&inter2, NULL);
-#endif
-
-		if ((retval = ft2232_read(ft2232_buffer, ft2232_expect_read, &bytes_read)) != ERROR_OK)
-		{
-			LOG_ERROR("couldn't read from FT2232");
-			return retval;
-		}
-
-#ifdef _DEBUG_USB_IO_
-		gettimeofday(&end, NULL);
-
-		timeval_subtract(&d_inter, &inter, &start);
-		timeval_subtract(&d_inter2, &inter2, &start);
-		timeval_subtract(&d_end, &end, &start);
-
-		LOG_INFO("inter: %u.%06u, inter2: %u.%06u end: %u.%06u",
-			(unsigned)d_inter.tv_sec, (unsigned)d_inter.tv_usec,
-			(unsigned)d_inter2.tv_sec, (unsigned)d_inter2.tv_usec,
-			(unsigned)d_end.tv_sec, (unsigned)d_end.tv_usec);
-#endif
-
-		ft2232_buffer_size = bytes_read;
-
-		if (ft2232_expect_read != ft2232_buffer_size)
-		{
-			LOG_ERROR("ft2232_expect_read (%i) != "
-					"ft2232_buffer_size (%i) "
-					"(%i retries)",
-					ft2232_expect_read,
-					ft2232_buffer_size,
-					LIBFTDI_READ_RETRY_COUNT - timeout);
-			ft2232_debug_dump_buffer();
+	if (ft2232_pending_read != ft2232_recv_size)
+	{
+		LOG_ERROR("ft2232_pending_read (%i) != "
+				"ft2232_recv_size (%i)",
+				ft2232_pending_read,
+				ft2232_recv_size);
+		ft2232_debug_dump_buffer(ft2232_recv_buffer, ft2232_recv_size);
 
-			exit(-1);
-		}
+		exit(-1);
+	}
 
 #ifdef _DEBUG_USB_COMMS_
-		LOG_DEBUG("read buffer (%i retries): %i bytes",
-				LIBFTDI_READ_RETRY_COUNT - timeout,
-				ft2232_buffer_size);
-		ft2232_debug_dump_buffer();
+	LOG_DEBUG("read buffer: %i bytes", ft2232_recv_size);
+	ft2232_debug_dump_buffer(ft2232_recv_buffer, ft2232_recv_size);
 #endif
-	}
 
-	ft2232_expect_read  = 0;
+	ft2232_pending_read = 0;
 	ft2232_read_pointer = 0;
 
 	/* return ERROR_OK, unless a jtag_read_buffer returns a failed check
@@ -882,8 +903,8 @@ static int ft2232_send_and_recv(struct jtag_command* first, struct jtag_command*
 	 */
 	retval = ERROR_OK;
 
-	cmd = first;
-	while (cmd != last)
+	cmd = ft2232_pending_first;
+	while (cmd != ft2232_pending_last)
 	{
 		switch (cmd->type)
 		{
@@ -892,11 +913,10 @@ static int ft2232_send_and_recv(struct jtag_command* first, struct jtag_command*
 			if (type != SCAN_OUT)
 			{
 				scan_size = jtag_scan_size(cmd->cmd.scan);
-				buffer    = calloc(DIV_ROUND_UP(scan_size, 8), 1);
+				buffer    = jtag_scan_buffer(scan_size);
 				ft2232_read_scan(type, buffer, scan_size);
 				if (jtag_read_buffer(buffer, cmd->cmd.scan) != ERROR_OK)
 					retval = ERROR_JTAG_QUEUE_FAILED;
-				free(buffer);
 			}
 			break;
 
@@ -907,9 +927,60 @@ static int ft2232_send_and_recv(struct jtag_command* first, struct jtag_command*
 		cmd = cmd->next;
 	}
 
+	return retval;
+}
+
+/**
+ * Writes the commands from @a first up to @a last, then reads the TDO
+ * bytes of the previously written block. The TDO bytes of this block are
+ * left pending until the next call, or ft2232_recv(), so the MPSSE shifts
+ * one block while the host collects the other.
+ *
+ * Until the pending block is read, the TDO bytes of both blocks wait in
+ * the chip. With libftdi nothing drains the chip during a write, so if
+ * they would not fit into the channel's receive buffer (twice the
+ * ft2232_large_scan_chunk() size) the pending block is read first.
+ */
+static int ft2232_send_and_recv(struct jtag_command* first, struct jtag_command* last)
+{
+	int retval;
+	int recv_retval = ERROR_OK;
+	uint32_t bytes_written = 0;
+
+	/* Send Immediate: return the TDO bytes right away instead of
+	 * waiting for the latency timer to flush a short packet */
+	if (ft2232_expect_read)
+		buffer_write(0x87);
+
+	if (ft2232_pending_read + ft2232_expect_read > 2 * ft2232_large_scan_chunk(SCAN_IO))
+		recv_retval = ft2232_recv();
+
+#ifdef _DEBUG_USB_COMMS_
+	LOG_DEBUG("write buffer (size %i):", ft2232_buffer_size);
+	ft2232_debug_dump_buffer(ft2232_buffer, ft2232_buffer_size);
+#endif
+
+	if ((retval = ft2232_write(ft2232_buffer, ft2232_buffer_size, &bytes_written)) != ERROR_OK)
+	{
+		LOG_ERROR("couldn't write MPSSE commands to FT2232");
+		ft2232_pending_read = 0;
+		ft2232_expect_read = 0;
+		ft2232_buffer_size = 0;
+		return retval;
+	}
+
+	retval = ft2232_recv();
+	if (recv_retval == ERROR_OK)
+		recv_retval = retval;
+
+	ft2232_pending_first = first;
+	ft2232_pending_last  = last;
+	ft2232_pending_read  = ft2232_expect_read;
+
+	ft2232_expect_read = 0;
 	ft2232_buffer_size = 0;
 
-	return retval;
+	return recv_retval;
 }
 
 /**
@@ -1127,17 +1198,46 @@ static void ft2232_add_scan(bool ir_scan, enum scan_type type, uint8_t* buffer,
 	}
 }
 
+/**
+ * Returns the number of complete bytes ft2232_large_scan() clocks per
+ * MPSSE command. TDO reads are pipelined: a chunk is written before the
+ * TDO bytes of the previous one are collected, so up to two chunks of TDO
+ * data wait in the chip. libftdi does not drain the chip while a write is
+ * in progress, so with it both chunks have to fit into the transmit buffer
+ * of the channel, or the MPSSE stalls and the write times out. The FTD2XX
+ * driver keeps reading in the background.
+ */
+static int ft2232_large_scan_chunk(enum scan_type type)
+{
+	if (type == SCAN_OUT)
+		return 65536;
+
+#if BUILD_FT2232_FTD2XX == 1
+	return 65536;
+#elif BUILD_FT2232_LIBFTDI == 1
+	if (ftdi_device == TYPE_2232H)
+		return 2048;
+	if (ftdi_device == TYPE_4232H)
+		return 1024;
+	return 192;
+#endif
+}
+
 static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint8_t* buffer, int scan_size)
 {
 	int num_bytes = (scan_size + 7) / 8;
 	int bits_left = scan_size;
 	int cur_byte  = 0;
 	int last_bit;
-	uint8_t* receive_buffer  = malloc(DIV_ROUND_UP(scan_size, 8));
-	uint8_t* receive_pointer = receive_buffer;
+	int last_count;
+	int chunk = ft2232_large_scan_chunk(type);
+	uint8_t* receive_buffer  = NULL;
+	uint8_t* receive_pointer = NULL;
+	uint8_t tail[2];
 	uint32_t bytes_written;
 	uint32_t bytes_read;
 	int retval;
+	int pending_read = 0;
 	int thisrun_read = 0;
 
 	if (cmd->ir_scan)
@@ -1146,6 +1246,12 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 		exit(-1);
 	}
 
+	if (type != SCAN_OUT)
+	{
+		receive_buffer  = malloc(DIV_ROUND_UP(scan_size, 8));
+		receive_pointer = receive_buffer;
+	}
+
 	if (tap_get_state() != TAP_DRSHIFT)
 	{
 		move_to_state(TAP_DRSHIFT);
@@ -1184,8 +1290,7 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 			/* LOG_DEBUG("added TDI bytes (i %i)", num_bytes); */
 		}
 
-		thisrun_bytes = (num_bytes > 65537) ? 65536 : (num_bytes - 1);
-		thisrun_read  = thisrun_bytes;
+		thisrun_bytes = (num_bytes - 1 > chunk) ? chunk : (num_bytes - 1);
 		num_bytes    -= thisrun_bytes;
 		buffer_write((uint8_t) (thisrun_bytes - 1));
 		buffer_write((uint8_t) ((thisrun_bytes - 1) >> 8));
@@ -1193,17 +1298,16 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 		if (type != SCAN_IN)
 		{
 			/* add complete bytes */
-			while (thisrun_bytes-- > 0)
-			{
-				buffer_write(buffer[cur_byte]);
-				cur_byte++;
-				bits_left -= 8;
-			}
-		}
-		else /* (type == SCAN_IN) */
-		{
-			bits_left -= 8 * (thisrun_bytes);
+			memcpy(ft2232_buffer + ft2232_buffer_size,
+					buffer + cur_byte, thisrun_bytes);
+			ft2232_buffer_size += thisrun_bytes;
+			cur_byte += thisrun_bytes;
 		}
+		bits_left -= 8 * thisrun_bytes;
+
+		/* Send Immediate */
+		if (type != SCAN_OUT)
+			buffer_write(0x87);
 
 		if ((retval = ft2232_write(ft2232_buffer, ft2232_buffer_size, &bytes_written)) != ERROR_OK)
 		{
@@ -1215,22 +1319,22 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 			  (int)bytes_written);
 		ft2232_buffer_size = 0;
 
-		if (type != SCAN_OUT)
+		/* collect the previous chunk while the MPSSE shifts this one */
+		if (pending_read)
 		{
-			if ((retval = ft2232_read(receive_pointer, thisrun_read, &bytes_read)) != ERROR_OK)
+			if ((retval = ft2232_read(receive_pointer, pending_read, &bytes_read)) != ERROR_OK)
 			{
 				LOG_ERROR("couldn't read from FT2232");
 				exit(-1);
 			}
-			LOG_DEBUG("thisrun_read: %i, bytes_read: %i",
-				  thisrun_read,
+			LOG_DEBUG("pending_read: %i, bytes_read: %i",
+				  pending_read,
 				  (int)bytes_read);
 			receive_pointer += bytes_read;
 		}
+		pending_read = (type != SCAN_OUT) ? thisrun_bytes : 0;
 	}
 
-	thisrun_read = 0;
-
 	/* the most signifcant bit is scanned during TAP movement */
 	if (type != SCAN_IN)
 		last_bit = (buffer[cur_byte] >> (bits_left - 1)) & 0x1;
@@ -1263,7 +1367,7 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 			buffer_write(buffer[cur_byte]);
 
 		if (type != SCAN_OUT)
-			thisrun_read += 2;
+			thisrun_read += 1;
 	}
 
 	if (tap_get_end_state() == TAP_DRSHIFT)
@@ -1287,7 +1391,9 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 			/* LOG_DEBUG("added TDI bits (i %i)", bits_left - 1); */
 		}
 		buffer_write(0x0);
-		buffer_write(last_bit);
+		if (type != SCAN_IN)
+			buffer_write(last_bit);
+		last_count = 1;
 	}
 	else
 	{
@@ -1311,10 +1417,15 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 
 		DEBUG_JTAG_IO("finish, %s", (type == SCAN_OUT) ? "no read" : "read");
 		clock_tms(mpsse_cmd, tms_bits, tms_count, last_bit);
+		last_count = tms_count;
 	}
 
 	if (type != SCAN_OUT)
+	{
 		thisrun_read += 1;
+		/* Send Immediate */
+		buffer_write(0x87);
+	}
 
 	if ((retval = ft2232_write(ft2232_buffer, ft2232_buffer_size, &bytes_written)) != ERROR_OK)
 	{
@@ -1326,20 +1437,42 @@ static int ft2232_large_scan(struct scan_command* cmd, enum scan_type type, uint
 		  (int)bytes_written);
 	ft2232_buffer_size = 0;
 
-	if (type != SCAN_OUT)
+	if (type == SCAN_OUT)
+		return ERROR_OK;
+
+	if (pending_read)
 	{
-		if ((retval = ft2232_read(receive_pointer, thisrun_read, &bytes_read)) != ERROR_OK)
+		if ((retval = ft2232_read(receive_pointer, pending_read, &bytes_read)) != ERROR_OK)
 		{
 			LOG_ERROR("couldn't read from FT2232");
 			exit(-1);
 		}
-		LOG_DEBUG("thisrun_read: %i, bytes_read: %i",
-			  thisrun_read,
-			  (int)bytes_read);
 		receive_pointer += bytes_read;
 	}
 
-	return ERROR_OK;
+	if ((retval = ft2232_read(tail, thisrun_read, &bytes_read)) != ERROR_OK)
+	{
+		LOG_ERROR("couldn't read from FT2232");
+		exit(-1);
+	}
+	LOG_DEBUG("thisrun_read: %i, bytes_read: %i",
+		  thisrun_read,
+		  (int)bytes_read);
+
+	/* the last byte of the scan: the remaining bits arrive MSB aligned,
+	 * the last bit was the first one clocked by the final command */
+	*receive_pointer = 0;
+	if (bits_left > 1)
+		*receive_pointer = tail[0] >> (9 - bits_left);
+	*receive_pointer |= ((tail[thisrun_read - 1] >> (8 - last_count)) & 1)
+			<< (bits_left - 1);
+
+	retval = ERROR_OK;
+	if (jtag_read_buffer(receive_buffer, cmd) != ERROR_OK)
+		retval = ERROR_JTAG_QUEUE_FAILED;
+	free(receive_buffer);
+
+	return retval;
 }
 
 static int ft2232_predict_scan_out(int scan_size, enum scan_type type)
@@ -1930,7 +2063,7 @@ static int ft2232_execute_scan(struct jtag_command *cmd)
 
 	DEBUG_JTAG_IO("%s type:%d", cmd->cmd.scan->ir_scan ? "IRSCAN" : "DRSCAN", type);
 
-	scan_size = jtag_build_buffer(cmd->cmd.scan, &buffer);
+	scan_size = jtag_build_queue_buffer(cmd->cmd.scan, &buffer);
 
 	predicted_size = ft2232_predict_scan_out(scan_size, type);
 	if ((predicted_size + 1) > FT2232_BUFFER_SIZE)
@@ -1940,14 +2073,16 @@ static int ft2232_execute_scan(struct jtag_command *cmd)
 		if (first_unsent != cmd)
 			if (ft2232_send_and_recv(first_unsent, cmd) != ERROR_OK)
 				retval = ERROR_JTAG_QUEUE_FAILED;
+		/* ft2232_large_scan() reads the chip itself */
+		if (ft2232_recv() != ERROR_OK)
+			retval = ERROR_JTAG_QUEUE_FAILED;
 
 		/* current command */
 		ft2232_end_state(cmd->cmd.scan->end_state);
-		ft2232_large_scan(cmd->cmd.scan, type, buffer, scan_size);
+		if (ft2232_large_scan(cmd->cmd.scan, type, buffer, scan_size) != ERROR_OK)
+			retval = ERROR_JTAG_QUEUE_FAILED;
 		require_send = 0;
 		first_unsent = cmd->next;
-		if (buffer)
-			free(buffer);
 		return retval;
 	}
 	else if (ft2232_buffer_size + predicted_size + 1 > FT2232_BUFFER_SIZE)
@@ -1965,8 +2100,6 @@ static int ft2232_execute_scan(struct jtag_command *cmd)
 	ft2232_end_state(cmd->cmd.scan->end_state);
 	ft2232_add_scan(cmd->cmd.scan->ir_scan, type, buffer, scan_size);
 	require_send = 1;
-	if (buffer)
-		free(buffer);
 	DEBUG_JTAG_IO("%s scan, %i bits, end in %s",
 			(cmd->cmd.scan->ir_scan) ? "IR" : "DR", scan_size,
 			tap_state_name(tap_get_end_state()));
@@ -2015,6 +2148,8 @@ static int ft2232_execute_sleep(struct jtag_command *cmd)
 
 	if (ft2232_send_and_recv(first_unsent, cmd) != ERROR_OK)
 				retval = ERROR_JTAG_QUEUE_FAILED;
+	if (ft2232_recv() != ERROR_OK)
+		retval = ERROR_JTAG_QUEUE_FAILED;
 	first_unsent = cmd->next;
 	jtag_sleep(cmd->cmd.sleep->us);
 	DEBUG_JTAG_IO("sleep %" PRIi32 " usec while in %s",
@@ -2078,6 +2213,7 @@ static int ft2232_execute_queue(void)
 
 	ft2232_buffer_size = 0;
 	ft2232_expect_read = 0;
+	ft2232_pending_read = 0;
 
 	/* blink, if the current layout has that feature */
 	if (layout->blink)
@@ -2101,6 +2237,10 @@ static int ft2232_execute_queue(void)
 		if (ft2232_send_and_recv(first_unsent, cmd) != ERROR_OK)
 			retval = ERROR_JTAG_QUEUE_FAILED;
 
+	/* the last block written */
+	if (ft2232_recv() != ERROR_OK)
+		retval = ERROR_JTAG_QUEUE_FAILED;
+
 	return retval;
 }
 
@@ -2417,6 +2557,7 @@ static int ft2232_init(void)
 
 	ft2232_buffer_size = 0;
 	ft2232_buffer = malloc(FT2232_BUFFER_SIZE);
+	ft2232_recv_buffer = malloc(FT2232_BUFFER_SIZE);
 
 	if (layout->init() != ERROR_OK)
 		return ERROR_JTAG_INIT_FAILED;
@@ -2433,6 +2574,12 @@ static int ft2232_init(void)
 		/* make sure the legacy mode is disabled */
 		if (ft2232h_ft4232h_clk_divide_by_5(false) != ERROR_OK)
 			return ERROR_JTAG_INIT_FAILED;
+
+		/* replies are flushed with Send Immediate, the latency timer
+		 * only holds back short packets; use its minimum unless the
+		 * configuration asked for something else */
+		if (!ft2232_latency_set && ft2232_set_latency(1) != ERROR_OK)
+			return ERROR_JTAG_INIT_FAILED;
 	}
 
 	int jtag_speed_var;
@@ -3374,6 +3521,8 @@ static int ft2232_quit(void)
 
 	free(ft2232_buffer);
 	ft2232_buffer = NULL;
+	free(ft2232_recv_buffer);
+	ft2232_recv_buffer = NULL;
 
 	return ERROR_OK;
 }
@@ -3490,6 +3639,7 @@ COMMAND_HANDLER(ft2232_handle_latency_command)
 	if (CMD_ARGC == 1)
 	{
 		ft2232_latency = atoi(CMD_ARGV[0]);
+		ft2232_latency_set = true;
 	}
 	else
 	{
@@ -27,6 +27,7 @@
 
 #include <jtag/interface.h>
 #include <jtag/commands.h>
+#include <jtag/stats.h>
 #include "usb_common.h"
 
 /* See Segger's public documentation:
@@ -50,10 +51,11 @@ static unsigned int jlink_hw_jtag_version = 2;
 #define JLINK_USB_TIMEOUT		1000
 
 // See Section 1.3.2 of the Segger JLink USB protocol manual
-/* 2048 is the max value we can use here */
-//#define JLINK_TAP_BUFFER_SIZE 2048
-#define JLINK_TAP_BUFFER_SIZE 256
-//#define JLINK_TAP_BUFFER_SIZE 384
+/* 2048 is the max value we can use here; probes which can not report
+ * their free memory get the conservative default */
+#define JLINK_TAP_BUFFER_MAX			2048
+#define JLINK_TAP_BUFFER_DEFAULT		256
+static unsigned int jlink_tap_buffer_size = JLINK_TAP_BUFFER_DEFAULT;
 
 #define JLINK_IN_BUFFER_SIZE			2048
 #define JLINK_OUT_BUFFER_SIZE			2*2048 + 4
@@ -102,6 +104,7 @@ static int jlink_get_status(void);
 /* J-Link tap buffer functions */
 static void jlink_tap_init(void);
 static int jlink_tap_execute(void);
+static int jlink_tap_flush(void);
 static void jlink_tap_ensure_space(int scans, int bits);
 static void jlink_tap_append_step(int tms, int tdi);
 static void jlink_tap_append_scan(int length, uint8_t *buffer,
@@ -115,6 +118,7 @@ struct jlink {
 static struct jlink *jlink_usb_open(void);
 static void jlink_usb_close(struct jlink *jlink);
 static int jlink_usb_message(struct jlink *jlink, int out_length, int in_length);
+static int jlink_usb_reply(struct jlink *jlink, int in_length);
 static int jlink_usb_write(struct jlink *jlink, int out_length);
 static int jlink_usb_read(struct jlink *jlink, int expected_size);
 static int jlink_usb_read_emu_result(struct jlink *jlink);
@@ -172,7 +176,7 @@ static void jlink_execute_scan(struct jtag_command *cmd)
 
 	jlink_end_state(cmd->cmd.scan->end_state);
 
-	scan_size = jtag_build_buffer(cmd->cmd.scan, &buffer);
+	scan_size = jtag_build_queue_buffer(cmd->cmd.scan, &buffer);
 	DEBUG_JTAG_IO("scan input, length = %d", scan_size);
 
 #ifdef _DEBUG_USB_COMMS_
@@ -183,24 +187,32 @@ static void jlink_execute_scan(struct jtag_command *cmd)
 			type, buffer, scan_size, cmd->cmd.scan);
 }
 
-static void jlink_execute_reset(struct jtag_command *cmd)
+static int jlink_execute_reset(struct jtag_command *cmd)
 {
+	int retval, reset_retval;
+
 	DEBUG_JTAG_IO("reset trst: %i srst %i",
 			cmd->cmd.reset->trst, cmd->cmd.reset->srst);
 
-	jlink_tap_execute();
+	retval = jlink_tap_execute();
 	jlink_reset(cmd->cmd.reset->trst, cmd->cmd.reset->srst);
-	jlink_tap_execute();
+	reset_retval = jlink_tap_execute();
+
+	return (retval != ERROR_OK) ? retval : reset_retval;
 }
 
-static void jlink_execute_sleep(struct jtag_command *cmd)
+static int jlink_execute_sleep(struct jtag_command *cmd)
 {
+	int retval;
+
 	DEBUG_JTAG_IO("sleep %" PRIi32 "", cmd->cmd.sleep->us);
-	jlink_tap_execute();
+	retval = jlink_tap_execute();
 	jtag_sleep(cmd->cmd.sleep->us);
+
+	return retval;
 }
 
-static void jlink_execute_command(struct jtag_command *cmd)
+static int jlink_execute_command(struct jtag_command *cmd)
 {
 	switch (cmd->type)
 	{
@@ -208,25 +220,34 @@ static void jlink_execute_command(struct jtag_command *cmd)
 	case JTAG_TLR_RESET: jlink_execute_statemove(cmd); break;
 	case JTAG_PATHMOVE:  jlink_execute_pathmove(cmd); break;
 	case JTAG_SCAN:      jlink_execute_scan(cmd); break;
-	case JTAG_RESET:     jlink_execute_reset(cmd); break;
-	case JTAG_SLEEP:     jlink_execute_sleep(cmd); break;
+	case JTAG_RESET:     return jlink_execute_reset(cmd);
+	case JTAG_SLEEP:     return jlink_execute_sleep(cmd);
 	default:
 		LOG_ERROR("BUG: unknown JTAG command type encountered");
 		exit(-1);
 	}
+
+	return ERROR_OK;
 }
 
 static int jlink_execute_queue(void)
 {
 	struct jtag_command *cmd = jtag_command_queue;
+	int retval = ERROR_OK;
+	int tap_retval;
 
 	while (cmd != NULL)
 	{
-		jlink_execute_command(cmd);
+		/* the first failure is the one reported */
+		int cmd_retval = jlink_execute_command(cmd);
+		if (retval == ERROR_OK)
+			retval = cmd_retval;
 		cmd = cmd->next;
 	}
 
-	return jlink_tap_execute();
+	tap_retval = jlink_tap_execute();
+
+	return (retval != ERROR_OK) ? retval : tap_retval;
 }
 
 /* Sets speed in kHz. */
@@ -610,7 +631,18 @@ static int jlink_get_version_info(void)
 
 		jlink_max_size = buf_get_u32(usb_in_buffer, 0, 32);
 		LOG_INFO("JLink max mem block %i", (int)jlink_max_size);
+
+		/* the probe holds TMS, TDI and TDO of a whole transfer */
+		jlink_tap_buffer_size = jlink_max_size / 3;
+		if (jlink_tap_buffer_size > JLINK_TAP_BUFFER_MAX)
+			jlink_tap_buffer_size = JLINK_TAP_BUFFER_MAX;
+		if (jlink_tap_buffer_size < JLINK_TAP_BUFFER_DEFAULT)
+			jlink_tap_buffer_size = JLINK_TAP_BUFFER_DEFAULT;
 	}
+	else
+		jlink_tap_buffer_size = JLINK_TAP_BUFFER_DEFAULT;
+
+	LOG_DEBUG("JLink tap buffer %u bytes", jlink_tap_buffer_size);
 
 	return ERROR_OK;
 }
@@ -683,84 +715,105 @@ struct jtag_interface jlink_interface = {
 /* J-Link tap functions */
 
 
-static unsigned tap_length = 0;
-static uint8_t tms_buffer[JLINK_TAP_BUFFER_SIZE];
-static uint8_t tdi_buffer[JLINK_TAP_BUFFER_SIZE];
-static uint8_t tdo_buffer[JLINK_TAP_BUFFER_SIZE];
-
 struct pending_scan_result {
-	int first;	/* First bit position in tdo_buffer to read */
+	int first;	/* First bit position in usb_in_buffer to read */
 	int length; /* Number of bits to read */
 	struct scan_command *command; /* Corresponding scan command */
-	uint8_t *buffer;
 };
 
 #define MAX_PENDING_SCAN_RESULTS 256
 
-static int pending_scan_results_length;
-static struct pending_scan_result pending_scan_results_buffer[MAX_PENDING_SCAN_RESULTS];
+/* TMS/TDI sequences are collected in one of two buffers. A full buffer is
+ * sent to the probe, but its reply is only read once the other buffer has
+ * to go out, so the probe shifts one buffer while the queue fills the
+ * other. The protocol allows a single command in flight. */
+struct jlink_tap_buffer {
+	unsigned length;
+	uint8_t tms[JLINK_TAP_BUFFER_MAX];
+	uint8_t tdi[JLINK_TAP_BUFFER_MAX];
+	int num_pending;
+	struct pending_scan_result pending[MAX_PENDING_SCAN_RESULTS];
+	/* bytes returned by the probe for a buffer in flight */
+	int in_length;
+};
+
+static struct jlink_tap_buffer jlink_tap_buffers[2];
+static struct jlink_tap_buffer *jlink_tap = &jlink_tap_buffers[0];
+static struct jlink_tap_buffer *jlink_tap_in_flight;
+
+/* failure of a flush forced by a full buffer, reported at the end of
+ * the queue */
+static int jlink_tap_error = ERROR_OK;
 
 static void jlink_tap_init(void)
 {
-	tap_length = 0;
-	pending_scan_results_length = 0;
+	jlink_tap->length = 0;
+	jlink_tap->num_pending = 0;
 }
 
 static void jlink_tap_ensure_space(int scans, int bits)
 {
-	int available_scans = MAX_PENDING_SCAN_RESULTS - pending_scan_results_length;
-	int available_bits = JLINK_TAP_BUFFER_SIZE * 8 - tap_length - 32;
+	int available_scans = MAX_PENDING_SCAN_RESULTS - jlink_tap->num_pending;
+	/* the last byte is kept for the padding added by jlink_tap_submit() */
+	int available_bits = (jlink_tap_buffer_size - 1) * 8 - jlink_tap->length;
 
 	if (scans > available_scans || bits > available_bits)
 	{
-		jlink_tap_execute();
+		int retval = jlink_tap_flush();
+		if (retval != ERROR_OK && jlink_tap_error == ERROR_OK)
+			jlink_tap_error = retval;
 	}
 }
 
-static void jlink_tap_append_step(int tms, int tdi)
+static void jlink_tap_put_step(int tms, int tdi)
 {
-	int index_var = tap_length / 8;
-
-	if (index_var >= JLINK_TAP_BUFFER_SIZE)
-	{
-		LOG_ERROR("jlink_tap_append_step: overflow");
-		*(uint32_t *)0xFFFFFFFF = 0;
-		exit(-1);
-	}
-
-	int bit_index = tap_length % 8;
+	int index_var = jlink_tap->length / 8;
+	int bit_index = jlink_tap->length % 8;
 	uint8_t bit = 1 << bit_index;
 
 	// we do not pad TMS, so be sure to initialize all bits
 	if (0 == bit_index)
 	{
-		tms_buffer[index_var] = tdi_buffer[index_var] = 0;
+		jlink_tap->tms[index_var] = jlink_tap->tdi[index_var] = 0;
 	}
 
 	if (tms)
-		tms_buffer[index_var] |= bit;
+		jlink_tap->tms[index_var] |= bit;
 	else
-		tms_buffer[index_var] &= ~bit;
+		jlink_tap->tms[index_var] &= ~bit;
 
 	if (tdi)
-		tdi_buffer[index_var] |= bit;
+		jlink_tap->tdi[index_var] |= bit;
 	else
-		tdi_buffer[index_var] &= ~bit;
+		jlink_tap->tdi[index_var] &= ~bit;
+
+	jlink_tap->length++;
+}
+
+static void jlink_tap_append_step(int tms, int tdi)
+{
+	/* long runtest and path moves don't reserve space, send what we have
+	 * and keep the last byte for padding */
+	if (jlink_tap->length / 8 >= jlink_tap_buffer_size - 1)
+	{
+		int retval = jlink_tap_execute();
+		if (retval != ERROR_OK && jlink_tap_error == ERROR_OK)
+			jlink_tap_error = retval;
+	}
 
-	tap_length++;
+	jlink_tap_put_step(tms, tdi);
 }
 
 static void jlink_tap_append_scan(int length, uint8_t *buffer,
 		struct scan_command *command)
 {
 	struct pending_scan_result *pending_scan_result =
-		&pending_scan_results_buffer[pending_scan_results_length];
+		&jlink_tap->pending[jlink_tap->num_pending];
 	int i;
 
-	pending_scan_result->first = tap_length;
+	pending_scan_result->first = jlink_tap->length;
 	pending_scan_result->length = length;
 	pending_scan_result->command = command;
-	pending_scan_result->buffer = buffer;
 
 	for (i = 0; i < length; i++)
 	{
@@ -768,86 +821,131 @@ static void jlink_tap_append_scan(int length, uint8_t *buffer,
 		int tdi = (buffer[i / 8] & (1 << (i % 8))) != 0;
 		jlink_tap_append_step(tms, tdi);
 	}
-	pending_scan_results_length++;
+	jlink_tap->num_pending++;
 }
 
-/* Pad and send a tap sequence to the device, and receive the answer.
+/* Pad the current tap sequence and send it to the device without waiting
+ * for the answer, then switch to the other buffer.
  * For the purpose of padding we assume that we are in idle or pause state. */
-static int jlink_tap_execute(void)
+static int jlink_tap_submit(void)
 {
+	struct jlink_tap_buffer *tap = jlink_tap;
 	int byte_length;
-	int i;
+	int out_length;
 	int result;
 
-	if (!tap_length)
-		return ERROR_OK;
-
 	/* JLink returns an extra NULL in packet when size of incoming
 	 * message is a multiple of 64, creates problems with USB comms.
 	 * WARNING: This will interfere with tap state counting. */
-	while ((DIV_ROUND_UP(tap_length, 8) % 64) == 0)
+	while ((DIV_ROUND_UP(tap->length, 8) % 64) == 0)
 	{
-		jlink_tap_append_step((tap_get_state() == TAP_RESET) ? 1 : 0, 0);
+		jlink_tap_put_step((tap_get_state() == TAP_RESET) ? 1 : 0, 0);
 	}
 
 	// number of full bytes (plus one if some would be left over)
-	byte_length = DIV_ROUND_UP(tap_length, 8);
+	byte_length = DIV_ROUND_UP(tap->length, 8);
+	out_length = 4 + 2 * byte_length;
 
 	bool use_jtag3 = jlink_hw_jtag_version >= 3;
 	usb_out_buffer[0] = use_jtag3 ? EMU_CMD_HW_JTAG3 : EMU_CMD_HW_JTAG2;
 	usb_out_buffer[1] = 0;
-	usb_out_buffer[2] = (tap_length >> 0) & 0xff;
-	usb_out_buffer[3] = (tap_length >> 8) & 0xff;
-	memcpy(usb_out_buffer + 4, tms_buffer, byte_length);
-	memcpy(usb_out_buffer + 4 + byte_length, tdi_buffer, byte_length);
+	usb_out_buffer[2] = (tap->length >> 0) & 0xff;
+	usb_out_buffer[3] = (tap->length >> 8) & 0xff;
+	memcpy(usb_out_buffer + 4, tap->tms, byte_length);
+	memcpy(usb_out_buffer + 4 + byte_length, tap->tdi, byte_length);
 
-	jlink_last_state = jtag_debug_state_machine(tms_buffer, tdi_buffer,
-			tap_length, jlink_last_state);
+	jlink_last_state = jtag_debug_state_machine(tap->tms, tap->tdi,
+			tap->length, jlink_last_state);
 
-	result = jlink_usb_message(jlink_handle, 4 + 2 * byte_length, byte_length);
-	if (result != byte_length)
+	result = jlink_usb_write(jlink_handle, out_length);
+	if (result != out_length)
 	{
-		LOG_ERROR("jlink_tap_execute, wrong result %d (expected %d)",
-				result, byte_length);
+		LOG_ERROR("usb_bulk_write failed (requested=%d, result=%d)",
+				out_length, result);
 		jlink_tap_init();
 		return ERROR_JTAG_QUEUE_FAILED;
 	}
 
-	memcpy(tdo_buffer, usb_in_buffer, byte_length);
+	tap->in_length = byte_length;
+	jlink_tap_in_flight = tap;
+
+	jlink_tap = (tap == &jlink_tap_buffers[0])
+			? &jlink_tap_buffers[1] : &jlink_tap_buffers[0];
+	jlink_tap_init();
+
+	return ERROR_OK;
+}
+
+/* Receive the answer to the buffer in flight and scatter its scan results. */
+static int jlink_tap_complete(void)
+{
+	struct jlink_tap_buffer *tap = jlink_tap_in_flight;
+	int result;
+	int i;
+
+	if (!tap)
+		return ERROR_OK;
+	jlink_tap_in_flight = NULL;
+
+	result = jlink_usb_reply(jlink_handle, tap->in_length);
+	if (result != tap->in_length)
+	{
+		LOG_ERROR("jlink_tap_execute, wrong result %d (expected %d)",
+				result, tap->in_length);
+		return ERROR_JTAG_QUEUE_FAILED;
+	}
 
-	for (i = 0; i < pending_scan_results_length; i++)
+	for (i = 0; i < tap->num_pending; i++)
 	{
-		struct pending_scan_result *pending_scan_result = &pending_scan_results_buffer[i];
-		uint8_t *buffer = pending_scan_result->buffer;
+		struct pending_scan_result *pending_scan_result = &tap->pending[i];
 		int length = pending_scan_result->length;
 		int first = pending_scan_result->first;
 		struct scan_command *command = pending_scan_result->command;
 
-		/* Copy to buffer */
-		buf_set_buf(tdo_buffer, first, buffer, 0, length);
-
 		DEBUG_JTAG_IO("pending scan result, length = %d", length);
 
-#ifdef _DEBUG_USB_COMMS_
-		jlink_debug_buffer(buffer, DIV_ROUND_UP(length, 8));
-#endif
-
-		if (jtag_read_buffer(buffer, command) != ERROR_OK)
-		{
-			jlink_tap_init();
+		/* scatter straight from the received TDO bits */
+		if (jtag_read_buffer_at(usb_in_buffer, first, command) != ERROR_OK)
 			return ERROR_JTAG_QUEUE_FAILED;
-		}
-
-		if (pending_scan_result->buffer != NULL)
-		{
-			free(pending_scan_result->buffer);
-		}
 	}
 
-	jlink_tap_init();
 	return ERROR_OK;
 }
 
+/* Send the current buffer, once the probe has answered the previous one. */
+static int jlink_tap_flush(void)
+{
+	int retval;
+
+	retval = jlink_tap_complete();
+	if (retval != ERROR_OK)
+	{
+		jlink_tap_init();
+		return retval;
+	}
+
+	if (!jlink_tap->length)
+		return ERROR_OK;
+
+	return jlink_tap_submit();
+}
+
+/* Send all pending tap sequences to the device, and receive the answers. */
+static int jlink_tap_execute(void)
+{
+	int retval;
+
+	retval = jlink_tap_flush();
+	if (retval == ERROR_OK)
+		retval = jlink_tap_complete();
+
+	if (retval == ERROR_OK)
+		retval = jlink_tap_error;
+	jlink_tap_error = ERROR_OK;
+
+	return retval;
+}
+
 /*****************************************************************************/
 /* JLink USB low-level functions */
 
@@ -945,6 +1043,14 @@ static int jlink_usb_message(struct jlink *jlink, int out_length, int in_length)
 		return ERROR_JTAG_DEVICE_ERROR;
 	}
 
+	return jlink_usb_reply(jlink, in_length);
+}
+
+/* Receive the reply to a message sent before. */
+static int jlink_usb_reply(struct jlink *jlink, int in_length)
+{
+	int result;
+
 	result = jlink_usb_read(jlink, in_length);
 	if ((result != in_length) && (result != (in_length + 1)))
 	{
@@ -1046,8 +1152,10 @@ static int jlink_usb_write(struct jlink *jlink, int out_length)
 		return -1;
 	}
 
+	int64_t start = jtag_stats_time_us();
 	result = usb_bulk_write_ex(jlink->usb_handle, jlink_write_ep,
 		(char *)usb_out_buffer, out_length, JLINK_USB_TIMEOUT);
+	jtag_stats_driver_write((result > 0) ? result : 0, jtag_stats_time_us() - start);
 
 	DEBUG_JTAG_IO("jlink_usb_write, out_length = %d, result = %d",
 			out_length, result);
@@ -1061,8 +1169,10 @@ static int jlink_usb_write(struct jlink *jlink, int out_length)
 /* Read data from USB into in_buffer. */
 static int jlink_usb_read(struct jlink *jlink, int expected_size)
 {
+	int64_t start = jtag_stats_time_us();
 	int result = usb_bulk_read_ex(jlink->usb_handle, jlink_read_ep,
 		(char *)usb_in_buffer, expected_size, JLINK_USB_TIMEOUT);
+	jtag_stats_driver_read((result > 0) ? result : 0, jtag_stats_time_us() - start);
 
 	DEBUG_JTAG_IO("jlink_usb_read, result = %d", result);
 
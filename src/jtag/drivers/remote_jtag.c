@@ -0,0 +1,759 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <jtag/interface.h>
+#include <jtag/stats.h>
+#include "bitbang.h"
+
+#ifdef HAVE_NETDB_H
+#include <netdb.h>
+#endif
+#ifdef HAVE_NETINET_TCP_H
+#include <netinet/tcp.h>
+#endif
+#ifndef _WIN32
+#include <sys/un.h>
+#endif
+
+/**
+ * @file
+ * JTAG over a stream socket (TCP, or a Unix domain socket on POSIX hosts).
+ *
+ * The peer owns the pins; this driver sends it batches of TCK cycles using
+ * the batched bitbang callbacks. Each message holds many commands, and up
+ * to remote_jtag_window messages are in flight before the driver waits
+ * for the oldest reply. Replies are read while a message is written, so
+ * the peer may block writing them. A reply whose header doesn't match
+ * closes the connection. contrib/remote_jtag_sim.c is a reference peer
+ * which simulates a chain of TAPs.
+ *
+ * All integers are little endian. A message is
+ *
+ *   u32 seq, u32 length, then length bytes of commands
+ *
+ * and is answered, in order, by
+ *
+ *   u32 seq, u32 status, u32 length, then length bytes of TDO data
+ *
+ * with status 0 on success. Commands are
+ *
+ *   HELLO  u8 0x01, u32 protocol version
+ *   SHIFT  u8 0x02, u8 flags, u32 num_bits,
+ *          [TMS bytes if flags & TMS], [TDI bytes if flags & TDI]
+ *   RESET  u8 0x03, u8 trst, u8 srst
+ *
+ * A SHIFT clocks num_bits cycles, bit i of the vectors being cycle i (LSB
+ * first); an absent vector is all zeroes. With flags & TDO, the TDO bits
+ * are returned in the same layout. The reply data is the concatenation of
+ * those TDO vectors, in command order.
+ */
+
+#define REMOTE_JTAG_VERSION			1
+
+#define REMOTE_JTAG_CMD_HELLO		0x01
+#define REMOTE_JTAG_CMD_SHIFT		0x02
+#define REMOTE_JTAG_CMD_RESET		0x03
+
+#define REMOTE_JTAG_SHIFT_TMS		(1 << 0)
+#define REMOTE_JTAG_SHIFT_TDI		(1 << 1)
+#define REMOTE_JTAG_SHIFT_TDO		(1 << 2)
+
+/* The socket is non-blocking, and replies are read while a message is
+ * being written, so neither end can block writing into a full socket
+ * buffer whatever the window; see remote_jtag_send(). */
+#define REMOTE_JTAG_MSG_SIZE		16384
+#define REMOTE_JTAG_SHIFT_MAX_BITS	(4096 * 8)
+#define REMOTE_JTAG_WINDOW_MAX		64
+
+static char *remote_jtag_host;
+static uint16_t remote_jtag_port = 5555;
+static unsigned remote_jtag_window = 4;
+
+static int remote_jtag_fd = -1;
+static uint32_t remote_jtag_seq;
+
+/* first error not yet returned by remote_jtag_flush() */
+static int remote_jtag_error = ERROR_OK;
+
+/* the message being built, after room for its header */
+static uint8_t remote_jtag_out[8 + REMOTE_JTAG_MSG_SIZE];
+static unsigned remote_jtag_out_len;
+static unsigned remote_jtag_out_reply;
+static unsigned remote_jtag_out_reads;
+
+/* where the TDO vectors of SHIFT commands go, oldest first */
+struct remote_jtag_read {
+	uint8_t *tdo;
+	unsigned first;
+	unsigned num_bits;
+};
+
+static struct remote_jtag_read *remote_jtag_reads;
+static unsigned remote_jtag_num_reads;
+static unsigned remote_jtag_max_reads;
+static unsigned remote_jtag_next_read;
+
+/* messages waiting for their reply */
+struct remote_jtag_msg {
+	uint32_t seq;
+	unsigned reply_length;
+	unsigned num_reads;
+};
+
+static struct remote_jtag_msg remote_jtag_in_flight[REMOTE_JTAG_WINDOW_MAX];
+static unsigned remote_jtag_first_in_flight;
+static unsigned remote_jtag_num_in_flight;
+
+static uint8_t remote_jtag_in[REMOTE_JTAG_MSG_SIZE];
+
+static void remote_jtag_put_u32(uint8_t *buf, uint32_t value)
+{
+	buf[0] = value;
+	buf[1] = value >> 8;
+	buf[2] = value >> 16;
+	buf[3] = value >> 24;
+}
+
+static uint32_t remote_jtag_get_u32(const uint8_t *buf)
+{
+	return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void remote_jtag_set_error(int error)
+{
+	if (remote_jtag_error == ERROR_OK)
+		remote_jtag_error = error;
+}
+
+/* The byte stream can't be trusted any more: drop the connection, and with
+ * it the replies still in flight. Later transfers fail. */
+static void remote_jtag_disconnect(void)
+{
+	if (remote_jtag_fd >= 0)
+	{
+		LOG_ERROR("remote_jtag: closing the connection");
+		close_socket(remote_jtag_fd);
+		remote_jtag_fd = -1;
+	}
+
+	remote_jtag_num_in_flight = 0;
+}
+
+static bool remote_jtag_would_block(void)
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+#endif
+}
+
+#define REMOTE_JTAG_READABLE		(1 << 0)
+#define REMOTE_JTAG_WRITABLE		(1 << 1)
+
+/* Wait until the socket is readable with @a read, or writable with
+ * @a write. Returns which of them it is, or a negative value on error. */
+static int remote_jtag_wait(bool read, bool write)
+{
+	fd_set read_fds, write_fds;
+	int retval;
+
+	do {
+		FD_ZERO(&read_fds);
+		FD_ZERO(&write_fds);
+		if (read)
+			FD_SET(remote_jtag_fd, &read_fds);
+		if (write)
+			FD_SET(remote_jtag_fd, &write_fds);
+		retval = socket_select(remote_jtag_fd + 1, &read_fds, &write_fds, NULL, NULL);
+	} while (retval < 0 && errno == EINTR);
+
+	if (retval < 0)
+	{
+		LOG_ERROR("remote_jtag: select failed: %s", strerror(errno));
+		return retval;
+	}
+
+	return (FD_ISSET(remote_jtag_fd, &read_fds) ? REMOTE_JTAG_READABLE : 0)
+		| (FD_ISSET(remote_jtag_fd, &write_fds) ? REMOTE_JTAG_WRITABLE : 0);
+}
+
+static int remote_jtag_read(uint8_t *buf, unsigned size)
+{
+	int64_t start = jtag_stats_time_us();
+	unsigned done = 0;
+
+	if (remote_jtag_fd < 0)
+		return ERROR_JTAG_DEVICE_ERROR;
+
+	while (done < size)
+	{
+		int retval = read_socket(remote_jtag_fd, buf + done, size - done);
+		if (retval < 0 && errno == EINTR)
+			continue;
+		if (retval < 0 && remote_jtag_would_block())
+		{
+			if (remote_jtag_wait(true, false) < 0)
+				return ERROR_JTAG_DEVICE_ERROR;
+			continue;
+		}
+		if (retval <= 0)
+		{
+			LOG_ERROR("remote_jtag: read failed: %s",
+					(retval < 0) ? strerror(errno) : "connection closed");
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+		done += retval;
+	}
+
+	jtag_stats_driver_read(size, jtag_stats_time_us() - start);
+	return ERROR_OK;
+}
+
+/* Wait for the reply to the oldest message in flight and store its TDO
+ * vectors. A failed status leaves the stream usable; anything else
+ * disconnects. */
+static int remote_jtag_complete(void)
+{
+	struct remote_jtag_msg *msg =
+		&remote_jtag_in_flight[remote_jtag_first_in_flight];
+	uint8_t header[12];
+	uint32_t seq, status, length;
+	unsigned offset = 0;
+	unsigned i;
+	int retval;
+
+	remote_jtag_first_in_flight =
+		(remote_jtag_first_in_flight + 1) % REMOTE_JTAG_WINDOW_MAX;
+	remote_jtag_num_in_flight--;
+
+	if ((retval = remote_jtag_read(header, sizeof(header))) != ERROR_OK)
+	{
+		remote_jtag_disconnect();
+		return retval;
+	}
+
+	seq = remote_jtag_get_u32(header);
+	status = remote_jtag_get_u32(header + 4);
+	length = remote_jtag_get_u32(header + 8);
+
+	if (seq != msg->seq || length != msg->reply_length)
+	{
+		LOG_ERROR("remote_jtag: reply %u with %u bytes, expected %u with %u",
+				(unsigned)seq, (unsigned)length,
+				(unsigned)msg->seq, msg->reply_length);
+		remote_jtag_disconnect();
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	if ((retval = remote_jtag_read(remote_jtag_in, length)) != ERROR_OK)
+	{
+		remote_jtag_disconnect();
+		return retval;
+	}
+
+	if (status != 0)
+	{
+		LOG_ERROR("remote_jtag: message %u failed with status %u",
+				(unsigned)seq, (unsigned)status);
+		remote_jtag_next_read += msg->num_reads;
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	for (i = 0; i < msg->num_reads; i++)
+	{
+		struct remote_jtag_read *read =
+			&remote_jtag_reads[remote_jtag_next_read++];
+
+		buf_set_buf(remote_jtag_in + offset, 0,
+				read->tdo, read->first, read->num_bits);
+		offset += DIV_ROUND_UP(read->num_bits, 8);
+	}
+
+	return ERROR_OK;
+}
+
+/* Write a message, reading the replies that arrive meanwhile. The peer may
+ * block writing a reply until it is read, and only then read on; waiting
+ * for the write alone could leave both ends blocked. */
+static int remote_jtag_send(const uint8_t *buf, unsigned size)
+{
+	int64_t start = jtag_stats_time_us();
+	int64_t reading = 0;
+	unsigned done = 0;
+
+	while (done < size)
+	{
+		int retval;
+
+		if (remote_jtag_fd < 0)
+			return ERROR_JTAG_DEVICE_ERROR;
+
+		retval = remote_jtag_wait(remote_jtag_num_in_flight > 0, true);
+		if (retval < 0)
+		{
+			remote_jtag_disconnect();
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+
+		if (retval & REMOTE_JTAG_READABLE)
+		{
+			int64_t t = jtag_stats_time_us();
+
+			if ((retval = remote_jtag_complete()) != ERROR_OK)
+				remote_jtag_set_error(retval);
+			reading += jtag_stats_time_us() - t;
+			continue;
+		}
+
+		retval = write_socket(remote_jtag_fd, buf + done, size - done);
+		if (retval < 0 && (errno == EINTR || remote_jtag_would_block()))
+			continue;
+		if (retval <= 0)
+		{
+			LOG_ERROR("remote_jtag: write failed: %s",
+					(retval < 0) ? strerror(errno) : "connection closed");
+			remote_jtag_disconnect();
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+		done += retval;
+	}
+
+	jtag_stats_driver_write(size, jtag_stats_time_us() - start - reading);
+	return ERROR_OK;
+}
+
+/* Send the message being built; waits for the oldest reply first when the
+ * window is full. Fails only when the connection is gone, other errors are
+ * kept for remote_jtag_flush(). */
+static int remote_jtag_submit(void)
+{
+	struct remote_jtag_msg *msg;
+	int retval;
+
+	if (remote_jtag_out_len == 0)
+		return ERROR_OK;
+
+	if (remote_jtag_num_in_flight == remote_jtag_window)
+	{
+		if ((retval = remote_jtag_complete()) != ERROR_OK)
+			remote_jtag_set_error(retval);
+	}
+
+	msg = &remote_jtag_in_flight[(remote_jtag_first_in_flight
+			+ remote_jtag_num_in_flight) % REMOTE_JTAG_WINDOW_MAX];
+	msg->seq = remote_jtag_seq++;
+	msg->reply_length = remote_jtag_out_reply;
+	msg->num_reads = remote_jtag_out_reads;
+
+	remote_jtag_put_u32(remote_jtag_out, msg->seq);
+	remote_jtag_put_u32(remote_jtag_out + 4, remote_jtag_out_len);
+	retval = remote_jtag_send(remote_jtag_out, 8 + remote_jtag_out_len);
+
+	remote_jtag_out_len = 0;
+	remote_jtag_out_reply = 0;
+	remote_jtag_out_reads = 0;
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	remote_jtag_num_in_flight++;
+	return ERROR_OK;
+}
+
+/* Send everything and wait for all replies, even after an error, so none
+ * is left over for the next queue. Returns the first error since the last
+ * flush. */
+static int remote_jtag_flush(void)
+{
+	int retval = remote_jtag_submit();
+
+	while (remote_jtag_num_in_flight > 0)
+	{
+		int complete_retval = remote_jtag_complete();
+		if (retval == ERROR_OK)
+			retval = complete_retval;
+	}
+
+	if (retval == ERROR_OK)
+		retval = remote_jtag_error;
+	remote_jtag_error = ERROR_OK;
+
+	remote_jtag_num_reads = 0;
+	remote_jtag_next_read = 0;
+
+	return retval;
+}
+
+/* make room for a command of @a size bytes returning @a reply TDO bytes */
+static uint8_t *remote_jtag_add_command(unsigned size, unsigned reply)
+{
+	uint8_t *cmd;
+
+	if (remote_jtag_out_len + size > REMOTE_JTAG_MSG_SIZE
+			|| remote_jtag_out_reply + reply > REMOTE_JTAG_MSG_SIZE)
+	{
+		if (remote_jtag_submit() != ERROR_OK)
+			return NULL;
+	}
+
+	cmd = remote_jtag_out + 8 + remote_jtag_out_len;
+	remote_jtag_out_len += size;
+	remote_jtag_out_reply += reply;
+	return cmd;
+}
+
+static int remote_jtag_add_read(uint8_t *tdo, unsigned first, unsigned num_bits)
+{
+	if (remote_jtag_num_reads == remote_jtag_max_reads)
+	{
+		unsigned max = remote_jtag_max_reads ? (remote_jtag_max_reads * 2) : 64;
+		struct remote_jtag_read *reads;
+
+		reads = realloc(remote_jtag_reads, max * sizeof(*reads));
+		if (reads == NULL)
+			return ERROR_FAIL;
+		remote_jtag_reads = reads;
+		remote_jtag_max_reads = max;
+	}
+
+	remote_jtag_reads[remote_jtag_num_reads].tdo = tdo;
+	remote_jtag_reads[remote_jtag_num_reads].first = first;
+	remote_jtag_reads[remote_jtag_num_reads].num_bits = num_bits;
+	remote_jtag_num_reads++;
+	remote_jtag_out_reads++;
+
+	return ERROR_OK;
+}
+
+static int remote_jtag_clock_bits(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned num)
+{
+	unsigned done = 0;
+
+	while (done < num)
+	{
+		unsigned bits = num - done;
+		unsigned bytes;
+		uint8_t flags = 0;
+		uint8_t *cmd;
+
+		/* chunks stay byte aligned in the caller's vectors */
+		if (bits > REMOTE_JTAG_SHIFT_MAX_BITS)
+			bits = REMOTE_JTAG_SHIFT_MAX_BITS;
+		bytes = DIV_ROUND_UP(bits, 8);
+
+		if (tms)
+			flags |= REMOTE_JTAG_SHIFT_TMS;
+		if (tdi)
+			flags |= REMOTE_JTAG_SHIFT_TDI;
+		if (tdo)
+			flags |= REMOTE_JTAG_SHIFT_TDO;
+
+		cmd = remote_jtag_add_command(6 + (tms ? bytes : 0) + (tdi ? bytes : 0),
+				tdo ? bytes : 0);
+		if (cmd == NULL)
+			return ERROR_JTAG_DEVICE_ERROR;
+
+		cmd[0] = REMOTE_JTAG_CMD_SHIFT;
+		cmd[1] = flags;
+		remote_jtag_put_u32(cmd + 2, bits);
+		cmd += 6;
+		if (tms)
+		{
+			memcpy(cmd, tms + done / 8, bytes);
+			cmd += bytes;
+		}
+		if (tdi)
+			memcpy(cmd, tdi + done / 8, bytes);
+
+		if (tdo && remote_jtag_add_read(tdo, done, bits) != ERROR_OK)
+			return ERROR_FAIL;
+
+		done += bits;
+	}
+
+	return ERROR_OK;
+}
+
+/* the reset callback can't return an error, the next flush does */
+static void remote_jtag_reset(int trst, int srst)
+{
+	uint8_t *cmd = remote_jtag_add_command(3, 0);
+	int retval;
+
+	if (cmd == NULL)
+	{
+		remote_jtag_set_error(ERROR_JTAG_DEVICE_ERROR);
+		return;
+	}
+
+	cmd[0] = REMOTE_JTAG_CMD_RESET;
+	cmd[1] = trst;
+	cmd[2] = srst;
+
+	if ((retval = remote_jtag_flush()) != ERROR_OK)
+	{
+		LOG_ERROR("remote_jtag: reset (%d, %d) failed", trst, srst);
+		remote_jtag_set_error(retval);
+	}
+}
+
+static struct bitbang_interface remote_jtag_bitbang = {
+	.reset = remote_jtag_reset,
+	.clock_bits = remote_jtag_clock_bits,
+	.flush = remote_jtag_flush,
+};
+
+static int remote_jtag_connect_tcp(void)
+{
+	const char *host = remote_jtag_host ? : "localhost";
+	struct addrinfo hints, *result, *rp;
+	char port[8];
+	int retval;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port, sizeof(port), "%u", remote_jtag_port);
+
+	retval = getaddrinfo(host, port, &hints, &result);
+	if (retval != 0)
+	{
+		LOG_ERROR("remote_jtag: %s: %s", host, gai_strerror(retval));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	for (rp = result; rp != NULL; rp = rp->ai_next)
+	{
+		remote_jtag_fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+		if (remote_jtag_fd < 0)
+			continue;
+		if (connect(remote_jtag_fd, rp->ai_addr, rp->ai_addrlen) == 0)
+			break;
+		close_socket(remote_jtag_fd);
+		remote_jtag_fd = -1;
+	}
+	freeaddrinfo(result);
+
+	if (remote_jtag_fd < 0)
+	{
+		LOG_ERROR("remote_jtag: can't connect to %s:%s", host, port);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	/* small messages must not wait for more data */
+	int flag = 1;
+	setsockopt(remote_jtag_fd, IPPROTO_TCP, TCP_NODELAY,
+			(char *)&flag, sizeof(flag));
+
+	return ERROR_OK;
+}
+
+static int remote_jtag_connect_unix(void)
+{
+#ifndef _WIN32
+	struct sockaddr_un addr;
+
+	if (strlen(remote_jtag_host) >= sizeof(addr.sun_path))
+	{
+		LOG_ERROR("remote_jtag: socket path too long: %s", remote_jtag_host);
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, remote_jtag_host);
+
+	remote_jtag_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (remote_jtag_fd < 0)
+	{
+		LOG_ERROR("remote_jtag: socket: %s", strerror(errno));
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	if (connect(remote_jtag_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		LOG_ERROR("remote_jtag: can't connect to %s: %s",
+				remote_jtag_host, strerror(errno));
+		close_socket(remote_jtag_fd);
+		remote_jtag_fd = -1;
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	return ERROR_OK;
+#else
+	LOG_ERROR("remote_jtag: Unix domain sockets are not supported here");
+	return ERROR_JTAG_INIT_FAILED;
+#endif
+}
+
+static int remote_jtag_speed(int speed)
+{
+	return ERROR_OK;
+}
+
+static int remote_jtag_khz(int khz, int *jtag_speed)
+{
+	*jtag_speed = 0;
+	return ERROR_OK;
+}
+
+static int remote_jtag_speed_div(int speed, int *khz)
+{
+	*khz = 0;
+	return ERROR_OK;
+}
+
+static int remote_jtag_init(void)
+{
+	uint8_t *cmd;
+	int retval;
+
+	if (remote_jtag_host && remote_jtag_host[0] == '/')
+		retval = remote_jtag_connect_unix();
+	else
+		retval = remote_jtag_connect_tcp();
+	if (retval != ERROR_OK)
+		return retval;
+
+	socket_nonblock(remote_jtag_fd);
+
+	cmd = remote_jtag_add_command(5, 0);
+	cmd[0] = REMOTE_JTAG_CMD_HELLO;
+	remote_jtag_put_u32(cmd + 1, REMOTE_JTAG_VERSION);
+	if (remote_jtag_flush() != ERROR_OK)
+	{
+		LOG_ERROR("remote_jtag: peer does not speak protocol version %d",
+				REMOTE_JTAG_VERSION);
+		remote_jtag_disconnect();
+		return ERROR_JTAG_INIT_FAILED;
+	}
+
+	LOG_INFO("remote_jtag: connected, window %u", remote_jtag_window);
+	bitbang_interface = &remote_jtag_bitbang;
+
+	return ERROR_OK;
+}
+
+static int remote_jtag_quit(void)
+{
+	if (remote_jtag_fd >= 0)
+	{
+		close_socket(remote_jtag_fd);
+		remote_jtag_fd = -1;
+	}
+
+	free(remote_jtag_reads);
+	remote_jtag_reads = NULL;
+	remote_jtag_max_reads = 0;
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(remote_jtag_handle_host_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	free(remote_jtag_host);
+	remote_jtag_host = strdup(CMD_ARGV[0]);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(remote_jtag_handle_port_command)
+{
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(u16, CMD_ARGV[0], remote_jtag_port);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(remote_jtag_handle_window_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+	{
+		unsigned window;
+
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], window);
+		if (window < 1 || window > REMOTE_JTAG_WINDOW_MAX)
+		{
+			LOG_ERROR("window must be between 1 and %d",
+					REMOTE_JTAG_WINDOW_MAX);
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		}
+
+		/* nothing is in flight between queue executions */
+		remote_jtag_window = window;
+	}
+
+	command_print(CMD_CTX, "remote_jtag window %u", remote_jtag_window);
+
+	return ERROR_OK;
+}
+
+static const struct command_registration remote_jtag_command_handlers[] = {
+	{
+		.name = "remote_jtag_host",
+		.handler = &remote_jtag_handle_host_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the host name of the peer, or the path of "
+			"its Unix domain socket",
+		.usage = "(host|/path)",
+	},
+	{
+		.name = "remote_jtag_port",
+		.handler = &remote_jtag_handle_port_command,
+		.mode = COMMAND_CONFIG,
+		.help = "set the TCP port of the peer",
+		.usage = "port",
+	},
+	{
+		.name = "remote_jtag_window",
+		.handler = &remote_jtag_handle_window_command,
+		.mode = COMMAND_ANY,
+		.help = "set or show the number of messages in flight",
+		.usage = "[messages]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+struct jtag_interface remote_jtag_interface = {
+	.name = "remote_jtag",
+
+	.supported = DEBUG_CAP_TMS_SEQ,
+	.commands = remote_jtag_command_handlers,
+	.transports = jtag_only,
+
+	.execute_queue = &bitbang_execute_queue,
+
+	.speed = &remote_jtag_speed,
+	.khz = &remote_jtag_khz,
+	.speed_div = &remote_jtag_speed_div,
+
+	.init = &remote_jtag_init,
+	.quit = &remote_jtag_quit,
+};
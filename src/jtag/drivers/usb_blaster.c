@@ -194,11 +194,7 @@ usb_blaster_buf_read(uint8_t *buf, unsigned size, uint32_t *bytes_read)
 #endif
 }
 
-/* The following code doesn't fully utilize the possibilities of the
- * USB-Blaster. It writes one byte per JTAG pin state change at a time; it
- * doesn't even try to buffer data up to the maximum packet size of 64 bytes.
- *
- * Actually, the USB-Blaster offers a byte-shift mode to transmit up to 504 data
+/* The USB-Blaster offers a byte-shift mode to transmit up to 504 data
  * bits (bidirectional) in a single USB packet. A header byte has to be sent as
  * the first byte in a packet with the following meaning:
  *
@@ -225,8 +221,8 @@ usb_blaster_buf_read(uint8_t *buf, unsigned size, uint32_t *bytes_read)
  *   Bit 0 (0x01): TCK Output.
  *
  * For transmitting a single data bit, you need to write two bytes. Up to 64
- * bytes can be combined in a single USB packet (but this is not done in the
- * code below). It isn't possible to read a data without transmitting data.
+ * bytes can be combined in a single USB packet. It isn't possible to read a
+ * data without transmitting data.
  */
 
 #define TCK			(1 << 0)
@@ -280,6 +276,195 @@ static void usb_blaster_write(int tck, int tms, int tdi)
 	usb_blaster_write_data();
 }
 
+/* Batched clocking for bitbang.c: cycles are encoded into one output stream
+ * which usb_blaster_flush() sends in bulk, collecting the returned TDO bytes
+ * in a single read. Every run of at least eight cycles with TMS low (the body
+ * of a scan, idle clocks) is sent in byte-shift mode, eight cycles per byte.
+ * Only TMS transitions and the bits left over at the end of a run are bit
+ * banged, two bytes per cycle.
+ *
+ * The FT245 holds 384 bytes on their way back to the host; the number of
+ * TDO bytes pending at any time is kept well below that, otherwise the CPLD
+ * would stall while we are still writing.
+ */
+#define USB_BLASTER_BUF_SIZE		4096
+#define USB_BLASTER_MAX_READS		256
+#define SHMODE_MAX_BYTES			63
+
+/* where the TDO bits of one returned byte go */
+struct usb_blaster_read {
+	uint8_t *tdo;
+	unsigned first;
+	/* 1 for a bit banged cycle, 8 in byte-shift mode */
+	unsigned num_bits;
+};
+
+static uint8_t usb_blaster_out[USB_BLASTER_BUF_SIZE];
+static unsigned usb_blaster_out_len;
+static struct usb_blaster_read usb_blaster_reads[USB_BLASTER_MAX_READS];
+static unsigned usb_blaster_num_reads;
+
+static int usb_blaster_flush(void)
+{
+	uint8_t buf[USB_BLASTER_MAX_READS];
+	unsigned out_len = usb_blaster_out_len;
+	unsigned num_reads = usb_blaster_num_reads;
+	uint32_t count;
+	unsigned i;
+	int retval;
+
+	usb_blaster_out_len = 0;
+	usb_blaster_num_reads = 0;
+
+	if (out_len > 0)
+	{
+		retval = usb_blaster_buf_write(usb_blaster_out, out_len, &count);
+		if (retval != ERROR_OK)
+			return retval;
+		if (count != out_len)
+		{
+			LOG_ERROR("USB-Blaster accepted only %u of %u bytes",
+					(unsigned)count, out_len);
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+	}
+
+	if (num_reads == 0)
+		return ERROR_OK;
+
+	retval = usb_blaster_buf_read(buf, num_reads, &count);
+	if (retval != ERROR_OK)
+		return retval;
+	if (count != num_reads)
+	{
+		LOG_ERROR("USB-Blaster returned only %u of %u TDO bytes",
+				(unsigned)count, num_reads);
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	for (i = 0; i < num_reads; i++)
+	{
+		struct usb_blaster_read *read = &usb_blaster_reads[i];
+
+		if (read->num_bits == 1)
+			buf_set_u32(read->tdo, read->first, 1, buf[i] & READ_TDO);
+		else
+			buf_set_u32(read->tdo, read->first, 8, buf[i]);
+	}
+
+	return ERROR_OK;
+}
+
+/* make room for @a bytes output bytes and @a reads TDO bytes */
+static int usb_blaster_reserve(unsigned bytes, unsigned reads)
+{
+	if (usb_blaster_out_len + bytes > USB_BLASTER_BUF_SIZE
+			|| usb_blaster_num_reads + reads > USB_BLASTER_MAX_READS)
+		return usb_blaster_flush();
+	return ERROR_OK;
+}
+
+static void usb_blaster_queue_read(uint8_t *tdo, unsigned first,
+		unsigned num_bits)
+{
+	struct usb_blaster_read *read =
+		&usb_blaster_reads[usb_blaster_num_reads++];
+
+	read->tdo = tdo;
+	read->first = first;
+	read->num_bits = num_bits;
+}
+
+/* number of whole bytes, starting at cycle @a first, during which TMS
+ * stays low; at most one byte-shift packet */
+static unsigned usb_blaster_shift_bytes(const uint8_t *tms,
+		unsigned first, unsigned num)
+{
+	unsigned max = (num - first) / 8;
+	unsigned bytes;
+
+	if (max > SHMODE_MAX_BYTES)
+		max = SHMODE_MAX_BYTES;
+	if (!tms)
+		return max;
+
+	for (bytes = 0; bytes < max; bytes++)
+	{
+		if (buf_get_u32(tms, first + bytes * 8, 8) != 0)
+			break;
+	}
+	return bytes;
+}
+
+static int usb_blaster_clock_bits(const uint8_t *tms, const uint8_t *tdi,
+		uint8_t *tdo, unsigned num)
+{
+	unsigned i = 0;
+	unsigned bytes;
+	unsigned j;
+	int retval;
+
+	while (i < num)
+	{
+		bytes = usb_blaster_shift_bytes(tms, i, num);
+		if (bytes > 0)
+		{
+			retval = usb_blaster_reserve(bytes + 2, tdo ? bytes : 0);
+			if (retval != ERROR_OK)
+				return retval;
+
+			/* byte-shift mode clocks with the TMS level of the last
+			 * bit banged byte, starting from TCK low */
+			if (out_value & (TCK | TMS))
+			{
+				out_value &= ~(TCK | TMS);
+				usb_blaster_out[usb_blaster_out_len++] = out_value;
+			}
+
+			usb_blaster_out[usb_blaster_out_len++] =
+				SHMODE | (tdo ? READ : 0) | bytes;
+			for (j = 0; j < bytes; j++)
+			{
+				usb_blaster_out[usb_blaster_out_len++] =
+					tdi ? buf_get_u32(tdi, i + j * 8, 8) : 0;
+				if (tdo)
+					usb_blaster_queue_read(tdo, i + j * 8, 8);
+			}
+			i += bytes * 8;
+			continue;
+		}
+
+		retval = usb_blaster_reserve(2, tdo ? 1 : 0);
+		if (retval != ERROR_OK)
+			return retval;
+
+		out_value &= ~(TCK | TMS | TDI);
+		if (tms && buf_get_u32(tms, i, 1))
+			out_value |= TMS;
+		if (tdi && buf_get_u32(tdi, i, 1))
+			out_value |= TDI;
+
+		usb_blaster_out[usb_blaster_out_len++] =
+			out_value | (tdo ? READ : 0);
+		if (tdo)
+			usb_blaster_queue_read(tdo, i, 1);
+		out_value |= TCK;
+		usb_blaster_out[usb_blaster_out_len++] = out_value;
+		i++;
+	}
+
+	if (out_value & TCK)
+	{
+		retval = usb_blaster_reserve(1, 0);
+		if (retval != ERROR_OK)
+			return retval;
+		out_value &= ~TCK;
+		usb_blaster_out[usb_blaster_out_len++] = out_value;
+	}
+
+	return ERROR_OK;
+}
+
 static int usb_blaster_speed(int speed)
 {
 #if BUILD_USB_BLASTER_FTD2XX == 1
@@ -311,6 +496,8 @@ static struct bitbang_interface usb_blaster_bitbang = {
 	.read = usb_blaster_read_data,
 	.write = usb_blaster_write,
 	.reset = usb_blaster_reset,
+	.clock_bits = usb_blaster_clock_bits,
+	.flush = usb_blaster_flush,
 };
 
 static int usb_blaster_init(void)
@@ -94,6 +94,9 @@ extern struct jtag_interface armjtagew_interface;
 #if BUILD_BUSPIRATE == 1
 extern struct jtag_interface buspirate_interface;
 #endif
+#if BUILD_REMOTE_JTAG == 1
+extern struct jtag_interface remote_jtag_interface;
+#endif
 #endif // standard drivers
 
 /**
@@ -157,6 +160,9 @@ struct jtag_interface *jtag_interfaces[] = {
 #if BUILD_BUSPIRATE == 1
 		&buspirate_interface,
 #endif
+#if BUILD_REMOTE_JTAG == 1
+		&remote_jtag_interface,
+#endif
 #endif // standard drivers
 		NULL,
 	};
@@ -0,0 +1,222 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <jtag/jtag.h>
+#include "stats.h"
+#include "commands.h"
+#include <helper/log.h>
+#include <helper/command.h>
+#include <helper/time_support.h>
+
+static struct jtag_stats jtag_stats;
+
+/* the flush being executed */
+static struct {
+	int64_t start;
+	unsigned commands;
+	unsigned scan_bits;
+	unsigned write_bytes;
+	unsigned read_bytes;
+} jtag_stats_flush;
+
+int64_t jtag_stats_time_us(void)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+
+	return ((int64_t)now.tv_sec) * 1000000 + now.tv_usec;
+}
+
+static unsigned jtag_stats_bucket(uint64_t value)
+{
+	unsigned bucket = 0;
+
+	while (value && (bucket < JTAG_STATS_BUCKETS - 1))
+	{
+		value >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+static void jtag_stats_histogram_add(struct jtag_stats_histogram *h, uint64_t value)
+{
+	h->bucket[jtag_stats_bucket(value)]++;
+}
+
+void jtag_stats_flush_begin(void)
+{
+	memset(&jtag_stats_flush, 0, sizeof(jtag_stats_flush));
+	jtag_stats_flush.start = jtag_stats_time_us();
+}
+
+void jtag_stats_flush_end(void)
+{
+	int64_t usec = jtag_stats_time_us() - jtag_stats_flush.start;
+
+	if (usec < 0)
+		usec = 0;
+
+	jtag_stats.flushes++;
+	jtag_stats.flush_usec += usec;
+	jtag_stats.commands += jtag_stats_flush.commands;
+	jtag_stats.scan_bits += jtag_stats_flush.scan_bits;
+
+	jtag_stats_histogram_add(&jtag_stats.h_flush_usec, usec);
+	jtag_stats_histogram_add(&jtag_stats.h_commands, jtag_stats_flush.commands);
+	jtag_stats_histogram_add(&jtag_stats.h_scan_bits, jtag_stats_flush.scan_bits);
+	jtag_stats_histogram_add(&jtag_stats.h_write_bytes, jtag_stats_flush.write_bytes);
+	jtag_stats_histogram_add(&jtag_stats.h_read_bytes, jtag_stats_flush.read_bytes);
+}
+
+void jtag_stats_queue(unsigned commands, unsigned scan_bits)
+{
+	jtag_stats_flush.commands += commands;
+	jtag_stats_flush.scan_bits += scan_bits;
+}
+
+void jtag_stats_driver_write(unsigned bytes, int64_t usec)
+{
+	jtag_stats_flush.write_bytes += bytes;
+	jtag_stats.write_bytes += bytes;
+	jtag_stats.write_usec += (usec > 0) ? usec : 0;
+	jtag_stats.transfers++;
+}
+
+void jtag_stats_driver_read(unsigned bytes, int64_t usec)
+{
+	jtag_stats_flush.read_bytes += bytes;
+	jtag_stats.read_bytes += bytes;
+	jtag_stats.read_usec += (usec > 0) ? usec : 0;
+	jtag_stats.transfers++;
+}
+
+void jtag_stats_get(struct jtag_stats *stats)
+{
+	*stats = jtag_stats;
+}
+
+void jtag_stats_reset(void)
+{
+	memset(&jtag_stats, 0, sizeof(jtag_stats));
+}
+
+static int jtag_stats_write_csv(const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (f == NULL)
+	{
+		LOG_ERROR("Can't open %s", filename);
+		return ERROR_FAIL;
+	}
+
+	fprintf(f, "from,to,flush_usec,commands,scan_bits,write_bytes,read_bytes\n");
+	for (unsigned i = 0; i < JTAG_STATS_BUCKETS; i++)
+	{
+		uint64_t from = i ? ((uint64_t)1 << (i - 1)) : 0;
+
+		fprintf(f, "%" PRIu64 ",", from);
+		if (i < JTAG_STATS_BUCKETS - 1)
+			fprintf(f, "%" PRIu64 ",", i ? (((uint64_t)1 << i) - 1) : 0);
+		else
+			fprintf(f, ",");
+		fprintf(f, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+				jtag_stats.h_flush_usec.bucket[i],
+				jtag_stats.h_commands.bucket[i],
+				jtag_stats.h_scan_bits.bucket[i],
+				jtag_stats.h_write_bytes.bucket[i],
+				jtag_stats.h_read_bytes.bucket[i]);
+	}
+
+	fclose(f);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_stats_command)
+{
+	struct jtag_stats *s = &jtag_stats;
+
+	if (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "reset") == 0)
+	{
+		jtag_stats_reset();
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC == 2 && strcmp(CMD_ARGV[0], "csv") == 0)
+		return jtag_stats_write_csv(CMD_ARGV[1]);
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD_CTX, "flushes: %" PRIu64 ", %" PRIu64 " us total",
+			s->flushes, s->flush_usec);
+	command_print(CMD_CTX, "commands: %" PRIu64 ", scan bits: %" PRIu64,
+			s->commands, s->scan_bits);
+	command_print(CMD_CTX, "driver: %" PRIu64 " transfers, %" PRIu64 " bytes written in %"
+			PRIu64 " us, %" PRIu64 " bytes read in %" PRIu64 " us",
+			s->transfers, s->write_bytes, s->write_usec, s->read_bytes, s->read_usec);
+
+	if (s->flushes)
+	{
+		command_print(CMD_CTX, "per flush: %" PRIu64 " us, %" PRIu64 " commands, %"
+				PRIu64 " scan bits, %" PRIu64 " bytes written, %" PRIu64 " bytes read",
+				s->flush_usec / s->flushes, s->commands / s->flushes,
+				s->scan_bits / s->flushes, s->write_bytes / s->flushes,
+				s->read_bytes / s->flushes);
+	}
+
+	/* time outside the driver's transfers is host CPU time */
+	if (s->flush_usec)
+	{
+		uint64_t io = s->write_usec + s->read_usec;
+		if (io > s->flush_usec)
+			io = s->flush_usec;
+		command_print(CMD_CTX, "driver transfers: %u%% of flush time",
+				(unsigned)(io * 100 / s->flush_usec));
+	}
+
+	/* the command arena counts since startup, "reset" leaves it alone */
+	struct cmd_queue_stats q;
+	cmd_queue_get_stats(&q);
+	command_print(CMD_CTX, "command arena: %" PRIu64 " allocations, %" PRIu64
+			" bytes, %" PRIu64 " queue resets",
+			q.allocs, q.bytes, q.resets);
+	command_print(CMD_CTX, "arena pages: %u held, %u peak per queue, %" PRIu64
+			" allocated, %" PRIu64 " reused, %" PRIu64 " freed",
+			q.pages_held, q.peak_pages, q.pages_allocated,
+			q.pages_reused, q.pages_freed);
+
+	return ERROR_OK;
+}
+
+const struct command_registration jtag_stats_command_handlers[] = {
+	{
+		.name = "jtag_stats",
+		.handler = handle_jtag_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Show JTAG queue statistics, clear them, "
+			"or write their per flush histograms to a CSV file.",
+		.usage = "['reset'|'csv' filename]",
+	},
+	COMMAND_REGISTRATION_DONE
+};
@@ -0,0 +1,80 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+#ifndef OPENOCD_JTAG_STATS_H
+#define OPENOCD_JTAG_STATS_H
+
+#include <helper/types.h>
+#include <helper/command.h>
+
+/**
+ * @file
+ * JTAG queue instrumentation. The core records every flush of the queue,
+ * drivers add the time and bytes of their own transfers, and the
+ * @c jtag_stats command reports, resets or dumps the figures.
+ */
+
+/**
+ * Histograms are log2 scaled: bucket 0 counts zero, bucket n counts
+ * values from 2^(n-1) up to 2^n - 1, the last bucket everything above.
+ */
+#define JTAG_STATS_BUCKETS 32
+
+struct jtag_stats_histogram {
+	uint64_t bucket[JTAG_STATS_BUCKETS];
+};
+
+/// Cumulative figures since startup or the last @c jtag_stats reset.
+struct jtag_stats {
+	uint64_t flushes;
+	uint64_t commands;
+	uint64_t scan_bits;
+	uint64_t write_bytes;
+	uint64_t read_bytes;
+	/// driver transfers, each write and each read counts once
+	uint64_t transfers;
+	uint64_t write_usec;
+	uint64_t read_usec;
+	uint64_t flush_usec;
+
+	/// per flush distributions
+	struct jtag_stats_histogram h_flush_usec;
+	struct jtag_stats_histogram h_commands;
+	struct jtag_stats_histogram h_scan_bits;
+	struct jtag_stats_histogram h_write_bytes;
+	struct jtag_stats_histogram h_read_bytes;
+};
+
+/// @returns a microsecond timestamp for measuring driver transfers.
+int64_t jtag_stats_time_us(void);
+
+/// Called by the core around the execution of one queue.
+void jtag_stats_flush_begin(void);
+void jtag_stats_flush_end(void);
+
+/// Account the commands and scan bits of the queue about to be executed.
+void jtag_stats_queue(unsigned commands, unsigned scan_bits);
+
+/// Account a driver transfer of @a bytes which took @a usec.
+void jtag_stats_driver_write(unsigned bytes, int64_t usec);
+void jtag_stats_driver_read(unsigned bytes, int64_t usec);
+
+void jtag_stats_get(struct jtag_stats *stats);
+void jtag_stats_reset(void);
+
+extern const struct command_registration jtag_stats_command_handlers[];
+
+#endif /* OPENOCD_JTAG_STATS_H */
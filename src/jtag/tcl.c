@@ -35,6 +35,8 @@
 #include "minidriver.h"
 #include "interface.h"
 #include "interfaces.h"
+#include "commands.h"
+#include "stats.h"
 
 #ifdef HAVE_STRINGS_H
 #include <strings.h>
@@ -1267,6 +1269,40 @@ COMMAND_HANDLER(handle_jtag_flush_queue_sleep)
 }
 
 
+COMMAND_HANDLER(handle_jtag_queue_optimize_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+	{
+		bool enable;
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+		jtag_set_queue_optimize(enable);
+	}
+
+	command_print(CMD_CTX, "jtag queue optimization is %s",
+			jtag_get_queue_optimize() ? "on" : "off");
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_jtag_queue_optimize_stats_command)
+{
+	struct jtag_queue_optimize_stats stats;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	jtag_get_queue_optimize_stats(&stats);
+
+	command_print(CMD_CTX, "commands examined: %" PRIu64, stats.commands);
+	command_print(CMD_CTX, "redundant IR scans dropped: %" PRIu64, stats.ir_scans_dropped);
+	command_print(CMD_CTX, "runtest/clock commands merged: %" PRIu64, stats.clocks_merged);
+	command_print(CMD_CTX, "scans fused: %" PRIu64, stats.scans_fused);
+
+	return ERROR_OK;
+}
 
 static const struct command_registration jtag_command_handlers[] = {
 
@@ -1278,6 +1314,22 @@ static const struct command_registration jtag_command_handlers[] = {
 				"to test performance or change in behavior. Default 0ms.",
 		.usage = "[sleep in ms]",
 	},
+	{
+		.name = "jtag_queue_optimize",
+		.handler = handle_jtag_queue_optimize_command,
+		.mode = COMMAND_ANY,
+		.help = "Drop redundant IR scans, merge idle clocking and fuse "
+			"paused scans before the queue reaches the interface. "
+			"Default off.",
+		.usage = "['on'|'off']",
+	},
+	{
+		.name = "jtag_queue_optimize_stats",
+		.handler = handle_jtag_queue_optimize_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Show how many commands the queue optimizer removed "
+			"or merged.",
+	},
 	{
 		.name = "jtag_rclk",
 		.handler = handle_jtag_rclk_command,
@@ -1367,6 +1419,9 @@ static const struct command_registration jtag_command_handlers[] = {
 	{
 		.chain = jtag_command_handlers_to_move,
 	},
+	{
+		.chain = jtag_stats_command_handlers,
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -357,6 +357,8 @@ int openocd_main(int argc, char *argv[])
 
 	server_quit();
 
+	target_quit();
+
 	unregister_all_commands(cmd_ctx, NULL);
 
 	/* free commandline interface */
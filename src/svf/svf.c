@@ -34,6 +34,7 @@
 #include <jtag/jtag.h>
 #include "svf.h"
 #include <helper/time_support.h>
+#include <jtag/stats.h>
 
 
 // SVF command
@@ -206,7 +207,9 @@ struct svf_check_tdo_para
 static struct svf_check_tdo_para *svf_check_tdo_para = NULL;
 static int svf_check_tdo_para_index = 0;
 
-static int svf_read_command_from_file(FILE * fd);
+static int svf_read_command_from_file(void);
+static long svf_count_lines(void);
+static int svf_execute_queue(void);
 static int svf_check_tdo(void);
 static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len);
 static int svf_run_command(struct command_context *cmd_ctx, char *cmd_str);
@@ -216,8 +219,16 @@ static char * svf_read_line = NULL;
 static size_t svf_read_line_size = 0;
 static char *svf_command_buffer = NULL;
 static size_t svf_command_buffer_size = 0;
+static size_t svf_read_line_pos = 0;
 static int svf_line_number = 1;
-static int svf_getline (char **lineptr, size_t *n, FILE *stream);
+
+// the file is read in large blocks and tokenized straight from the block
+#define SVF_READ_BUFFER_SIZE	(64 * 1024)
+static char *svf_read_buffer = NULL;
+static size_t svf_read_buffer_pos = 0, svf_read_buffer_len = 0;
+
+// time spent reading and decoding the file, and executing the JTAG queue
+static int64_t svf_parse_usec = 0, svf_jtag_usec = 0;
 
 #define SVF_MAX_BUFFER_SIZE_TO_COMMIT	(4 * 1024)
 static uint8_t *svf_tdi_buffer = NULL, *svf_tdo_buffer = NULL, *svf_mask_buffer = NULL;
@@ -377,6 +388,18 @@ COMMAND_HANDLER(handle_svf_command)
 	// init
 	svf_line_number = 1;
 	svf_command_buffer_size = 0;
+	svf_parse_usec = 0;
+	svf_jtag_usec = 0;
+
+	svf_read_buffer_pos = 0;
+	svf_read_buffer_len = 0;
+	svf_read_buffer = malloc(SVF_READ_BUFFER_SIZE);
+	if (NULL == svf_read_buffer)
+	{
+		LOG_ERROR("not enough memory");
+		ret = ERROR_FAIL;
+		goto free_all;
+	}
 
 	svf_check_tdo_para_index = 0;
 	svf_check_tdo_para = malloc(sizeof(struct svf_check_tdo_para) * SVF_CHECK_TDO_PARA_SIZE);
@@ -475,15 +498,9 @@ COMMAND_HANDLER(handle_svf_command)
 
 	if (svf_progress_enabled)
 	{
-		// Count total lines in file.
-		while ( ! feof (svf_fd) )
-		 {
-		   svf_getline (&svf_command_buffer, &svf_command_buffer_size, svf_fd);
-		   svf_total_lines++;
-		 }
-		rewind(svf_fd);
+		svf_total_lines = svf_count_lines();
 	}
-	while (ERROR_OK == svf_read_command_from_file(svf_fd))
+	while (ERROR_OK == svf_read_command_from_file())
 	{
 		// Log Output
 		if (svf_quiet)
@@ -503,11 +520,11 @@ COMMAND_HANDLER(handle_svf_command)
 			if (svf_progress_enabled)
 			{
 				svf_percentage = ((svf_line_number * 20) / svf_total_lines) * 5;
-				LOG_USER_N("%3d%%  %s", svf_percentage, svf_read_line);
+				LOG_USER_N("%3d%%  %s\n", svf_percentage, svf_read_line);
 			}
 			else
 			{
-				LOG_USER_N("%s",svf_read_line);
+				LOG_USER_N("%s\n", svf_read_line);
 			}
 		}
 			// Run Command
@@ -519,7 +536,7 @@ COMMAND_HANDLER(handle_svf_command)
 		}
 		command_num++;
 	}
-	if (ERROR_OK != jtag_execute_queue())
+	if (ERROR_OK != svf_execute_queue())
 	{
 		ret = ERROR_FAIL;
 	}
@@ -538,6 +555,8 @@ COMMAND_HANDLER(handle_svf_command)
 	{
 		command_print(CMD_CTX, "\r\nTime used: %dm%ds%lldms ", time_measure_m, time_measure_s, time_measure_ms);
 	}
+	command_print(CMD_CTX, "Parse time: %lldms, JTAG time: %lldms",
+			(long long)(svf_parse_usec / 1000), (long long)(svf_jtag_usec / 1000));
 
 free_all:
 
@@ -545,6 +564,19 @@ free_all:
 	svf_fd = 0;
 
 	// free buffers
+	if (svf_read_buffer)
+	{
+		free(svf_read_buffer);
+		svf_read_buffer = NULL;
+		svf_read_buffer_pos = 0;
+		svf_read_buffer_len = 0;
+	}
+	if (svf_read_line)
+	{
+		free(svf_read_line);
+		svf_read_line = NULL;
+		svf_read_line_size = 0;
+	}
 	if (svf_command_buffer)
 	{
 		free(svf_command_buffer);
@@ -594,144 +626,187 @@ free_all:
 	return ret;
 }
 
-static int svf_getline (char **lineptr, size_t *n, FILE *stream)
+static inline int svf_getc(void)
 {
-#define MIN_CHUNK 16	//Buffer is increased by this size each time as required
-  size_t i = 0;
-
-  if (*lineptr == NULL)
-    {
-      *n = MIN_CHUNK;
-      *lineptr = (char *)malloc (*n);
-      if (!*lineptr)
-        {
-		  return -1;
-        }
-    }
-
-	(*lineptr)[0] = fgetc(stream);
-	while ((*lineptr)[i] != '\n')
+	if (svf_read_buffer_pos == svf_read_buffer_len)
 	{
-		(*lineptr)[++i] = fgetc(stream);
-		if (feof(stream))
-		{
-			(*lineptr)[0] = 0;
-			return -1;
-		}
-		if ((i + 2) > *n)
+		svf_read_buffer_pos = 0;
+		svf_read_buffer_len = fread(svf_read_buffer, 1, SVF_READ_BUFFER_SIZE, svf_fd);
+		if (0 == svf_read_buffer_len)
+			return EOF;
+	}
+
+	return (unsigned char)svf_read_buffer[svf_read_buffer_pos++];
+}
+
+static long svf_count_lines(void)
+{
+	int64_t start = jtag_stats_time_us();
+	long lines = 1;
+	size_t i;
+
+	while ((svf_read_buffer_len = fread(svf_read_buffer, 1, SVF_READ_BUFFER_SIZE, svf_fd)) > 0)
+	{
+		for (i = 0; i < svf_read_buffer_len; i++)
 		{
-			*n += MIN_CHUNK;
-			*lineptr = realloc(*lineptr, *n);
+			if ('\n' == svf_read_buffer[i])
+				lines++;
 		}
 	}
 
-	(*lineptr)[++i] = 0;
+	rewind(svf_fd);
+	svf_read_buffer_pos = 0;
+	svf_read_buffer_len = 0;
+
+	svf_parse_usec += jtag_stats_time_us() - start;
 
-	return sizeof(*lineptr);
+	return lines;
 }
 
 #define SVFP_CMD_INC_CNT			1024
-static int svf_read_command_from_file(FILE * fd)
+/* Grow a buffer to hold at least @a needed bytes.  Sizes double, so
+ * assembling a command with multi megabyte bit strings stays linear.
+ */
+static int svf_grow_buffer(char **buf, size_t *size, size_t needed)
+{
+	size_t new_size = *size ? *size : SVFP_CMD_INC_CNT;
+	char *new_buf;
+
+	if (needed <= *size)
+		return ERROR_OK;
+
+	while (new_size < needed)
+		new_size *= 2;
+
+	new_buf = realloc(*buf, new_size);
+	if (NULL == new_buf)
+	{
+		LOG_ERROR("not enough memory");
+		return ERROR_FAIL;
+	}
+	*buf = new_buf;
+	*size = new_size;
+
+	return ERROR_OK;
+}
+
+/* Read the next command, up to its ';', into svf_command_buffer.
+ *
+ * Comments are dropped, keywords are upper cased and spaces are put
+ * around parentheses so svf_parse_cmd_string() can split the command.
+ * Hex bit strings are copied verbatim with their whitespace removed;
+ * svf_copy_hexstring_to_binary() accepts either case.  They can't be
+ * decoded here: the digits are right aligned, so where a digit's bits go
+ * is only known once the whole string and the command's length have been
+ * read.  Unless quiet, the text of the current line is kept in
+ * svf_read_line for logging.
+ */
+static int svf_read_command_from_file(void)
 {
-	unsigned char ch;
-	int i = 0;
+	int64_t start = jtag_stats_time_us();
+	int ch;
 	size_t cmd_pos = 0;
-	int cmd_ok = 0, slash = 0, comment = 0;
+	int cmd_ok = 0, slash = 0, comment = 0, in_bracket = 0;
+	int retval = ERROR_OK;
 
-	if (svf_getline (&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
+	svf_read_line_pos = 0;
+	if ((ERROR_OK != svf_grow_buffer(&svf_command_buffer, &svf_command_buffer_size, 1))
+			|| (!svf_quiet && (ERROR_OK != svf_grow_buffer(&svf_read_line, &svf_read_line_size, 1))))
 	{
 		return ERROR_FAIL;
 	}
-	svf_line_number++;
-	ch = svf_read_line[0];
-	while (!cmd_ok && (ch != 0))
+
+	while (!cmd_ok && ((ch = svf_getc()) != EOF))
 	{
-		switch (ch)
+		if ('\n' == ch)
 		{
-		case '!':
-			slash = 0;
-			if (svf_getline (&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
+			svf_line_number++;
+			svf_read_line_pos = 0;
+			comment = 0;
+		}
+		else if (!svf_quiet && ('\r' != ch))
+		{
+			if ((svf_read_line_pos + 2) > svf_read_line_size)
 			{
-				return ERROR_FAIL;
+				retval = svf_grow_buffer(&svf_read_line, &svf_read_line_size, svf_read_line_pos + 2);
+				if (ERROR_OK != retval)
+					break;
 			}
-			svf_line_number++;
-			i = -1;
+			svf_read_line[svf_read_line_pos++] = ch;
+		}
+
+		if (comment)
+			continue;
+
+		/* each character stores at most two bytes, plus the NUL */
+		if ((cmd_pos + 3) > svf_command_buffer_size)
+		{
+			retval = svf_grow_buffer(&svf_command_buffer, &svf_command_buffer_size, cmd_pos + 3);
+			if (ERROR_OK != retval)
+				break;
+		}
+
+		switch (ch)
+		{
+		case '!':
+			comment = 1;
 			break;
 		case '/':
 			if (++slash == 2)
-			{
-				slash = 0;
-				if (svf_getline (&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
-				{
-					return ERROR_FAIL;
-				}
-				svf_line_number++;
-				i = -1;
-			}
-			break;
+				comment = 1;
+			continue;
 		case ';':
-			slash = 0;
-			cmd_ok = 1;
+			/* skip empty commands */
+			if (cmd_pos)
+				cmd_ok = 1;
 			break;
-		case '\n':
-			svf_line_number++;
-			if (svf_getline (&svf_read_line, &svf_read_line_size, svf_fd) <= 0)
+		case '(':
+			/* The parsing code expects a space before and
+			 * after parentheses -- "TDI (123) TDO (456)".
+			 * But such spaces are optional in the file.
+			 */
+			svf_command_buffer[cmd_pos++] = ' ';
+			svf_command_buffer[cmd_pos++] = '(';
+			in_bracket = 1;
+			break;
+		case ')':
+			svf_command_buffer[cmd_pos++] = ')';
+			svf_command_buffer[cmd_pos++] = ' ';
+			in_bracket = 0;
+			break;
+		default:
+			if (isspace(ch))
 			{
-				return ERROR_FAIL;
+				/* Long bit strings may be split across lines;
+				 * drop the whitespace inside them, and any
+				 * before the command.
+				 */
+				if (!in_bracket && cmd_pos)
+					svf_command_buffer[cmd_pos++] = ' ';
 			}
-			i = -1;
-		case '\r':
-			slash = 0;
-			comment = 0;
-			/* Don't save '\r' and '\n' if no data is parsed */
-			if (!cmd_pos)
-				break;
-		default:
-			/* The parsing code currently expects a space
-			 * before parentheses -- "TDI (123)".  Also a
-			 * space afterwards -- "TDI (123) TDO(456)".
-			 * But such spaces are optional... instead of
-			 * parser updates, cope with that by adding the
-			 * spaces as needed.
-			 *
-			 * Ensure there are 3 bytes available, for:
-			 *  - current character
-			 *  - added space.
-			 *  - terminating NUL ('\0')
-			 */
-			if ((cmd_pos + 2) >= svf_command_buffer_size)
+			else if (in_bracket)
 			{
-				svf_command_buffer = realloc(svf_command_buffer, (cmd_pos + 2));
-				if (svf_command_buffer == NULL)
-				{
-					LOG_ERROR("not enough memory");
-					return ERROR_FAIL;
-				}
+				svf_command_buffer[cmd_pos++] = ch;
+			}
+			else
+			{
+				svf_command_buffer[cmd_pos++] = toupper(ch);
 			}
-
-			/* insert a space before '(' */
-			if ('(' == ch)
-				svf_command_buffer[cmd_pos++] = ' ';
-
-			svf_command_buffer[cmd_pos++] = (char)toupper(ch);
-
-			/* insert a space after ')' */
-			if (')' == ch)
-				svf_command_buffer[cmd_pos++] = ' ';
 			break;
 		}
-		ch = svf_read_line[++i];
+		slash = 0;
 	}
 
-	if (cmd_ok)
-	{
-		svf_command_buffer[cmd_pos] = '\0';
-		return ERROR_OK;
-	}
-	else
-	{
+	svf_parse_usec += jtag_stats_time_us() - start;
+
+	if (!cmd_ok || (ERROR_OK != retval))
 		return ERROR_FAIL;
-	}
+
+	svf_command_buffer[cmd_pos] = '\0';
+	if (!svf_quiet)
+		svf_read_line[svf_read_line_pos] = '\0';
+
+	return ERROR_OK;
 }
 
 static int svf_parse_cmd_string(char *str, int len, char **argus, int *num_of_argu)
@@ -829,72 +904,68 @@ static int svf_set_padding(struct svf_xxr_para *para, int len, unsigned char tdi
 	return error;
 }
 
+static const int8_t svf_hex_value[256] =
+{
+	['0'] = 1 + 0x0, ['1'] = 1 + 0x1, ['2'] = 1 + 0x2, ['3'] = 1 + 0x3,
+	['4'] = 1 + 0x4, ['5'] = 1 + 0x5, ['6'] = 1 + 0x6, ['7'] = 1 + 0x7,
+	['8'] = 1 + 0x8, ['9'] = 1 + 0x9,
+	['A'] = 1 + 0xA, ['B'] = 1 + 0xB, ['C'] = 1 + 0xC,
+	['D'] = 1 + 0xD, ['E'] = 1 + 0xE, ['F'] = 1 + 0xF,
+	['a'] = 1 + 0xA, ['b'] = 1 + 0xB, ['c'] = 1 + 0xC,
+	['d'] = 1 + 0xD, ['e'] = 1 + 0xE, ['f'] = 1 + 0xF,
+};
+
+/* Decode a bit string as assembled by svf_read_command_from_file(),
+ * i.e. without whitespace, in either case.  The table holds the digit
+ * value plus one so that zero marks an invalid character.
+ */
 static int svf_copy_hexstring_to_binary(char *str, uint8_t **bin, int orig_bit_len, int bit_len)
 {
 	int i, str_len = strlen(str), str_hbyte_len = (bit_len + 3) >> 2;
+	int64_t start = jtag_stats_time_us();
 	uint8_t ch = 0;
+	uint8_t *out;
 
 	if (ERROR_OK != svf_adjust_array_length(bin, orig_bit_len, bit_len))
 	{
 		LOG_ERROR("fail to adjust length of array");
 		return ERROR_FAIL;
 	}
+	out = *bin;
 
 	/* fill from LSB (end of str) to MSB (beginning of str) */
 	for (i = 0; i < str_hbyte_len; i++)
 	{
 		ch = 0;
-		while (str_len > 0)
+		if (str_len > 0)
 		{
-			ch = str[--str_len];
-
-			/* Skip whitespace.  The SVF specification (rev E) is
-			 * deficient in terms of basic lexical issues like
-			 * where whitespace is allowed.  Long bitstrings may
-			 * require line ends for correctness, since there is
-			 * a hard limit on line length.
-			 */
-			if (!isspace(ch))
+			ch = svf_hex_value[(unsigned char)str[--str_len]];
+			if (!ch--)
 			{
-				if ((ch >= '0') && (ch <= '9'))
-				{
-					ch = ch - '0';
-					break;
-				}
-				else if ((ch >= 'A') && (ch <= 'F'))
-				{
-					ch = ch - 'A' + 10;
-					break;
-				}
-				else
-				{
-					LOG_ERROR("invalid hex string");
-					return ERROR_FAIL;
-				}
+				LOG_ERROR("invalid hex string");
+				return ERROR_FAIL;
 			}
-
-			ch = 0;
 		}
 
 		// write bin
 		if (i % 2)
 		{
 			// MSB
-			(*bin)[i / 2] |= ch << 4;
+			out[i / 2] |= ch << 4;
 		}
 		else
 		{
 			// LSB
-			(*bin)[i / 2] = 0;
-			(*bin)[i / 2] |= ch;
+			out[i / 2] = ch;
 		}
 	}
 
-	/* consume optional leading '0' MSBs or whitespace */
-	while (str_len > 0 && ((str[str_len - 1] == '0')
-				|| isspace((int) str[str_len - 1])))
+	/* consume optional leading '0' MSBs */
+	while (str_len > 0 && str[str_len - 1] == '0')
 		str_len--;
 
+	svf_parse_usec += jtag_stats_time_us() - start;
+
 	/* check validity: we must have consumed everything */
 	if (str_len > 0 || (ch & ~((2 << ((bit_len - 1) % 4)) - 1)) != 0)
 	{
@@ -954,9 +1025,19 @@ static int svf_add_check_para(uint8_t enabled, int buffer_offset, int bit_len)
 	return ERROR_OK;
 }
 
+static int svf_execute_queue(void)
+{
+	int64_t start = jtag_stats_time_us();
+	int retval = jtag_execute_queue();
+
+	svf_jtag_usec += jtag_stats_time_us() - start;
+
+	return retval;
+}
+
 static int svf_execute_tap(void)
 {
-	if (ERROR_OK != jtag_execute_queue())
+	if (ERROR_OK != svf_execute_queue())
 	{
 		return ERROR_FAIL;
 	}
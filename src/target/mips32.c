@@ -30,6 +30,7 @@
 #include "breakpoints.h"
 #include "algorithm.h"
 #include "register.h"
+#include <helper/time_support.h>
 
 static char* mips32_core_reg_list[] =
 {
@@ -105,19 +106,59 @@ static struct reg mips32_gdb_dummy_fp_reg =
 	.arch_info = NULL,
 };
 
+/* all core registers, in the bit order of MIPS32_PRACC_REG_BIT() */
+#define MIPS32_CORE_REGS_MASK	(MIPS32_PRACC_REG_BIT(MIPS32NUMCOREREGS) - 1)
+
+/* read the registers in mask that are not in the register cache yet,
+ * the cache is filled on demand after a debug entry */
+static int mips32_fetch_core_regs(struct target *target, uint64_t mask)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	int retval;
+	int i;
+
+	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+	{
+		if (mips32->core_cache->reg_list[i].valid)
+			mask &= ~MIPS32_PRACC_REG_BIT(i);
+	}
+
+	if (mask == 0)
+		return ERROR_OK;
+
+	/* the whole set is cheaper with the resident stub, and it is all
+	 * the non queued code can do */
+	if (!ejtag_info->queued_pracc
+			|| ((mask == MIPS32_CORE_REGS_MASK) && (ejtag_info->stub_area != NULL)))
+		retval = mips32_pracc_read_regs(ejtag_info, mips32->core_regs);
+	else
+		retval = mips32_pracc_read_regs_mask(ejtag_info, mask, mips32->core_regs);
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+	{
+		if (mask & MIPS32_PRACC_REG_BIT(i))
+			mips32->read_core_reg(target, i);
+	}
+
+	return ERROR_OK;
+}
+
 static int mips32_get_core_reg(struct reg *reg)
 {
 	int retval;
 	struct mips32_core_reg *mips32_reg = reg->arch_info;
 	struct target *target = mips32_reg->target;
-	struct mips32_common *mips32_target = target_to_mips32(target);
 
 	if (target->state != TARGET_HALTED)
 	{
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	retval = mips32_target->read_core_reg(target, mips32_reg->num);
+	retval = mips32_fetch_core_regs(target, MIPS32_PRACC_REG_BIT(mips32_reg->num));
 
 	return retval;
 }
@@ -186,6 +227,14 @@ int mips32_get_gdb_reg_list(struct target *target, struct reg **reg_list[], int
 	/* get pointers to arch-specific information */
 	struct mips32_common *mips32 = target_to_mips32(target);
 	int i;
+	int retval;
+
+	/* gdb uses the cached values as they are, get all of them now */
+	if (target->state == TARGET_HALTED)
+	{
+		if ((retval = mips32_fetch_core_regs(target, MIPS32_CORE_REGS_MASK)) != ERROR_OK)
+			return retval;
+	}
 
 	/* include floating point registers */
 	*reg_list_size = MIPS32NUMCOREREGS + MIPS32NUMFPREGS;
@@ -206,47 +255,58 @@ int mips32_get_gdb_reg_list(struct target *target, struct reg **reg_list[], int
 }
 
 int mips32_save_context(struct target *target)
+{
+	/* only the pc is needed on debug entry, everything else is
+	 * read when it is asked for, see mips32_get_core_reg() */
+	return mips32_fetch_core_regs(target, MIPS32_PRACC_REG_BIT(MIPS32_PC));
+}
+
+int mips32_restore_context(struct target *target)
 {
 	int i;
+	uint64_t mask = 0;
+	int retval;
 
 	/* get pointers to arch-specific information */
 	struct mips32_common *mips32 = target_to_mips32(target);
 	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	struct reg *reg_list = mips32->core_cache->reg_list;
 
-	/* read core registers */
-	mips32_pracc_read_regs(ejtag_info, mips32->core_regs);
+	/* the non queued code writes the whole set, which has to be known */
+	if (!ejtag_info->queued_pracc)
+	{
+		if ((retval = mips32_fetch_core_regs(target, MIPS32_CORE_REGS_MASK)) != ERROR_OK)
+			return retval;
+	}
 
 	for (i = 0; i < MIPS32NUMCOREREGS; i++)
 	{
-		if (!mips32->core_cache->reg_list[i].valid)
+		if (reg_list[i].dirty)
 		{
-			mips32->read_core_reg(target, i);
+			mips32->write_core_reg(target, i);
+			mask |= MIPS32_PRACC_REG_BIT(i);
 		}
 	}
 
-	return ERROR_OK;
-}
+	if (!ejtag_info->queued_pracc)
+		return mips32_pracc_write_regs(ejtag_info, mips32->core_regs);
 
-int mips32_restore_context(struct target *target)
-{
-	int i;
-
-	/* get pointers to arch-specific information */
-	struct mips32_common *mips32 = target_to_mips32(target);
-	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	/* nothing changed, nothing to write back */
+	if (mask == 0)
+		return ERROR_OK;
 
-	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+	/* $1 is the scratch register for $15 and the special registers,
+	 * reloading a known value is cheaper than saving it on the target */
+	if ((mask & MIPS32_PRACC_SCRATCH_REGS) && reg_list[1].valid)
 	{
-		if (mips32->core_cache->reg_list[i].dirty)
-		{
-			mips32->write_core_reg(target, i);
-		}
+		mips32->write_core_reg(target, 1);
+		mask |= MIPS32_PRACC_REG_BIT(1);
 	}
 
-	/* write core regs */
-	mips32_pracc_write_regs(ejtag_info, mips32->core_regs);
+	if ((mask == MIPS32_CORE_REGS_MASK) && (ejtag_info->stub_area != NULL))
+		return mips32_pracc_write_regs(ejtag_info, mips32->core_regs);
 
-	return ERROR_OK;
+	return mips32_pracc_write_regs_mask(ejtag_info, mask, mips32->core_regs);
 }
 
 int mips32_arch_state(struct target *target)
@@ -309,19 +369,63 @@ int mips32_init_arch_info(struct target *target, struct mips32_common *mips32, s
 {
 	target->arch_info = mips32;
 	mips32->common_magic = MIPS32_COMMON_MAGIC;
-	mips32->fast_data_area = NULL;
 
 	/* has breakpoint/watchpint unit been scanned */
 	mips32->bp_scanned = 0;
 	mips32->data_break_list = NULL;
 
 	mips32->ejtag_info.tap = tap;
+	mips32->ejtag_info.queued_pracc = false;
+	mips32->algorithm_session = 0;
 	mips32->read_core_reg = mips32_read_core_reg;
 	mips32->write_core_reg = mips32_write_core_reg;
 
 	return ERROR_OK;
 }
 
+#define MIPS32_BRKST_BUSY_MS	10
+
+/* wait for the exit sdbbp by watching BRKST in the EJTAG control register,
+ * back to back for short algorithms, then let poll() do the debug entry */
+static int mips32_wait_brkst(struct target *target, int timeout_ms)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	long long then = timeval_ms(), cur;
+	uint32_t ejtag_ctrl;
+	int retval;
+
+	for (;;)
+	{
+		ejtag_ctrl = ejtag_info->ejtag_ctrl;
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+		if ((retval = mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
+			return retval;
+
+		if (ejtag_ctrl & EJTAG_CTRL_BRKST)
+			break;
+
+		cur = timeval_ms();
+		if (cur - then > timeout_ms)
+		{
+			LOG_ERROR("timed out while waiting for algorithm to halt");
+			return ERROR_TARGET_TIMEOUT;
+		}
+
+		/* a long running algorithm, e.g. a flash erase, is polled at
+		 * leisure and keeps the gdb connection alive meanwhile */
+		if (cur - then > MIPS32_BRKST_BUSY_MS)
+			alive_sleep(1);
+		else
+			keep_alive();
+	}
+
+	if ((retval = target_poll(target)) != ERROR_OK)
+		return retval;
+
+	return (target->state == TARGET_HALTED) ? ERROR_OK : ERROR_TARGET_TIMEOUT;
+}
+
 /* run to exit point. return error if exit point was not reached. */
 static int mips32_run_and_wait(struct target *target, uint32_t entry_point,
 		int timeout_ms, uint32_t exit_point, struct mips32_common *mips32)
@@ -335,7 +439,7 @@ static int mips32_run_and_wait(struct target *target, uint32_t entry_point,
 		return retval;
 	}
 
-	retval = target_wait_state(target, TARGET_HALTED, timeout_ms);
+	retval = mips32_wait_brkst(target, timeout_ms);
 	/* If the target fails to halt due to the breakpoint, force a halt */
 	if (retval != ERROR_OK || target->state != TARGET_HALTED)
 	{
@@ -358,6 +462,45 @@ static int mips32_run_and_wait(struct target *target, uint32_t entry_point,
 	return ERROR_OK;
 }
 
+static int mips32_algorithm_save_context(struct target *target, uint32_t *context)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	int retval;
+	int i;
+
+	/* refresh core register cache */
+	if ((retval = mips32_fetch_core_regs(target, MIPS32_CORE_REGS_MASK)) != ERROR_OK)
+		return retval;
+
+	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+		context[i] = buf_get_u32(mips32->core_cache->reg_list[i].value, 0, 32);
+
+	return ERROR_OK;
+}
+
+static void mips32_algorithm_restore_context(struct target *target, uint32_t *context)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	int i;
+
+	/* restore everything we saved before; registers not read back since
+	 * the algorithm ran are simply rewritten, that is cheaper than reading */
+	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+	{
+		uint32_t regvalue;
+		regvalue = buf_get_u32(mips32->core_cache->reg_list[i].value, 0, 32);
+		if (!mips32->core_cache->reg_list[i].valid || (regvalue != context[i]))
+		{
+			LOG_DEBUG("restoring register %s with value 0x%8.8" PRIx32,
+				mips32->core_cache->reg_list[i].name, context[i]);
+			buf_set_u32(mips32->core_cache->reg_list[i].value,
+					0, 32, context[i]);
+			mips32->core_cache->reg_list[i].valid = 1;
+			mips32->core_cache->reg_list[i].dirty = 1;
+		}
+	}
+}
+
 int mips32_run_algorithm(struct target *target, int num_mem_params,
 		struct mem_param *mem_params, int num_reg_params,
 		struct reg_param *reg_params, uint32_t entry_point,
@@ -388,12 +531,11 @@ int mips32_run_algorithm(struct target *target, int num_mem_params,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
-	/* refresh core register cache */
-	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+	/* inside a session the context was saved when it began */
+	if (!mips32->algorithm_session)
 	{
-		if (!mips32->core_cache->reg_list[i].valid)
-			mips32->read_core_reg(target, i);
-		context[i] = buf_get_u32(mips32->core_cache->reg_list[i].value, 0, 32);
+		if ((retval = mips32_algorithm_save_context(target, context)) != ERROR_OK)
+			return retval;
 	}
 
 	for (i = 0; i < num_mem_params; i++)
@@ -422,6 +564,11 @@ int mips32_run_algorithm(struct target *target, int num_mem_params,
 			return ERROR_INVALID_ARGUMENTS;
 		}
 
+		/* leave registers alone that already hold the argument */
+		if (reg->valid && !reg->dirty
+				&& (buf_get_u32(reg->value, 0, 32) == buf_get_u32(reg_params[i].value, 0, 32)))
+			continue;
+
 		mips32_set_core_reg(reg, reg_params[i].value);
 	}
 
@@ -462,31 +609,111 @@ int mips32_run_algorithm(struct target *target, int num_mem_params,
 				return ERROR_INVALID_ARGUMENTS;
 			}
 
+			if (!reg->valid)
+			{
+				if ((retval = reg->type->get(reg)) != ERROR_OK)
+					return retval;
+			}
+
 			buf_set_u32(reg_params[i].value, 0, 32, buf_get_u32(reg->value, 0, 32));
 		}
 	}
 
-	/* restore everything we saved before */
-	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+	/* the session restores the context when it ends */
+	if (mips32->algorithm_session)
+		return ERROR_OK;
+
+	mips32_algorithm_restore_context(target, context);
+
+	mips32->isa_mode = isa_mode;
+
+	return ERROR_OK;
+}
+
+/* Start running a series of algorithms, e.g. a flash loader called once
+ * per buffer. Until mips32_algorithm_session_end() the core context is
+ * neither saved nor restored by mips32_run_algorithm(), so only the
+ * changed argument registers and the pc are written per run. */
+int mips32_algorithm_session_begin(struct target *target)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	int retval;
+
+	if (mips32->common_magic != MIPS32_COMMON_MAGIC)
 	{
-		uint32_t regvalue;
-		regvalue = buf_get_u32(mips32->core_cache->reg_list[i].value, 0, 32);
-		if (regvalue != context[i])
-		{
-			LOG_DEBUG("restoring register %s with value 0x%8.8" PRIx32,
-				mips32->core_cache->reg_list[i].name, context[i]);
-			buf_set_u32(mips32->core_cache->reg_list[i].value,
-					0, 32, context[i]);
-			mips32->core_cache->reg_list[i].valid = 1;
-			mips32->core_cache->reg_list[i].dirty = 1;
-		}
+		LOG_ERROR("current target isn't a MIPS32 target");
+		return ERROR_TARGET_INVALID;
 	}
 
-	mips32->isa_mode = isa_mode;
+	if (target->state != TARGET_HALTED)
+	{
+		LOG_WARNING("target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if (mips32->algorithm_session)
+	{
+		LOG_ERROR("BUG: algorithm session already active");
+		return ERROR_FAIL;
+	}
+
+	if ((retval = mips32_algorithm_save_context(target,
+			mips32->algorithm_context)) != ERROR_OK)
+		return retval;
+
+	mips32->algorithm_isa_mode = mips32->isa_mode;
+	mips32->algorithm_session = 1;
 
 	return ERROR_OK;
 }
 
+int mips32_algorithm_session_end(struct target *target)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+
+	if (!mips32->algorithm_session)
+		return ERROR_OK;
+
+	mips32->algorithm_session = 0;
+
+	/* a failed algorithm may have left the core running */
+	if (target->state != TARGET_HALTED)
+	{
+		LOG_WARNING("target not halted, context not restored");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	mips32_algorithm_restore_context(target, mips32->algorithm_context);
+	mips32->isa_mode = mips32->algorithm_isa_mode;
+
+	return ERROR_OK;
+}
+
+/* Run a debug mode loader at entry and stream count words to it, see
+ * mips32_pracc_fastdata_stream(). The loader keeps working after the
+ * last word, e.g. on a flash row, until the next call waits for it. */
+int mips32_stream_algorithm(struct target *target, uint32_t entry,
+		int num_args, const uint32_t *args, int count, uint32_t *buf,
+		uint32_t *status, int timeout_ms)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+
+	if (mips32->common_magic != MIPS32_COMMON_MAGIC)
+	{
+		LOG_ERROR("current target isn't a MIPS32 target");
+		return ERROR_TARGET_INVALID;
+	}
+
+	if (target->state != TARGET_HALTED)
+	{
+		LOG_WARNING("target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	return mips32_pracc_fastdata_stream(&mips32->ejtag_info, entry,
+			num_args, args, count, buf, status, timeout_ms);
+}
+
 int mips32_examine(struct target *target)
 {
 	struct mips32_common *mips32 = target_to_mips32(target);
@@ -605,121 +832,266 @@ int mips32_enable_interrupts(struct target *target, int enable)
 	return ERROR_OK;
 }
 
+/* from this size on the crc table download is paid back by the table loop */
+#define MIPS32_CRC_TABLE_MIN_SIZE	4096
+
+/* see contrib/loaders/checksum/mips32.s for src */
+static const uint32_t mips_crc_code[] =
+{
+	0x248C0000,		/* addiu 	$t4, $a0, 0 */
+	0x24AA0000,		/* addiu	$t2, $a1, 0 */
+	0x2404FFFF,		/* addiu	$a0, $zero, 0xffffffff */
+	0x10000010,		/* beq		$zero, $zero, ncomp */
+	0x240B0000,		/* addiu	$t3, $zero, 0 */
+					/* nbyte: */
+	0x81850000,		/* lb		$a1, ($t4) */
+	0x218C0001,		/* addi		$t4, $t4, 1 */
+	0x00052E00,		/* sll		$a1, $a1, 24 */
+	0x3C0204C1,		/* lui		$v0, 0x04c1 */
+	0x00852026,		/* xor		$a0, $a0, $a1 */
+	0x34471DB7,		/* ori		$a3, $v0, 0x1db7 */
+	0x00003021,		/* addu		$a2, $zero, $zero */
+					/* loop: */
+	0x00044040,		/* sll		$t0, $a0, 1 */
+	0x24C60001,		/* addiu	$a2, $a2, 1 */
+	0x28840000,		/* slti		$a0, $a0, 0 */
+	0x01074826,		/* xor		$t1, $t0, $a3 */
+	0x0124400B,		/* movn		$t0, $t1, $a0 */
+	0x28C30008,		/* slti		$v1, $a2, 8 */
+	0x1460FFF9,		/* bne		$v1, $zero, loop */
+	0x01002021,		/* addu		$a0, $t0, $zero */
+					/* ncomp: */
+	0x154BFFF0,		/* bne		$t2, $t3, nbyte */
+	0x256B0001,		/* addiu	$t3, $t3, 1 */
+	0x7000003F		/* sdbbp */
+};
+
+/* see contrib/loaders/checksum/mips32_table.s for src */
+static const uint32_t mips_crc_table_code[] =
+{
+	0x2402ffff,		/* main: addiu $v0, $zero, -1 */
+	0x10a0003b,		/* bytes: beq $a1, $zero, done */
+	0x30880003,		/* andi $t0, $a0, 3 */
+	0x15000003,		/* bne $t0, $zero, byte */
+	0x2ca80004,		/* sltiu $t0, $a1, 4 */
+	0x1100000c,		/* beq $t0, $zero, word */
+	0x00000000,		/* nop */
+	0x90880000,		/* byte: lbu $t0, 0($a0) */
+	0x24840001,		/* addiu $a0, $a0, 1 */
+	0x24a5ffff,		/* addiu $a1, $a1, -1 */
+	0x00024e02,		/* srl $t1, $v0, 24 */
+	0x01284826,		/* xor $t1, $t1, $t0 */
+	0x00094880,		/* sll $t1, $t1, 2 */
+	0x01264821,		/* addu $t1, $t1, $a2 */
+	0x8d290000,		/* lw $t1, 0($t1) */
+	0x00021200,		/* sll $v0, $v0, 8 */
+	0x1000fff0,		/* b bytes */
+	0x00491026,		/* xor $v0, $v0, $t1 */
+	0x8c880000,		/* word: lw $t0, 0($a0) */
+	0x10e0000a,		/* beq $a3, $zero, msb */
+	0x24840004,		/* addiu $a0, $a0, 4 */
+	0x00085e02,		/* srl $t3, $t0, 24 */
+	0x00084a02,		/* srl $t1, $t0, 8 */
+	0x3129ff00,		/* andi $t1, $t1, 0xff00 */
+	0x01695825,		/* or $t3, $t3, $t1 */
+	0x3109ff00,		/* andi $t1, $t0, 0xff00 */
+	0x00094a00,		/* sll $t1, $t1, 8 */
+	0x01695825,		/* or $t3, $t3, $t1 */
+	0x00084e00,		/* sll $t1, $t0, 24 */
+	0x01694025,		/* or $t0, $t3, $t1 */
+	0x00481026,		/* msb: xor $v0, $v0, $t0 */
+	0x00024e02,		/* srl $t1, $v0, 24 */
+	0x00094880,		/* sll $t1, $t1, 2 */
+	0x01264821,		/* addu $t1, $t1, $a2 */
+	0x8d290000,		/* lw $t1, 0($t1) */
+	0x00021200,		/* sll $v0, $v0, 8 */
+	0x00491026,		/* xor $v0, $v0, $t1 */
+	0x00024e02,		/* srl $t1, $v0, 24 */
+	0x00094880,		/* sll $t1, $t1, 2 */
+	0x01264821,		/* addu $t1, $t1, $a2 */
+	0x8d290000,		/* lw $t1, 0($t1) */
+	0x00021200,		/* sll $v0, $v0, 8 */
+	0x00491026,		/* xor $v0, $v0, $t1 */
+	0x00024e02,		/* srl $t1, $v0, 24 */
+	0x00094880,		/* sll $t1, $t1, 2 */
+	0x01264821,		/* addu $t1, $t1, $a2 */
+	0x8d290000,		/* lw $t1, 0($t1) */
+	0x00021200,		/* sll $v0, $v0, 8 */
+	0x00491026,		/* xor $v0, $v0, $t1 */
+	0x00024e02,		/* srl $t1, $v0, 24 */
+	0x00094880,		/* sll $t1, $t1, 2 */
+	0x01264821,		/* addu $t1, $t1, $a2 */
+	0x8d290000,		/* lw $t1, 0($t1) */
+	0x00021200,		/* sll $v0, $v0, 8 */
+	0x00491026,		/* xor $v0, $v0, $t1 */
+	0x24a5fffc,		/* addiu $a1, $a1, -4 */
+	0x2ca80004,		/* sltiu $t0, $a1, 4 */
+	0x1100ffd8,		/* beq $t0, $zero, word */
+	0x00000000,		/* nop */
+	0x1000ffc5,		/* b bytes */
+	0x00000000,		/* nop */
+	0x7000003f		/* done: sdbbp */
+};
+
+/* see contrib/loaders/erase_check/mips32.s for src */
+static const uint32_t mips_erase_check_code[] =
+{
+	0x2402ffff,		/* main: addiu $v0, $zero, -1 */
+	0x10a00017,		/* bytes: beq $a1, $zero, done */
+	0x30880003,		/* andi $t0, $a0, 3 */
+	0x15000003,		/* bne $t0, $zero, byte */
+	0x2ca80004,		/* sltiu $t0, $a1, 4 */
+	0x11000008,		/* beq $t0, $zero, word */
+	0x00000000,		/* nop */
+	0x90880000,		/* byte: lbu $t0, 0($a0) */
+	0x24840001,		/* addiu $a0, $a0, 1 */
+	0x24a5ffff,		/* addiu $a1, $a1, -1 */
+	0x2409ff00,		/* addiu $t1, $zero, -256 */
+	0x01094025,		/* or $t0, $t0, $t1 */
+	0x1000fff4,		/* b bytes */
+	0x00481024,		/* and $v0, $v0, $t0 */
+	0x8c880000,		/* word: lw $t0, 0($a0) */
+	0x24840004,		/* addiu $a0, $a0, 4 */
+	0x24a5fffc,		/* addiu $a1, $a1, -4 */
+	0x00481024,		/* and $v0, $v0, $t0 */
+	0x24490001,		/* addiu $t1, $v0, 1 */
+	0x15200005,		/* bne $t1, $zero, done */
+	0x2ca80004,		/* sltiu $t0, $a1, 4 */
+	0x1100fff8,		/* beq $t0, $zero, word */
+	0x00000000,		/* nop */
+	0x1000ffe9,		/* b bytes */
+	0x00000000,		/* nop */
+	0x7000003f		/* done: sdbbp */
+};
+
+/* Allocate a working area for code followed by data and download both,
+ * converted to target endianness, with a single buffer write. */
+static int mips32_load_algorithm(struct target *target,
+		const uint32_t *code, int code_words,
+		const uint32_t *data, int data_words, struct working_area **area)
+{
+	int size = (code_words + data_words) * sizeof(uint32_t);
+	uint8_t *buffer;
+	int i, retval;
+
+	if (target_alloc_working_area(target, size, area) != ERROR_OK)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	buffer = malloc(size);
+	if (buffer == NULL)
+	{
+		target_free_working_area(target, *area);
+		return ERROR_FAIL;
+	}
+
+	for (i = 0; i < code_words; i++)
+		target_buffer_set_u32(target, buffer + i * 4, code[i]);
+	for (i = 0; i < data_words; i++)
+		target_buffer_set_u32(target, buffer + (code_words + i) * 4, data[i]);
+
+	retval = target_write_buffer(target, (*area)->address, size, buffer);
+	free(buffer);
+
+	if (retval != ERROR_OK)
+		target_free_working_area(target, *area);
+
+	return retval;
+}
+
 int mips32_checksum_memory(struct target *target, uint32_t address,
 		uint32_t count, uint32_t* checksum)
 {
 	struct working_area *crc_algorithm;
-	struct reg_param reg_params[2];
+	struct reg_param reg_params[5];
 	struct mips32_algorithm mips32_info;
+	uint32_t crc_table[256];
+	uint32_t code_size;
+	int num_reg_params;
 	int retval;
-	uint32_t i;
-
-	/* see contib/loaders/checksum/mips32.s for src */
-
-	static const uint32_t mips_crc_code[] =
-	{
-		0x248C0000,		/* addiu 	$t4, $a0, 0 */
-		0x24AA0000,		/* addiu	$t2, $a1, 0 */
-		0x2404FFFF,		/* addiu	$a0, $zero, 0xffffffff */
-		0x10000010,		/* beq		$zero, $zero, ncomp */
-		0x240B0000,		/* addiu	$t3, $zero, 0 */
-						/* nbyte: */
-		0x81850000,		/* lb		$a1, ($t4) */
-		0x218C0001,		/* addi		$t4, $t4, 1 */
-		0x00052E00,		/* sll		$a1, $a1, 24 */
-		0x3C0204C1,		/* lui		$v0, 0x04c1 */
-		0x00852026,		/* xor		$a0, $a0, $a1 */
-		0x34471DB7,		/* ori		$a3, $v0, 0x1db7 */
-		0x00003021,		/* addu		$a2, $zero, $zero */
-						/* loop: */
-		0x00044040,		/* sll		$t0, $a0, 1 */
-		0x24C60001,		/* addiu	$a2, $a2, 1 */
-		0x28840000,		/* slti		$a0, $a0, 0 */
-		0x01074826,		/* xor		$t1, $t0, $a3 */
-		0x0124400B,		/* movn		$t0, $t1, $a0 */
-		0x28C30008,		/* slti		$v1, $a2, 8 */
-		0x1460FFF9,		/* bne		$v1, $zero, loop */
-		0x01002021,		/* addu		$a0, $t0, $zero */
-						/* ncomp: */
-		0x154BFFF0,		/* bne		$t2, $t3, nbyte */
-		0x256B0001,		/* addiu	$t3, $t3, 1 */
-		0x7000003F,		/* sdbbp */
-	};
-
-	/* make sure we have a working area */
-	if (target_alloc_working_area(target, sizeof(mips_crc_code), &crc_algorithm) != ERROR_OK)
+
+	/* small regions use the bit serial loader, larger ones the table
+	 * driven word loader and its 1 KiB table */
+	if (count < MIPS32_CRC_TABLE_MIN_SIZE)
 	{
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+		code_size = sizeof(mips_crc_code);
+		num_reg_params = 2;
+		retval = mips32_load_algorithm(target, mips_crc_code,
+				ARRAY_SIZE(mips_crc_code), NULL, 0, &crc_algorithm);
 	}
+	else
+	{
+		uint32_t i, j, c;
 
-	/* convert flash writing code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(mips_crc_code); i++)
-		target_write_u32(target, crc_algorithm->address + i*sizeof(uint32_t), mips_crc_code[i]);
+		/* same polynomial and bit order as image_calculate_checksum() */
+		for (i = 0; i < 256; i++)
+		{
+			for (c = i << 24, j = 8; j > 0; --j)
+				c = c & 0x80000000 ? (c << 1) ^ 0x04c11db7 : (c << 1);
+			crc_table[i] = c;
+		}
+
+		code_size = sizeof(mips_crc_table_code);
+		num_reg_params = 5;
+		retval = mips32_load_algorithm(target, mips_crc_table_code,
+				ARRAY_SIZE(mips_crc_table_code), crc_table, 256, &crc_algorithm);
+	}
+	if (retval != ERROR_OK)
+		return retval;
 
 	mips32_info.common_magic = MIPS32_COMMON_MAGIC;
 	mips32_info.isa_mode = MIPS32_ISA_MIPS32;
 
+	/* the bit serial loader returns the crc in a0, the table loader in v0 */
 	init_reg_param(&reg_params[0], "a0", 32, PARAM_IN_OUT);
 	buf_set_u32(reg_params[0].value, 0, 32, address);
 
 	init_reg_param(&reg_params[1], "a1", 32, PARAM_OUT);
 	buf_set_u32(reg_params[1].value, 0, 32, count);
 
+	/* the table follows the code */
+	init_reg_param(&reg_params[2], "a2", 32, PARAM_OUT);
+	buf_set_u32(reg_params[2].value, 0, 32, crc_algorithm->address + code_size);
+
+	/* words are byte swapped on little endian targets */
+	init_reg_param(&reg_params[3], "a3", 32, PARAM_OUT);
+	buf_set_u32(reg_params[3].value, 0, 32, target->endianness == TARGET_LITTLE_ENDIAN);
+
+	init_reg_param(&reg_params[4], "v0", 32, PARAM_IN);
+
 	int timeout = 20000 * (1 + (count / (1024 * 1024)));
 
-	if ((retval = target_run_algorithm(target, 0, NULL, 2, reg_params,
-			crc_algorithm->address, crc_algorithm->address + (sizeof(mips_crc_code)-4), timeout,
-			&mips32_info)) != ERROR_OK)
-	{
-		destroy_reg_param(&reg_params[0]);
-		destroy_reg_param(&reg_params[1]);
-		target_free_working_area(target, crc_algorithm);
-		return 0;
-	}
+	retval = target_run_algorithm(target, 0, NULL, num_reg_params, reg_params,
+			crc_algorithm->address, crc_algorithm->address + (code_size - 4), timeout,
+			&mips32_info);
 
-	*checksum = buf_get_u32(reg_params[0].value, 0, 32);
+	if (retval == ERROR_OK)
+		*checksum = buf_get_u32(reg_params[num_reg_params == 2 ? 0 : 4].value, 0, 32);
 
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
+	destroy_reg_param(&reg_params[2]);
+	destroy_reg_param(&reg_params[3]);
+	destroy_reg_param(&reg_params[4]);
 
 	target_free_working_area(target, crc_algorithm);
 
-	return ERROR_OK;
+	return retval;
 }
 
-/** Checks whether a memory region is zeroed. */
+/** Checks whether a memory region is erased (all 0xff). */
 int mips32_blank_check_memory(struct target *target,
 		uint32_t address, uint32_t count, uint32_t* blank)
 {
 	struct working_area *erase_check_algorithm;
 	struct reg_param reg_params[3];
 	struct mips32_algorithm mips32_info;
+	uint32_t result;
 	int retval;
-	uint32_t i;
-
-	static const uint32_t erase_check_code[] =
-	{
-						/* nbyte: */
-		0x80880000,		/* lb		$t0, ($a0) */
-		0x00C83024,		/* and		$a2, $a2, $t0 */
-		0x24A5FFFF,		/* addiu	$a1, $a1, -1 */
-		0x14A0FFFC,		/* bne		$a1, $zero, nbyte */
-		0x24840001,		/* addiu	$a0, $a0, 1 */
-		0x7000003F		/* sdbbp */
-	};
-
-	/* make sure we have a working area */
-	if (target_alloc_working_area(target, sizeof(erase_check_code), &erase_check_algorithm) != ERROR_OK)
-	{
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
-	}
 
-	/* convert flash writing code into a buffer in target endianness */
-	for (i = 0; i < ARRAY_SIZE(erase_check_code); i++)
-	{
-		target_write_u32(target, erase_check_algorithm->address + i*sizeof(uint32_t),
-				erase_check_code[i]);
-	}
+	if ((retval = mips32_load_algorithm(target, mips_erase_check_code,
+			ARRAY_SIZE(mips_erase_check_code), NULL, 0,
+			&erase_check_algorithm)) != ERROR_OK)
+		return retval;
 
 	mips32_info.common_magic = MIPS32_COMMON_MAGIC;
 	mips32_info.isa_mode = MIPS32_ISA_MIPS32;
@@ -730,28 +1102,79 @@ int mips32_blank_check_memory(struct target *target,
 	init_reg_param(&reg_params[1], "a1", 32, PARAM_OUT);
 	buf_set_u32(reg_params[1].value, 0, 32, count);
 
-	init_reg_param(&reg_params[2], "a2", 32, PARAM_IN_OUT);
-	buf_set_u32(reg_params[2].value, 0, 32, 0xff);
+	init_reg_param(&reg_params[2], "v0", 32, PARAM_IN);
+
+	int timeout = 10000 * (1 + (count / (1024 * 1024)));
 
-	if ((retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
+	retval = target_run_algorithm(target, 0, NULL, 3, reg_params,
 			erase_check_algorithm->address,
-			erase_check_algorithm->address + (sizeof(erase_check_code)-2),
-			10000, &mips32_info)) != ERROR_OK)
+			erase_check_algorithm->address + (sizeof(mips_erase_check_code) - 4),
+			timeout, &mips32_info);
+
+	if (retval == ERROR_OK)
 	{
-		destroy_reg_param(&reg_params[0]);
-		destroy_reg_param(&reg_params[1]);
-		destroy_reg_param(&reg_params[2]);
-		target_free_working_area(target, erase_check_algorithm);
-		return 0;
+		/* the loader ands whole words, fold them to a byte */
+		result = buf_get_u32(reg_params[2].value, 0, 32);
+		*blank = (result & (result >> 8) & (result >> 16) & (result >> 24)) & 0xff;
 	}
 
-	*blank = buf_get_u32(reg_params[2].value, 0, 32);
-
 	destroy_reg_param(&reg_params[0]);
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
 
 	target_free_working_area(target, erase_check_algorithm);
 
+	return retval;
+}
+
+static int mips32_verify_pointer(struct command_context *cmd_ctx,
+		struct mips32_common *mips32)
+{
+	if (mips32->common_magic != MIPS32_COMMON_MAGIC)
+	{
+		command_print(cmd_ctx, "target is not an MIPS32");
+		return ERROR_TARGET_INVALID;
+	}
 	return ERROR_OK;
 }
+
+COMMAND_HANDLER(mips32_handle_queued_pracc_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct mips32_common *mips32 = target_to_mips32(target);
+	int retval;
+
+	retval = mips32_verify_pointer(CMD_CTX, mips32);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (CMD_ARGC > 0)
+		COMMAND_PARSE_ENABLE(CMD_ARGV[0], mips32->ejtag_info.queued_pracc);
+
+	command_print(CMD_CTX, "mips32 queued PrAcc execution %s",
+			mips32->ejtag_info.queued_pracc ? "enabled" : "disabled");
+
+	return ERROR_OK;
+}
+
+static const struct command_registration mips32_exec_command_handlers[] = {
+	{
+		.name = "queued_pracc",
+		.handler = mips32_handle_queued_pracc_command,
+		.mode = COMMAND_ANY,
+		.help = "queue processor access mini programs instead of "
+			"flushing the JTAG queue per access",
+		.usage = "['enable'|'disable']",
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
+const struct command_registration mips32_command_handlers[] = {
+	{
+		.name = "mips32",
+		.mode = COMMAND_ANY,
+		.help = "mips32 command group",
+		.chain = mips32_exec_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
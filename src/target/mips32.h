@@ -57,9 +57,6 @@ struct mips32_common
 	uint32_t core_regs[MIPS32NUMCOREREGS];
 	enum mips32_isa_mode isa_mode;
 
-	/* working area for fastdata access */
-	struct working_area *fast_data_area;
-
 	int bp_scanned;
 	int num_inst_bpoints;
 	int num_data_bpoints;
@@ -71,6 +68,12 @@ struct mips32_common
 	/* register cache to processor synchronization */
 	int (*read_core_reg)(struct target *target, int num);
 	int (*write_core_reg)(struct target *target, int num);
+
+	/* algorithm session, the context is saved and restored once
+	 * for all algorithms run in between */
+	int algorithm_session;
+	uint32_t algorithm_context[MIPS32NUMCOREREGS];
+	enum mips32_isa_mode algorithm_isa_mode;
 };
 
 static inline struct mips32_common *
@@ -110,6 +113,9 @@ struct mips32_algorithm
 #define MIPS32_OP_SH	0x29
 #define MIPS32_OP_SW	0x2B
 #define MIPS32_OP_ORI	0x0D
+#define MIPS32_OP_XORI	0x0E
+#define MIPS32_OP_XOR	0x26
+#define MIPS32_OP_MOVZ	0x0A
 
 #define MIPS32_COP0_MF	0x00
 #define MIPS32_COP0_MT	0x04
@@ -135,10 +141,13 @@ struct mips32_algorithm
 #define MIPS32_MFHI(reg)			MIPS32_R_INST(0, 0, 0, reg, 0, MIPS32_OP_MFHI)
 #define MIPS32_MTLO(reg)			MIPS32_R_INST(0, reg, 0, 0, 0, MIPS32_OP_MTLO)
 #define MIPS32_MTHI(reg)			MIPS32_R_INST(0, reg, 0, 0, 0, MIPS32_OP_MTHI)
+#define MIPS32_MOVZ(reg, src, cond)	MIPS32_R_INST(0, src, cond, reg, 0, MIPS32_OP_MOVZ)
 #define MIPS32_ORI(src, tar, val)	MIPS32_I_INST(MIPS32_OP_ORI, src, tar, val)
 #define MIPS32_SB(reg, off, base)	MIPS32_I_INST(MIPS32_OP_SB, base, reg, off)
 #define MIPS32_SH(reg, off, base)	MIPS32_I_INST(MIPS32_OP_SH, base, reg, off)
 #define MIPS32_SW(reg, off, base)	MIPS32_I_INST(MIPS32_OP_SW, base, reg, off)
+#define MIPS32_XOR(reg, src1, src2)	MIPS32_R_INST(0, src1, src2, reg, 0, MIPS32_OP_XOR)
+#define MIPS32_XORI(src, tar, val)	MIPS32_I_INST(MIPS32_OP_XORI, src, tar, val)
 
 /* ejtag specific instructions */
 #define MIPS32_DRET					0x4200001F
@@ -161,13 +170,20 @@ int mips32_run_algorithm(struct target *target,
 		uint32_t entry_point, uint32_t exit_point,
 		int timeout_ms, void *arch_info);
 
+int mips32_algorithm_session_begin(struct target *target);
+int mips32_algorithm_session_end(struct target *target);
+
+int mips32_stream_algorithm(struct target *target, uint32_t entry,
+		int num_args, const uint32_t *args, int count, uint32_t *buf,
+		uint32_t *status, int timeout_ms);
+
 int mips32_configure_break_unit(struct target *target);
 
 int mips32_enable_interrupts(struct target *target, int enable);
 
 int mips32_examine(struct target *target);
 
-int mips32_register_commands(struct command_context *cmd_ctx);
+extern const struct command_registration mips32_command_handlers[];
 
 int mips32_get_gdb_reg_list(struct target *target,
 		struct reg **reg_list[], int *reg_list_size);
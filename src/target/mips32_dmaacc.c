@@ -27,20 +27,8 @@
 #endif
 
 #include "mips32_dmaacc.h"
-
-static int mips32_dmaacc_read_mem8(struct mips_ejtag *ejtag_info,
-		uint32_t addr, int count, uint8_t *buf);
-static int mips32_dmaacc_read_mem16(struct mips_ejtag *ejtag_info,
-		uint32_t addr, int count, uint16_t *buf);
-static int mips32_dmaacc_read_mem32(struct mips_ejtag *ejtag_info,
-		uint32_t addr, int count, uint32_t *buf);
-
-static int mips32_dmaacc_write_mem8(struct mips_ejtag *ejtag_info,
-		uint32_t addr, int count, uint8_t *buf);
-static int mips32_dmaacc_write_mem16(struct mips_ejtag *ejtag_info,
-		uint32_t addr, int count, uint16_t *buf);
-static int mips32_dmaacc_write_mem32(struct mips_ejtag *ejtag_info,
-		uint32_t addr, int count, uint32_t *buf);
+#include "target.h"
+#include <helper/time_support.h>
 
 /*
  * The following logic shamelessly cloned from HairyDairyMaid's wrt54g_debrick
@@ -362,109 +350,302 @@ begin_ejtag_dma_write_b:
 	return ERROR_OK;
 }
 
-int mips32_dmaacc_read_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, void *buf)
+/*
+ * Block mode: the address, data and control scans of a whole block are
+ * queued and DSTRT/DERR are checked by a callback once the queue has been
+ * executed. The queue cannot poll, so each DMA is given idle clocks to
+ * complete before DSTRT is sampled and the next access touches ADDRESS
+ * and DATA. If DSTRT was still set, the accesses queued after it ran
+ * against an unfinished transfer: the pending access is polled until it
+ * completes, a read (which sampled DATA too early) or a failed write is
+ * redone with the polling routines above, and the transfer resumes in
+ * order right after it with more idle clocks. A write that completed is
+ * not issued again.
+ */
+#define MIPS32_DMAACC_IDLE_CLOCKS		16
+#define MIPS32_DMAACC_IDLE_CLOCKS_MAX	1024
+
+struct mips32_dmaacc_access
+{
+	uint8_t status[4];
+	uint8_t data[4];
+	uint8_t ctrl[4];
+};
+
+struct mips32_dmaacc_block
+{
+	uint32_t addr;
+	int size;
+	int write;
+	void *buf;
+	/* first access of the batch found busy, or -1 */
+	int busy;
+	struct mips32_dmaacc_access access[MIPS32_DMAACC_BLOCK_SIZE];
+};
+
+static uint32_t mips32_dmaacc_size_flag(int size)
 {
 	switch (size)
 	{
 		case 1:
-			return mips32_dmaacc_read_mem8(ejtag_info, addr, count, (uint8_t*)buf);
+			return EJTAG_CTRL_DMA_BYTE;
 		case 2:
-			return mips32_dmaacc_read_mem16(ejtag_info, addr, count, (uint16_t*)buf);
-		case 4:
-			return mips32_dmaacc_read_mem32(ejtag_info, addr, count, (uint32_t*)buf);
+			return EJTAG_CTRL_DMA_HALFWORD;
+		default:
+			return EJTAG_CTRL_DMA_WORD;
 	}
-
-	return ERROR_OK;
 }
 
-static int mips32_dmaacc_read_mem32(struct mips_ejtag *ejtag_info, uint32_t addr, int count, uint32_t *buf)
+static int mips32_dmaacc_block_check(jtag_callback_data_t arg,
+		jtag_callback_data_t first, jtag_callback_data_t num,
+		jtag_callback_data_t dummy)
 {
+	struct mips32_dmaacc_block *block = (struct mips32_dmaacc_block *)arg;
 	int i;
-	int	retval;
 
-	for (i = 0; i < count; i++) {
-		if ((retval = ejtag_dma_read(ejtag_info, addr + i*sizeof(*buf), &buf[i])) != ERROR_OK)
-			return retval;
+	for (i = 0; i < num; i++)
+	{
+		struct mips32_dmaacc_access *access = &block->access[i];
+		int index = first + i;
+		uint32_t addr = block->addr + index * block->size;
+		uint32_t v;
+
+		/* transfer still running when we looked, the rest is unreliable */
+		if (buf_get_u32(access->status, 0, 32) & EJTAG_CTRL_DSTRT)
+		{
+			block->busy = i;
+			break;
+		}
+
+		if (buf_get_u32(access->ctrl, 0, 32) & EJTAG_CTRL_DERR)
+		{
+			LOG_ERROR("DMA %s Addr = %08" PRIx32 "  Data = ERROR ON %s",
+					block->write ? "Write" : "Read", addr,
+					block->write ? "WRITE" : "READ");
+			return ERROR_JTAG_DEVICE_ERROR;
+		}
+
+		if (block->write)
+			continue;
+
+		/* Handle the bigendian/littleendian */
+		v = buf_get_u32(access->data, 0, 32);
+		switch (block->size)
+		{
+			case 1:
+				((uint8_t*)block->buf)[index] = (v >> (8 * (addr & 0x3))) & 0xff;
+				break;
+			case 2:
+				((uint16_t*)block->buf)[index] = (addr & 0x2) ? (v >> 16) & 0xffff : (v & 0xffff);
+				break;
+			default:
+				((uint32_t*)block->buf)[index] = v;
+				break;
+		}
 	}
 
 	return ERROR_OK;
 }
 
-static int mips32_dmaacc_read_mem16(struct mips_ejtag *ejtag_info, uint32_t addr, int count, uint16_t *buf)
+static int mips32_dmaacc_retry(struct mips_ejtag *ejtag_info,
+		struct mips32_dmaacc_block *block, int index)
 {
-	int i;
-	int retval;
+	uint32_t addr = block->addr + index * block->size;
 
-	for (i = 0; i < count; i++) {
-		if ((retval = ejtag_dma_read_h(ejtag_info, addr + i*sizeof(*buf), &buf[i])) != ERROR_OK)
-			return retval;
+	switch (block->size)
+	{
+		case 1:
+			if (block->write)
+				return ejtag_dma_write_b(ejtag_info, addr, ((uint8_t*)block->buf)[index]);
+			return ejtag_dma_read_b(ejtag_info, addr, &((uint8_t*)block->buf)[index]);
+		case 2:
+			if (block->write)
+				return ejtag_dma_write_h(ejtag_info, addr, ((uint16_t*)block->buf)[index]);
+			return ejtag_dma_read_h(ejtag_info, addr, &((uint16_t*)block->buf)[index]);
+		default:
+			if (block->write)
+				return ejtag_dma_write(ejtag_info, addr, ((uint32_t*)block->buf)[index]);
+			return ejtag_dma_read(ejtag_info, addr, &((uint32_t*)block->buf)[index]);
 	}
-
-	return ERROR_OK;
 }
 
-static int mips32_dmaacc_read_mem8(struct mips_ejtag *ejtag_info, uint32_t addr, int count, uint8_t *buf)
+/* wait for the DMA access still in flight, then clear DMA and report DERR */
+static int mips32_dmaacc_wait(struct mips_ejtag *ejtag_info, int *derr)
 {
-	int i;
+	long long then = timeval_ms();
+	uint32_t ejtag_ctrl;
 	int retval;
 
-	for (i = 0; i < count; i++) {
-		if ((retval = ejtag_dma_read_b(ejtag_info, addr + i*sizeof(*buf), &buf[i])) != ERROR_OK)
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+
+	/* Wait for DSTRT to Clear */
+	for (;;)
+	{
+		ejtag_ctrl = EJTAG_CTRL_DMAACC | ejtag_info->ejtag_ctrl;
+		if ((retval = mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
 			return retval;
+		if (!(ejtag_ctrl & EJTAG_CTRL_DSTRT))
+			break;
+
+		if (timeval_ms() - then > 1000)
+		{
+			LOG_ERROR("DMA access did not complete");
+			return ERROR_TARGET_TIMEOUT;
+		}
+		keep_alive();
 	}
 
+	/* Clear DMA & Check DERR */
+	ejtag_ctrl = ejtag_info->ejtag_ctrl;
+	if ((retval = mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
+		return retval;
+
+	*derr = (ejtag_ctrl & EJTAG_CTRL_DERR) ? 1 : 0;
+
 	return ERROR_OK;
 }
 
-int mips32_dmaacc_write_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, void *buf)
+static int mips32_dmaacc_block_xfer(struct mips_ejtag *ejtag_info, uint32_t addr,
+		int size, int count, void *buf, int write)
 {
-	switch (size)
+	struct mips32_dmaacc_block *block;
+	uint32_t dma_ctrl;
+	int base, i, num;
+	int idle = MIPS32_DMAACC_IDLE_CLOCKS;
+	int retval = ERROR_OK;
+
+	block = malloc(sizeof(struct mips32_dmaacc_block));
+	if (block == NULL)
+		return ERROR_FAIL;
+
+	block->addr = addr;
+	block->size = size;
+	block->write = write;
+	block->buf = buf;
+
+	dma_ctrl = EJTAG_CTRL_DMAACC | mips32_dmaacc_size_flag(size) | EJTAG_CTRL_DSTRT
+			| ejtag_info->ejtag_ctrl;
+	if (!write)
+		dma_ctrl |= EJTAG_CTRL_DRWN;
+
+	for (base = 0; base < count; base += num)
 	{
-		case 1:
-			return mips32_dmaacc_write_mem8(ejtag_info, addr, count, (uint8_t*)buf);
-		case 2:
-			return mips32_dmaacc_write_mem16(ejtag_info, addr, count,(uint16_t*)buf);
-		case 4:
-			return mips32_dmaacc_write_mem32(ejtag_info, addr, count, (uint32_t*)buf);
-	}
+		num = count - base;
+		if (num > MIPS32_DMAACC_BLOCK_SIZE)
+			num = MIPS32_DMAACC_BLOCK_SIZE;
+		block->busy = -1;
+
+		for (i = 0; i < num; i++)
+		{
+			struct mips32_dmaacc_access *access = &block->access[i];
+			uint32_t v;
+
+			/* Setup Address */
+			mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+			mips_ejtag_drscan_32_queued(ejtag_info, addr + (base + i) * size, NULL);
+
+			/* Setup Data, replicated on all byte lanes */
+			if (write)
+			{
+				switch (size)
+				{
+					case 1:
+						v = ((uint8_t*)buf)[base + i];
+						v |= v << 8;
+						v |= v << 16;
+						break;
+					case 2:
+						v = ((uint16_t*)buf)[base + i];
+						v |= v << 16;
+						break;
+					default:
+						v = ((uint32_t*)buf)[base + i];
+						break;
+				}
+				mips_ejtag_set_instr(ejtag_info, EJTAG_INST_DATA);
+				mips_ejtag_drscan_32_queued(ejtag_info, v, NULL);
+			}
+
+			/* Initiate DMA & set DSTRT, let it complete, then sample DSTRT */
+			mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+			mips_ejtag_drscan_32_queued(ejtag_info, dma_ctrl, NULL);
+			jtag_add_clocks(idle);
+			mips_ejtag_drscan_32_queued(ejtag_info,
+					EJTAG_CTRL_DMAACC | ejtag_info->ejtag_ctrl, access->status);
+
+			/* Read Data */
+			if (!write)
+			{
+				mips_ejtag_set_instr(ejtag_info, EJTAG_INST_DATA);
+				mips_ejtag_drscan_32_queued(ejtag_info, 0, access->data);
+			}
+
+			/* Clear DMA & Check DERR */
+			mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+			mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl, access->ctrl);
+		}
 
-	return ERROR_OK;
-}
+		jtag_add_callback4(mips32_dmaacc_block_check, (jtag_callback_data_t)block,
+				base, num, 0);
 
-static int mips32_dmaacc_write_mem32(struct mips_ejtag *ejtag_info, uint32_t addr, int count, uint32_t *buf)
-{
-	int i;
-	int retval;
+		if ((retval = jtag_execute_queue()) != ERROR_OK)
+			break;
 
-	for (i = 0; i < count; i++) {
-		if ((retval = ejtag_dma_write(ejtag_info, addr + i*sizeof(*buf), buf[i])) != ERROR_OK)
-			return retval;
+		if (block->busy >= 0)
+		{
+			int derr;
+
+			LOG_DEBUG("DMA access at 0x%8.8" PRIx32 " still busy after %d clocks",
+					addr + (base + block->busy) * size, idle);
+
+			if ((retval = mips32_dmaacc_wait(ejtag_info, &derr)) != ERROR_OK)
+				break;
+
+			/* a write that completed was latched, issuing it again
+			 * would write twice */
+			if (!write || derr)
+			{
+				LOG_DEBUG("retrying DMA access at 0x%8.8" PRIx32 "",
+						addr + (base + block->busy) * size);
+				if ((retval = mips32_dmaacc_retry(ejtag_info, block, base + block->busy)) != ERROR_OK)
+					break;
+			}
+
+			/* resume in order after the access just redone */
+			num = block->busy + 1;
+			if (idle < MIPS32_DMAACC_IDLE_CLOCKS_MAX)
+				idle *= 2;
+		}
+
+		keep_alive();
 	}
 
-	return ERROR_OK;
+	free(block);
+
+	return retval;
 }
 
-static int mips32_dmaacc_write_mem16(struct mips_ejtag *ejtag_info, uint32_t addr, int count, uint16_t *buf)
+int mips32_dmaacc_read_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, void *buf)
 {
-	int i;
-	int retval;
-
-	for (i = 0; i < count; i++) {
-		if ((retval = ejtag_dma_write_h(ejtag_info, addr + i*sizeof(*buf), buf[i])) != ERROR_OK)
-			return retval;
+	switch (size)
+	{
+		case 1:
+		case 2:
+		case 4:
+			return mips32_dmaacc_block_xfer(ejtag_info, addr, size, count, buf, 0);
 	}
 
 	return ERROR_OK;
 }
 
-static int mips32_dmaacc_write_mem8(struct mips_ejtag *ejtag_info, uint32_t addr, int count, uint8_t *buf)
+int mips32_dmaacc_write_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, void *buf)
 {
-	int i;
-	int retval;
-
-	for (i = 0; i < count; i++) {
-		if ((retval = ejtag_dma_write_b(ejtag_info, addr + i*sizeof(*buf), buf[i])) != ERROR_OK)
-			return retval;
+	switch (size)
+	{
+		case 1:
+		case 2:
+		case 4:
+			return mips32_dmaacc_block_xfer(ejtag_info, addr, size, count, buf, 1);
 	}
 
 	return ERROR_OK;
@@ -34,6 +34,9 @@
 
 #define RETRY_ATTEMPTS	0
 
+/* accesses queued per jtag queue flush in block mode */
+#define MIPS32_DMAACC_BLOCK_SIZE	256
+
 int mips32_dmaacc_read_mem(struct mips_ejtag *ejtag_info,
 		uint32_t addr, int size, int count, void *buf);
 int mips32_dmaacc_write_mem(struct mips_ejtag *ejtag_info,
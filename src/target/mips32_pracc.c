@@ -76,6 +76,7 @@ Nico Coesel
 
 #include "mips32.h"
 #include "mips32_pracc.h"
+#include <helper/time_support.h>
 
 struct mips32_pracc_context
 {
@@ -108,6 +109,11 @@ static int mips32_pracc_write_mem32(struct mips_ejtag *ejtag_info,
 static int mips32_pracc_write_u32(struct mips_ejtag *ejtag_info,
 		uint32_t addr, uint32_t *buf);
 
+static int mips32_pracc_stub_read_mem32(struct mips_ejtag *ejtag_info,
+		uint32_t addr, int count, uint32_t *buf);
+static int mips32_pracc_stub_write_mem32(struct mips_ejtag *ejtag_info,
+		uint32_t addr, int count, uint32_t *buf);
+
 static int wait_for_pracc_rw(struct mips_ejtag *ejtag_info, uint32_t *ctrl)
 {
 	uint32_t ejtag_ctrl;
@@ -284,8 +290,467 @@ int mips32_pracc_exec(struct mips_ejtag *ejtag_info, int code_len, const uint32_
 	return ERROR_OK;
 }
 
+struct mips32_pracc_access
+{
+	uint8_t ctrl[4];
+	uint8_t address[4];
+	uint8_t data[4];
+	uint32_t expected;
+	int write;
+	uint32_t *dest;
+};
+
+static int mips32_pracc_check_access(jtag_callback_data_t arg,
+		jtag_callback_data_t dummy1, jtag_callback_data_t dummy2,
+		jtag_callback_data_t dummy3)
+{
+	struct mips32_pracc_access *access = (struct mips32_pracc_access *)arg;
+	uint32_t ejtag_ctrl = buf_get_u32(access->ctrl, 0, 32);
+	uint32_t address = buf_get_u32(access->address, 0, 32);
+	int write = (ejtag_ctrl & EJTAG_CTRL_PRNW) ? 1 : 0;
+
+	if (!(ejtag_ctrl & EJTAG_CTRL_PRACC))
+	{
+		LOG_DEBUG("DEBUGMODULE: No memory access in progress!");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	if ((write != access->write) || (address != access->expected))
+	{
+		LOG_ERROR("unexpected %s at 0x%8.8" PRIx32 ", expected %s at 0x%8.8" PRIx32 "",
+				write ? "write" : "read", address,
+				access->write ? "write" : "read", access->expected);
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	if (access->dest)
+		*access->dest = buf_get_u32(access->data, 0, 32);
+
+	return ERROR_OK;
+}
+
+
+/* queue one processor access; a write (store) captures its data into dest,
+ * the last access only checks the fetch and leaves it pending */
+static void mips32_pracc_queue_access(struct mips32_pracc_queue *queue,
+		uint32_t address, int write, uint32_t data, uint32_t *dest, int last)
+{
+	struct mips_ejtag *ejtag_info = queue->ejtag_info;
+	struct mips32_pracc_access *access;
+
+	if (queue->retval != ERROR_OK)
+		return;
+
+	access = &queue->access[queue->num_access++];
+	access->expected = address;
+	access->write = write;
+	access->dest = dest;
+
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+	mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl, access->ctrl);
+
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+	mips_ejtag_drscan_32_queued(ejtag_info, 0, access->address);
+
+	if (!last)
+	{
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_DATA);
+		mips_ejtag_drscan_32_queued(ejtag_info, data, write ? access->data : NULL);
+
+		/* Clear the access pending bit (let the processor eat!) */
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+		mips_ejtag_drscan_32_queued(ejtag_info,
+				ejtag_info->ejtag_ctrl & ~EJTAG_CTRL_PRACC, NULL);
+
+		jtag_add_clocks(5);
+	}
+
+	jtag_add_callback4(mips32_pracc_check_access, (jtag_callback_data_t)access, 0, 0, 0);
+
+	if (queue->num_access == MIPS32_PRACC_QUEUE_DEPTH)
+		mips32_pracc_queue_flush(queue);
+}
+
+int mips32_pracc_queue_flush(struct mips32_pracc_queue *queue)
+{
+	int retval = jtag_execute_queue();
+
+	if (queue->retval == ERROR_OK)
+		queue->retval = retval;
+
+	queue->num_access = 0;
+	queue->stack_queued = 0;
+
+	keep_alive();
+
+	return queue->retval;
+}
+
+static void mips32_pracc_queue_fetch(struct mips32_pracc_queue *queue, uint32_t instr)
+{
+	mips32_pracc_queue_access(queue, queue->text, 0, instr, NULL, 0);
+	queue->text += 4;
+
+	/* the store of the previous instruction follows this fetch */
+	if (queue->pending)
+	{
+		queue->pending = 0;
+		mips32_pracc_queue_access(queue, queue->pending_addr, 1, 0,
+				queue->pending_dest, 0);
+	}
+}
+
+static void mips32_pracc_queue_wrap(struct mips32_pracc_queue *queue)
+{
+	/* room for one more instruction, then the branch and its delay slot */
+	if (queue->text - MIPS32_PRACC_TEXT + 3 * 4 <= MIPS32_PRACC_QUEUE_TEXT_SIZE)
+		return;
+
+	mips32_pracc_queue_fetch(queue,
+			MIPS32_B(NEG16((queue->text + 4 - MIPS32_PRACC_TEXT) / 4)));
+	mips32_pracc_queue_fetch(queue, MIPS32_NOP);
+	queue->text = MIPS32_PRACC_TEXT;
+}
+
+int mips32_pracc_queue_init(struct mips32_pracc_queue *queue,
+		struct mips_ejtag *ejtag_info)
+{
+	queue->ejtag_info = ejtag_info;
+	queue->access = malloc(MIPS32_PRACC_QUEUE_DEPTH * sizeof(struct mips32_pracc_access));
+	if (queue->access == NULL)
+		return ERROR_FAIL;
+
+	queue->num_access = 0;
+	queue->text = MIPS32_PRACC_TEXT;
+	queue->pending = 0;
+	queue->stack_offset = 0;
+	queue->stack_queued = 0;
+	queue->retval = ERROR_OK;
+
+	mips32_pracc_queue_instr(queue, MIPS32_MTC0(15,31,0));		/* move $15 to COP0 DeSave */
+	mips32_pracc_queue_li(queue, 15, MIPS32_PRACC_STACK);		/* $15 = MIPS32_PRACC_STACK */
+
+	return ERROR_OK;
+}
+
+void mips32_pracc_queue_free(struct mips32_pracc_queue *queue)
+{
+	free(queue->access);
+	queue->access = NULL;
+}
+
+void mips32_pracc_queue_instr(struct mips32_pracc_queue *queue, uint32_t instr)
+{
+	mips32_pracc_queue_wrap(queue);
+	mips32_pracc_queue_fetch(queue, instr);
+}
+
+void mips32_pracc_queue_li(struct mips32_pracc_queue *queue, int reg, uint32_t val)
+{
+	if (UPPER16(val) == 0)
+	{
+		mips32_pracc_queue_instr(queue, MIPS32_ORI(0,reg,LOWER16(val)));
+		return;
+	}
+
+	mips32_pracc_queue_instr(queue, MIPS32_LUI(reg,UPPER16(val)));
+	if (LOWER16(val))
+		mips32_pracc_queue_instr(queue, MIPS32_ORI(reg,reg,LOWER16(val)));
+}
+
+void mips32_pracc_queue_store(struct mips32_pracc_queue *queue, uint32_t instr,
+		uint32_t addr, uint32_t *dest)
+{
+	mips32_pracc_queue_instr(queue, instr);
+
+	queue->pending = 1;
+	queue->pending_addr = addr;
+	queue->pending_dest = dest;
+}
+
+void mips32_pracc_queue_push(struct mips32_pracc_queue *queue, int reg)
+{
+	mips32_pracc_queue_store(queue, MIPS32_SW(reg,0,15), MIPS32_PRACC_STACK,
+			&queue->stack[queue->stack_offset++]);
+	queue->stack_queued = 1;
+}
+
+void mips32_pracc_queue_pop(struct mips32_pracc_queue *queue, int reg)
+{
+	/* the saved value is needed as immediate, get it off the target first */
+	if (queue->stack_queued)
+	{
+		if (queue->pending)
+			mips32_pracc_queue_instr(queue, MIPS32_NOP);
+		mips32_pracc_queue_flush(queue);
+	}
+
+	mips32_pracc_queue_li(queue, reg, queue->stack[--queue->stack_offset]);
+}
+
+void mips32_pracc_queue_expect(struct mips32_pracc_queue *queue,
+		uint32_t addr, int write)
+{
+	mips32_pracc_queue_access(queue, addr, write, 0, NULL, 1);
+}
+
+int mips32_pracc_queue_exec(struct mips32_pracc_queue *queue)
+{
+	mips32_pracc_queue_wrap(queue);
+
+	mips32_pracc_queue_fetch(queue,
+			MIPS32_B(NEG16((queue->text + 4 - MIPS32_PRACC_TEXT) / 4)));	/* b start */
+	mips32_pracc_queue_fetch(queue, MIPS32_MFC0(15,31,0));		/* move COP0 DeSave to $15 */
+
+	/* the processor has to be back at the debug vector */
+	mips32_pracc_queue_expect(queue, MIPS32_PRACC_TEXT, 0);
+	mips32_pracc_queue_flush(queue);
+
+	if (queue->stack_offset != 0)
+	{
+		LOG_DEBUG("Pracc Stack not zero");
+	}
+
+	return queue->retval;
+}
+
+/**
+ * Apply a list of memory patches, e.g. software breakpoints and break unit
+ * registers, in one queued PrAcc program. The values read back (orig and
+ * verify) are valid once this returns ERROR_OK.
+ */
+int mips32_pracc_patch(struct mips_ejtag *ejtag_info,
+		struct mips32_pracc_patch *patch, int count)
+{
+	struct mips32_pracc_queue queue;
+	int retval;
+	int i;
+
+	if (count <= 0)
+		return ERROR_OK;
+
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+		return retval;
+
+	mips32_pracc_queue_push(&queue, 8);
+	mips32_pracc_queue_push(&queue, 9);
+	mips32_pracc_queue_push(&queue, 10);
+	mips32_pracc_queue_push(&queue, 11);
+
+	for (i = 0; i < count; i++)
+	{
+		struct mips32_pracc_patch *p = &patch[i];
+		uint32_t off = LOWER16(p->address);
+		uint32_t load = (p->size == 2) ? MIPS32_LHU(8,off,9) : MIPS32_LW(8,off,9);
+
+		/* $9 holds the upper half, adjusted for the sign extended offset */
+		mips32_pracc_queue_instr(&queue, MIPS32_LUI(9,UPPER16(p->address + 0x8000)));
+		mips32_pracc_queue_li(&queue, 10, p->value);
+
+		switch (p->type)
+		{
+			case MIPS32_PRACC_PATCH_INSERT:
+				mips32_pracc_queue_instr(&queue, load);
+				mips32_pracc_queue_store(&queue,
+						MIPS32_SW(8,NEG16(MIPS32_PRACC_STACK-MIPS32_PRACC_PARAM_OUT),15),
+						MIPS32_PRACC_PARAM_OUT, &p->orig);
+				mips32_pracc_queue_instr(&queue, (p->size == 2) ?
+						MIPS32_SH(10,off,9) : MIPS32_SW(10,off,9));
+				mips32_pracc_queue_instr(&queue, load);
+				mips32_pracc_queue_store(&queue,
+						MIPS32_SW(8,NEG16(MIPS32_PRACC_STACK-MIPS32_PRACC_PARAM_OUT),15),
+						MIPS32_PRACC_PARAM_OUT, &p->verify);
+				break;
+			case MIPS32_PRACC_PATCH_RESTORE:
+				/* $8 = ($8 == value) ? orig : $8, written back either way */
+				mips32_pracc_queue_instr(&queue, load);
+				mips32_pracc_queue_li(&queue, 11, p->orig);
+				mips32_pracc_queue_instr(&queue, MIPS32_XOR(10,8,10));
+				mips32_pracc_queue_instr(&queue, MIPS32_MOVZ(8,11,10));
+				mips32_pracc_queue_instr(&queue, (p->size == 2) ?
+						MIPS32_SH(8,off,9) : MIPS32_SW(8,off,9));
+				break;
+			default:
+				mips32_pracc_queue_instr(&queue, (p->size == 2) ?
+						MIPS32_SH(10,off,9) : MIPS32_SW(10,off,9));
+				break;
+		}
+	}
+
+	mips32_pracc_queue_pop(&queue, 11);
+	mips32_pracc_queue_pop(&queue, 10);
+	mips32_pracc_queue_pop(&queue, 9);
+	mips32_pracc_queue_pop(&queue, 8);
+
+	retval = mips32_pracc_queue_exec(&queue);
+	mips32_pracc_queue_free(&queue);
+
+	return retval;
+}
+
+static int mips32_pracc_queued_read_mem(struct mips_ejtag *ejtag_info,
+		uint32_t addr, int size, int count, void *buf)
+{
+	struct mips32_pracc_queue queue;
+	uint32_t *data = buf;
+	uint32_t upper = 0;
+	int upper_valid = 0;
+	int retval;
+	int i;
+
+	if (count <= 0)
+		return ERROR_OK;
+
+	/* sub-word reads are zero extended into a word first */
+	if (size != 4)
+	{
+		data = malloc(count * sizeof(uint32_t));
+		if (data == NULL)
+			return ERROR_FAIL;
+	}
+
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+	{
+		if (size != 4)
+			free(data);
+		return retval;
+	}
+
+	mips32_pracc_queue_push(&queue, 8);
+	mips32_pracc_queue_push(&queue, 9);
+
+	for (i = 0; i < count; i++, addr += size)
+	{
+		/* $9 holds the upper half, adjusted for the sign extended offset */
+		if (!upper_valid || (upper != UPPER16(addr + 0x8000)))
+		{
+			upper = UPPER16(addr + 0x8000);
+			upper_valid = 1;
+			mips32_pracc_queue_instr(&queue, MIPS32_LUI(9,upper));
+		}
+
+		switch (size)
+		{
+			case 1:
+				mips32_pracc_queue_instr(&queue, MIPS32_LBU(8,LOWER16(addr),9));
+				break;
+			case 2:
+				mips32_pracc_queue_instr(&queue, MIPS32_LHU(8,LOWER16(addr),9));
+				break;
+			default:
+				mips32_pracc_queue_instr(&queue, MIPS32_LW(8,LOWER16(addr),9));
+				break;
+		}
+
+		/* store R8 @ param_out[0] */
+		mips32_pracc_queue_store(&queue,
+				MIPS32_SW(8,NEG16(MIPS32_PRACC_STACK-MIPS32_PRACC_PARAM_OUT),15),
+				MIPS32_PRACC_PARAM_OUT, &data[i]);
+	}
+
+	mips32_pracc_queue_pop(&queue, 9);
+	mips32_pracc_queue_pop(&queue, 8);
+
+	retval = mips32_pracc_queue_exec(&queue);
+	mips32_pracc_queue_free(&queue);
+
+	if (size != 4)
+	{
+		if (retval == ERROR_OK)
+		{
+			for (i = 0; i < count; i++)
+			{
+				if (size == 1)
+					((uint8_t*)buf)[i] = data[i];
+				else
+					((uint16_t*)buf)[i] = data[i];
+			}
+		}
+		free(data);
+	}
+
+	return retval;
+}
+
+static int mips32_pracc_queued_write_mem(struct mips_ejtag *ejtag_info,
+		uint32_t addr, int size, int count, void *buf)
+{
+	struct mips32_pracc_queue queue;
+	uint32_t upper = 0;
+	uint32_t data;
+	int upper_valid = 0;
+	int retval;
+	int i;
+
+	if (count <= 0)
+		return ERROR_OK;
+
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+		return retval;
+
+	mips32_pracc_queue_push(&queue, 8);
+	mips32_pracc_queue_push(&queue, 9);
+
+	for (i = 0; i < count; i++, addr += size)
+	{
+		switch (size)
+		{
+			case 1:
+				data = ((uint8_t*)buf)[i];
+				break;
+			case 2:
+				data = ((uint16_t*)buf)[i];
+				break;
+			default:
+				data = ((uint32_t*)buf)[i];
+				break;
+		}
+		mips32_pracc_queue_li(&queue, 8, data);
+
+		if (!upper_valid || (upper != UPPER16(addr + 0x8000)))
+		{
+			upper = UPPER16(addr + 0x8000);
+			upper_valid = 1;
+			mips32_pracc_queue_instr(&queue, MIPS32_LUI(9,upper));
+		}
+
+		switch (size)
+		{
+			case 1:
+				mips32_pracc_queue_instr(&queue, MIPS32_SB(8,LOWER16(addr),9));
+				break;
+			case 2:
+				mips32_pracc_queue_instr(&queue, MIPS32_SH(8,LOWER16(addr),9));
+				break;
+			default:
+				mips32_pracc_queue_instr(&queue, MIPS32_SW(8,LOWER16(addr),9));
+				break;
+		}
+	}
+
+	mips32_pracc_queue_pop(&queue, 9);
+	mips32_pracc_queue_pop(&queue, 8);
+
+	retval = mips32_pracc_queue_exec(&queue);
+	mips32_pracc_queue_free(&queue);
+
+	return retval;
+}
+
 int mips32_pracc_read_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, void *buf)
 {
+	/* use the resident stub while a stub working area is around */
+	if (ejtag_info->queued_pracc && (ejtag_info->stub_area != NULL)
+			&& (size == 4) && (count >= MIPS32_PRACC_STUB_MEM_MIN_WORDS))
+	{
+		int retval = mips32_pracc_stub_read_mem32(ejtag_info, addr, count, buf);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
+	if (ejtag_info->queued_pracc)
+		return mips32_pracc_queued_read_mem(ejtag_info, addr, size, count, buf);
+
 	switch (size)
 	{
 		case 1:
@@ -561,6 +1026,18 @@ static int mips32_pracc_read_mem8(struct mips_ejtag *ejtag_info, uint32_t addr,
 
 int mips32_pracc_write_mem(struct mips_ejtag *ejtag_info, uint32_t addr, int size, int count, void *buf)
 {
+	/* use the resident stub while a stub working area is around */
+	if (ejtag_info->queued_pracc && (ejtag_info->stub_area != NULL)
+			&& (size == 4) && (count >= MIPS32_PRACC_STUB_MEM_MIN_WORDS))
+	{
+		int retval = mips32_pracc_stub_write_mem32(ejtag_info, addr, count, buf);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
+	if (ejtag_info->queued_pracc)
+		return mips32_pracc_queued_write_mem(ejtag_info, addr, size, count, buf);
+
 	switch (size)
 	{
 		case 1:
@@ -775,94 +1252,64 @@ static int mips32_pracc_write_mem8(struct mips_ejtag *ejtag_info, uint32_t addr,
 	return retval;
 }
 
-int mips32_pracc_write_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
+void mips32_pracc_stubs_invalidate(struct mips_ejtag *ejtag_info)
 {
-	static const uint32_t code[] = {
-														/* start: */
-		MIPS32_LUI(2,UPPER16(MIPS32_PRACC_PARAM_IN)),	/* $2 = MIPS32_PRACC_PARAM_IN */
-		MIPS32_ORI(2,2,LOWER16(MIPS32_PRACC_PARAM_IN)),
-		MIPS32_LW(1,1*4,2),								/* lw $1,1*4($2) */
-		MIPS32_LW(15,15*4,2),							/* lw $15,15*4($2) */
-		MIPS32_MTC0(15,31,0),							/* move $15 to COP0 DeSave */
-		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_STACK)),		/* $15 = MIPS32_PRACC_STACK */
-		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_STACK)),
-		MIPS32_SW(1,0,15),								/* sw $1,($15) */
-		MIPS32_LUI(1,UPPER16(MIPS32_PRACC_PARAM_IN)),	/* $1 = MIPS32_PRACC_PARAM_IN */
-		MIPS32_ORI(1,1,LOWER16(MIPS32_PRACC_PARAM_IN)),
-		MIPS32_LW(3,3*4,1),								/* lw $3,3*4($1) */
-		MIPS32_LW(4,4*4,1),								/* lw $4,4*4($1) */
-		MIPS32_LW(5,5*4,1),								/* lw $5,5*4($1) */
-		MIPS32_LW(6,6*4,1),								/* lw $6,6*4($1) */
-		MIPS32_LW(7,7*4,1),								/* lw $7,7*4($1) */
-		MIPS32_LW(8,8*4,1),								/* lw $8,8*4($1) */
-		MIPS32_LW(9,9*4,1),								/* lw $9,9*4($1) */
-		MIPS32_LW(10,10*4,1),							/* lw $10,10*4($1) */
-		MIPS32_LW(11,11*4,1),							/* lw $11,11*4($1) */
-		MIPS32_LW(12,12*4,1),							/* lw $12,12*4($1) */
-		MIPS32_LW(13,13*4,1),							/* lw $13,13*4($1) */
-		MIPS32_LW(14,14*4,1),							/* lw $14,14*4($1) */
-		MIPS32_LW(16,16*4,1),							/* lw $16,16*4($1) */
-		MIPS32_LW(17,17*4,1),							/* lw $17,17*4($1) */
-		MIPS32_LW(18,18*4,1),							/* lw $18,18*4($1) */
-		MIPS32_LW(19,19*4,1),							/* lw $19,19*4($1) */
-		MIPS32_LW(20,20*4,1),							/* lw $20,20*4($1) */
-		MIPS32_LW(21,21*4,1),							/* lw $21,21*4($1) */
-		MIPS32_LW(22,22*4,1),							/* lw $22,22*4($1) */
-		MIPS32_LW(23,23*4,1),							/* lw $23,23*4($1) */
-		MIPS32_LW(24,24*4,1),							/* lw $24,24*4($1) */
-		MIPS32_LW(25,25*4,1),							/* lw $25,25*4($1) */
-		MIPS32_LW(26,26*4,1),							/* lw $26,26*4($1) */
-		MIPS32_LW(27,27*4,1),							/* lw $27,27*4($1) */
-		MIPS32_LW(28,28*4,1),							/* lw $28,28*4($1) */
-		MIPS32_LW(29,29*4,1),							/* lw $29,29*4($1) */
-		MIPS32_LW(30,30*4,1),							/* lw $30,30*4($1) */
-		MIPS32_LW(31,31*4,1),							/* lw $31,31*4($1) */
+	int i;
 
-		MIPS32_LW(2,32*4,1),							/* lw $2,32*4($1) */
-		MIPS32_MTC0(2,12,0),							/* move $2 to status */
-		MIPS32_LW(2,33*4,1),							/* lw $2,33*4($1) */
-		MIPS32_MTLO(2),									/* move $2 to lo */
-		MIPS32_LW(2,34*4,1),							/* lw $2,34*4($1) */
-		MIPS32_MTHI(2),									/* move $2 to hi */
-		MIPS32_LW(2,35*4,1),							/* lw $2,35*4($1) */
-		MIPS32_MTC0(2,8,0),								/* move $2 to badvaddr */
-		MIPS32_LW(2,36*4,1),							/* lw $2,36*4($1) */
-		MIPS32_MTC0(2,13,0),							/* move $2 to cause*/
-		MIPS32_LW(2,37*4,1),							/* lw $2,37*4($1) */
-		MIPS32_MTC0(2,24,0),							/* move $2 to depc (pc) */
-
-		MIPS32_LW(2,2*4,1),								/* lw $2,2*4($1) */
-		MIPS32_LW(1,0,15),								/* lw $1,($15) */
-		MIPS32_B(NEG16(53)),							/* b start */
-		MIPS32_MFC0(15,31,0),							/* move COP0 DeSave to $15 */
-	};
+	for (i = 0; i < MIPS_EJTAG_NUM_STUBS; i++)
+		ejtag_info->stub_offset[i] = -1;
+	ejtag_info->stub_used = 0;
+}
 
+/* make sure stub id is resident in the stub working area and return its
+ * address; size is the space the stub needs, code plus its save slots */
+static int mips32_pracc_stub_load(struct mips_ejtag *ejtag_info, enum mips32_pracc_stub id,
+		const uint32_t *code, int words, uint32_t size, uint32_t *addr)
+{
+	struct working_area *area = ejtag_info->stub_area;
 	int retval;
 
-	retval = mips32_pracc_exec(ejtag_info, ARRAY_SIZE(code), code, \
-			MIPS32NUMCOREREGS, regs, 0, NULL, 1);
+	if ((area == NULL) || (area->size < size))
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 
-	return retval;
+	if (ejtag_info->stub_offset[id] < 0)
+	{
+		/* out of room, drop all stubs and start over */
+		if (ejtag_info->stub_used + size > area->size)
+			mips32_pracc_stubs_invalidate(ejtag_info);
+
+		if ((retval = mips32_pracc_write_mem(ejtag_info,
+				area->address + ejtag_info->stub_used, 4, words,
+				(void *)code)) != ERROR_OK)
+			return retval;
+
+		ejtag_info->stub_offset[id] = ejtag_info->stub_used;
+		ejtag_info->stub_used += size;
+
+		LOG_DEBUG("PrAcc stub %d loaded at 0x%8.8" PRIx32 "", id,
+				area->address + ejtag_info->stub_offset[id]);
+	}
+
+	*addr = area->address + ejtag_info->stub_offset[id];
+
+	return ERROR_OK;
 }
 
-int mips32_pracc_read_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
+/* number of words of the stubs with save slots, which follow the code */
+#define MIPS32_PRACC_READ_REGS_STUB_WORDS	56
+#define MIPS32_PRACC_READ_MEM32_STUB_WORDS	23
+#define MIPS32_PRACC_WRITE_MEM32_STUB_WORDS	21
+
+/* run the register read stub from RAM, only its dmseg stores are scanned */
+static int mips32_pracc_stub_read_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
 {
 	static const uint32_t code[] = {
-														/* start: */
-		MIPS32_MTC0(2,31,0),							/* move $2 to COP0 DeSave */
-		MIPS32_LUI(2,UPPER16(MIPS32_PRACC_PARAM_OUT)),	/* $2 = MIPS32_PRACC_PARAM_OUT */
-		MIPS32_ORI(2,2,LOWER16(MIPS32_PRACC_PARAM_OUT)),
-		MIPS32_SW(0,0*4,2),								/* sw $0,0*4($2) */
-		MIPS32_SW(1,1*4,2),								/* sw $1,1*4($2) */
-		MIPS32_SW(15,15*4,2),							/* sw $15,15*4($2) */
-		MIPS32_MFC0(2,31,0),							/* move COP0 DeSave to $2 */
-		MIPS32_MTC0(15,31,0),							/* move $15 to COP0 DeSave */
-		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_STACK)),		/* $15 = MIPS32_PRACC_STACK */
-		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_STACK)),
-		MIPS32_SW(1,0,15),								/* sw $1,($15) */
-		MIPS32_SW(2,0,15),								/* sw $2,($15) */
+		/* r15 points to the start of this code, DeSave holds the original $15 */
+		MIPS32_SW(1,MIPS32_PRACC_READ_REGS_STUB_WORDS * 4,15),		/* save $1 */
+		MIPS32_SW(2,MIPS32_PRACC_READ_REGS_STUB_WORDS * 4 + 4,15),	/* save $2 */
 		MIPS32_LUI(1,UPPER16(MIPS32_PRACC_PARAM_OUT)),	/* $1 = MIPS32_PRACC_PARAM_OUT */
 		MIPS32_ORI(1,1,LOWER16(MIPS32_PRACC_PARAM_OUT)),
+		MIPS32_SW(0,0*4,1),								/* sw $0,0*4($1) */
 		MIPS32_SW(2,2*4,1),								/* sw $2,2*4($1) */
 		MIPS32_SW(3,3*4,1),								/* sw $3,3*4($1) */
 		MIPS32_SW(4,4*4,1),								/* sw $4,4*4($1) */
@@ -876,6 +1323,8 @@ int mips32_pracc_read_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
 		MIPS32_SW(12,12*4,1),							/* sw $12,12*4($1) */
 		MIPS32_SW(13,13*4,1),							/* sw $13,13*4($1) */
 		MIPS32_SW(14,14*4,1),							/* sw $14,14*4($1) */
+		MIPS32_MFC0(2,31,0),							/* move COP0 DeSave to $2 */
+		MIPS32_SW(2,15*4,1),							/* sw $2,15*4($1) */
 		MIPS32_SW(16,16*4,1),							/* sw $16,16*4($1) */
 		MIPS32_SW(17,17*4,1),							/* sw $17,17*4($1) */
 		MIPS32_SW(18,18*4,1),							/* sw $18,18*4($1) */
@@ -892,6 +1341,8 @@ int mips32_pracc_read_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
 		MIPS32_SW(29,29*4,1),							/* sw $29,29*4($1) */
 		MIPS32_SW(30,30*4,1),							/* sw $30,30*4($1) */
 		MIPS32_SW(31,31*4,1),							/* sw $31,31*4($1) */
+		MIPS32_LW(2,MIPS32_PRACC_READ_REGS_STUB_WORDS * 4,15),	/* saved $1 */
+		MIPS32_SW(2,1*4,1),								/* sw $2,1*4($1) */
 
 		MIPS32_MFC0(2,12,0),							/* move status to $2 */
 		MIPS32_SW(2,32*4,1),							/* sw $2,32*4($1) */
@@ -906,154 +1357,1056 @@ int mips32_pracc_read_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
 		MIPS32_MFC0(2,24,0),							/* move depc (pc) to $2 */
 		MIPS32_SW(2,37*4,1),							/* sw $2,37*4($1) */
 
-		MIPS32_LW(2,0,15),								/* lw $2,($15) */
-		MIPS32_LW(1,0,15),								/* lw $1,($15) */
-		MIPS32_B(NEG16(58)),							/* b start */
+		MIPS32_LW(2,MIPS32_PRACC_READ_REGS_STUB_WORDS * 4 + 4,15),	/* restore $2 */
+		MIPS32_LW(1,MIPS32_PRACC_READ_REGS_STUB_WORDS * 4,15),		/* restore $1 */
+		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_TEXT)),
+		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_TEXT)),
+		MIPS32_JR(15),									/* jr start */
 		MIPS32_MFC0(15,31,0),							/* move COP0 DeSave to $15 */
 	};
+	/* register numbers in the order the stub stores them */
+	static const int order[MIPS32NUMCOREREGS] = {
+		0, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19,
+		20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 1, 32, 33, 34, 35, 36, 37,
+	};
 
+	struct mips32_pracc_queue queue;
+	uint32_t stub;
 	int retval;
+	int i;
 
-	retval = mips32_pracc_exec(ejtag_info, ARRAY_SIZE(code), code, \
-		0, NULL, MIPS32NUMCOREREGS, regs, 1);
+	if ((retval = mips32_pracc_stub_load(ejtag_info, MIPS32_PRACC_STUB_READ_REGS,
+			code, ARRAY_SIZE(code), sizeof(code) + 8, &stub)) != ERROR_OK)
+		return retval;
+
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+		return retval;
+
+	mips32_pracc_queue_li(&queue, 15, stub);
+	mips32_pracc_queue_instr(&queue, MIPS32_JR(15));
+	mips32_pracc_queue_instr(&queue, MIPS32_NOP);
+
+	for (i = 0; i < MIPS32NUMCOREREGS; i++)
+		mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_OUT + order[i] * 4,
+				1, 0, &regs[order[i]], 0);
+
+	/* the stub has to be back at the debug vector */
+	mips32_pracc_queue_expect(&queue, MIPS32_PRACC_TEXT, 0);
+	retval = mips32_pracc_queue_flush(&queue);
+	mips32_pracc_queue_free(&queue);
 
 	return retval;
 }
 
-/* fastdata upload/download requires an initialized working area
- * to load the download code; it should not be called otherwise
- * fetch order from the fastdata area
- * 1. start addr
- * 2. end addr
- * 3. data ...
- */
-int mips32_pracc_fastdata_xfer(struct mips_ejtag *ejtag_info, struct working_area *source,
-								int write_t, uint32_t addr, int count, uint32_t *buf)
+/* run the register write stub from RAM, only its dmseg loads are scanned */
+static int mips32_pracc_stub_write_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
 {
-	uint32_t handler_code[] = {
-		/* caution when editing, table is modified below */
-		/* r15 points to the start of this code */
-		MIPS32_SW(8,MIPS32_FASTDATA_HANDLER_SIZE - 4,15),
-		MIPS32_SW(9,MIPS32_FASTDATA_HANDLER_SIZE - 8,15),
-		MIPS32_SW(10,MIPS32_FASTDATA_HANDLER_SIZE - 12,15),
-		MIPS32_SW(11,MIPS32_FASTDATA_HANDLER_SIZE - 16,15),
-		/* start of fastdata area in t0 */
-		MIPS32_LUI(8,UPPER16(MIPS32_PRACC_FASTDATA_AREA)),
-		MIPS32_ORI(8,8,LOWER16(MIPS32_PRACC_FASTDATA_AREA)),
-		MIPS32_LW(9,0,8),								/* start addr in t1 */
-		MIPS32_LW(10,0,8),								/* end addr to t2 */
-														/* loop: */
-		/* 8 */ MIPS32_LW(11,0,0),						/* lw t3,[t8 | r9] */
-		/* 9 */ MIPS32_SW(11,0,0),						/* sw t3,[r9 | r8] */
-		MIPS32_BNE(10,9,NEG16(3)),						/* bne $t2,t1,loop */
-		MIPS32_ADDI(9,9,4),								/* addi t1,t1,4 */
+	static const uint32_t code[] = {
+		/* DeSave holds the original $15, it is replaced by the new one */
+		MIPS32_LUI(1,UPPER16(MIPS32_PRACC_PARAM_IN)),	/* $1 = MIPS32_PRACC_PARAM_IN */
+		MIPS32_ORI(1,1,LOWER16(MIPS32_PRACC_PARAM_IN)),
 
-		MIPS32_LW(8,MIPS32_FASTDATA_HANDLER_SIZE - 4,15),
-		MIPS32_LW(9,MIPS32_FASTDATA_HANDLER_SIZE - 8,15),
-		MIPS32_LW(10,MIPS32_FASTDATA_HANDLER_SIZE - 12,15),
-		MIPS32_LW(11,MIPS32_FASTDATA_HANDLER_SIZE - 16,15),
+		MIPS32_LW(2,32*4,1),							/* lw $2,32*4($1) */
+		MIPS32_MTC0(2,12,0),							/* move $2 to status */
+		MIPS32_LW(2,33*4,1),							/* lw $2,33*4($1) */
+		MIPS32_MTLO(2),									/* move $2 to lo */
+		MIPS32_LW(2,34*4,1),							/* lw $2,34*4($1) */
+		MIPS32_MTHI(2),									/* move $2 to hi */
+		MIPS32_LW(2,35*4,1),							/* lw $2,35*4($1) */
+		MIPS32_MTC0(2,8,0),								/* move $2 to badvaddr */
+		MIPS32_LW(2,36*4,1),							/* lw $2,36*4($1) */
+		MIPS32_MTC0(2,13,0),							/* move $2 to cause*/
+		MIPS32_LW(2,37*4,1),							/* lw $2,37*4($1) */
+		MIPS32_MTC0(2,24,0),							/* move $2 to depc (pc) */
+		MIPS32_LW(2,15*4,1),							/* lw $2,15*4($1) */
+		MIPS32_MTC0(2,31,0),							/* move $2 to COP0 DeSave */
+
+		MIPS32_LW(3,3*4,1),								/* lw $3,3*4($1) */
+		MIPS32_LW(4,4*4,1),								/* lw $4,4*4($1) */
+		MIPS32_LW(5,5*4,1),								/* lw $5,5*4($1) */
+		MIPS32_LW(6,6*4,1),								/* lw $6,6*4($1) */
+		MIPS32_LW(7,7*4,1),								/* lw $7,7*4($1) */
+		MIPS32_LW(8,8*4,1),								/* lw $8,8*4($1) */
+		MIPS32_LW(9,9*4,1),								/* lw $9,9*4($1) */
+		MIPS32_LW(10,10*4,1),							/* lw $10,10*4($1) */
+		MIPS32_LW(11,11*4,1),							/* lw $11,11*4($1) */
+		MIPS32_LW(12,12*4,1),							/* lw $12,12*4($1) */
+		MIPS32_LW(13,13*4,1),							/* lw $13,13*4($1) */
+		MIPS32_LW(14,14*4,1),							/* lw $14,14*4($1) */
+		MIPS32_LW(16,16*4,1),							/* lw $16,16*4($1) */
+		MIPS32_LW(17,17*4,1),							/* lw $17,17*4($1) */
+		MIPS32_LW(18,18*4,1),							/* lw $18,18*4($1) */
+		MIPS32_LW(19,19*4,1),							/* lw $19,19*4($1) */
+		MIPS32_LW(20,20*4,1),							/* lw $20,20*4($1) */
+		MIPS32_LW(21,21*4,1),							/* lw $21,21*4($1) */
+		MIPS32_LW(22,22*4,1),							/* lw $22,22*4($1) */
+		MIPS32_LW(23,23*4,1),							/* lw $23,23*4($1) */
+		MIPS32_LW(24,24*4,1),							/* lw $24,24*4($1) */
+		MIPS32_LW(25,25*4,1),							/* lw $25,25*4($1) */
+		MIPS32_LW(26,26*4,1),							/* lw $26,26*4($1) */
+		MIPS32_LW(27,27*4,1),							/* lw $27,27*4($1) */
+		MIPS32_LW(28,28*4,1),							/* lw $28,28*4($1) */
+		MIPS32_LW(29,29*4,1),							/* lw $29,29*4($1) */
+		MIPS32_LW(30,30*4,1),							/* lw $30,30*4($1) */
+		MIPS32_LW(31,31*4,1),							/* lw $31,31*4($1) */
+		MIPS32_LW(2,2*4,1),								/* lw $2,2*4($1) */
+		MIPS32_LW(1,1*4,1),								/* lw $1,1*4($1) */
 
 		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_TEXT)),
 		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_TEXT)),
 		MIPS32_JR(15),									/* jr start */
 		MIPS32_MFC0(15,31,0),							/* move COP0 DeSave to $15 */
 	};
-
-	uint32_t jmp_code[] = {
-		MIPS32_MTC0(15,31,0),			/* move $15 to COP0 DeSave */
-		/* 1 */ MIPS32_LUI(15,0),		/* addr of working area added below */
-		/* 2 */ MIPS32_ORI(15,15,0),	/* addr of working area added below */
-		MIPS32_JR(15),					/* jump to ram program */
-		MIPS32_NOP,
+	/* register numbers in the order the stub loads them */
+	static const int order[MIPS32NUMCOREREGS - 1] = {
+		32, 33, 34, 35, 36, 37, 15, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+		16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 2, 1,
 	};
 
-	int retval, i;
-	uint32_t val, ejtag_ctrl, address;
+	struct mips32_pracc_queue queue;
+	uint32_t stub;
+	int retval;
+	int i;
 
-	if (source->size < MIPS32_FASTDATA_HANDLER_SIZE)
-		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	if ((retval = mips32_pracc_stub_load(ejtag_info, MIPS32_PRACC_STUB_WRITE_REGS,
+			code, ARRAY_SIZE(code), sizeof(code), &stub)) != ERROR_OK)
+		return retval;
 
-	if (write_t)
-	{
-		handler_code[8] = MIPS32_LW(11,0,8);	/* load data from probe at fastdata area */
-		handler_code[9] = MIPS32_SW(11,0,9);	/* store data to RAM @ r9 */
-	}
-	else
-	{
-		handler_code[8] = MIPS32_LW(11,0,9);	/* load data from RAM @ r9 */
-		handler_code[9] = MIPS32_SW(11,0,8);	/* store data to probe at fastdata area */
-	}
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+		return retval;
 
-	/* write program into RAM */
-	if (write_t != ejtag_info->fast_access_save)
-	{
-		mips32_pracc_write_mem32(ejtag_info, source->address, ARRAY_SIZE(handler_code), handler_code);
-		/* save previous operation to speed to any consecutive read/writes */
-		ejtag_info->fast_access_save = write_t;
-	}
+	mips32_pracc_queue_li(&queue, 15, stub);
+	mips32_pracc_queue_instr(&queue, MIPS32_JR(15));
+	mips32_pracc_queue_instr(&queue, MIPS32_NOP);
 
-	LOG_DEBUG("%s using 0x%.8" PRIx32 " for write handler", __func__, source->address);
+	for (i = 0; i < MIPS32NUMCOREREGS - 1; i++)
+		mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_IN + order[i] * 4,
+				0, regs[order[i]], NULL, 0);
 
-	jmp_code[1] |= UPPER16(source->address);
-	jmp_code[2] |= LOWER16(source->address);
+	/* the stub has to be back at the debug vector */
+	mips32_pracc_queue_expect(&queue, MIPS32_PRACC_TEXT, 0);
+	retval = mips32_pracc_queue_flush(&queue);
+	mips32_pracc_queue_free(&queue);
 
-	for (i = 0; i < (int) ARRAY_SIZE(jmp_code); i++)
-	{
-		if ((retval = wait_for_pracc_rw(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
-			return retval;
+	return retval;
+}
 
-		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_DATA);
-		mips_ejtag_drscan_32(ejtag_info, &jmp_code[i]);
+/* run the word read stub from RAM: the address and count are loaded
+ * from dmseg, then only the store of each word to dmseg is scanned */
+static int mips32_pracc_stub_read_mem32(struct mips_ejtag *ejtag_info,
+		uint32_t addr, int count, uint32_t *buf)
+{
+#define SAVE(n)	(MIPS32_PRACC_READ_MEM32_STUB_WORDS * 4 + (n) * 4)
+	static const uint32_t code[] = {
+		/* r15 points to the start of this code, DeSave holds the original $15 */
+		MIPS32_SW(1,SAVE(0),15),						/* save $1 */
+		MIPS32_SW(2,SAVE(1),15),						/* save $2 */
+		MIPS32_SW(3,SAVE(2),15),						/* save $3 */
+		MIPS32_SW(4,SAVE(3),15),						/* save $4 */
+		MIPS32_LUI(3,UPPER16(MIPS32_PRACC_PARAM_IN)),	/* $3 = MIPS32_PRACC_PARAM_IN */
+		MIPS32_ORI(3,3,LOWER16(MIPS32_PRACC_PARAM_IN)),
+		MIPS32_LW(1,0,3),								/* $1 = addr */
+		MIPS32_LW(2,4,3),								/* $2 = count */
+		MIPS32_LUI(3,UPPER16(MIPS32_PRACC_PARAM_OUT)),	/* $3 = MIPS32_PRACC_PARAM_OUT */
+		MIPS32_ORI(3,3,LOWER16(MIPS32_PRACC_PARAM_OUT)),
+														/* loop: */
+		MIPS32_LW(4,0,1),								/* lw $4,0($1) */
+		MIPS32_ADDI(2,2,NEG16(1)),						/* $2-- */
+		MIPS32_SW(4,0,3),								/* sw $4,0($3) */
+		MIPS32_BNE(2,0,NEG16(4)),						/* bne $2,$0,loop */
+		MIPS32_ADDI(1,1,4),								/* $1 += 4 */
+
+		MIPS32_LW(4,SAVE(3),15),						/* restore $4 */
+		MIPS32_LW(3,SAVE(2),15),						/* restore $3 */
+		MIPS32_LW(2,SAVE(1),15),						/* restore $2 */
+		MIPS32_LW(1,SAVE(0),15),						/* restore $1 */
+		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_TEXT)),
+		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_TEXT)),
+		MIPS32_JR(15),									/* jr start */
+		MIPS32_MFC0(15,31,0),							/* move COP0 DeSave to $15 */
+	};
+#undef SAVE
 
-		/* Clear the access pending bit (let the processor eat!) */
-		ejtag_ctrl = ejtag_info->ejtag_ctrl & ~EJTAG_CTRL_PRACC;
-		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
-		mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl);
-	}
+	struct mips32_pracc_queue queue;
+	uint32_t stub;
+	int retval;
+	int i;
 
-	if ((retval = wait_for_pracc_rw(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
+	if ((retval = mips32_pracc_stub_load(ejtag_info, MIPS32_PRACC_STUB_READ_MEM32,
+			code, ARRAY_SIZE(code), sizeof(code) + 4 * 4, &stub)) != ERROR_OK)
 		return retval;
 
-	/* next fetch to dmseg should be in FASTDATA_AREA, check */
-	address = 0;
-	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
-	mips_ejtag_drscan_32(ejtag_info, &address);
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+		return retval;
 
-	if (address != MIPS32_PRACC_FASTDATA_AREA)
-		return ERROR_FAIL;
+	mips32_pracc_queue_li(&queue, 15, stub);
+	mips32_pracc_queue_instr(&queue, MIPS32_JR(15));
+	mips32_pracc_queue_instr(&queue, MIPS32_NOP);
 
-	/* Send the load start address */
-	val = addr;
-	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_FASTDATA);
-	mips_ejtag_fastdata_scan(ejtag_info, 1, &val);
+	mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_IN, 0, addr, NULL, 0);
+	mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_IN + 4, 0, count, NULL, 0);
+	for (i = 0; i < count; i++)
+		mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_OUT, 1, 0, &buf[i], 0);
 
-	/* Send the load end address */
-	val = addr + (count - 1) * 4;
-	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_FASTDATA);
-	mips_ejtag_fastdata_scan(ejtag_info, 1, &val);
+	/* the stub has to be back at the debug vector */
+	mips32_pracc_queue_expect(&queue, MIPS32_PRACC_TEXT, 0);
+	retval = mips32_pracc_queue_flush(&queue);
+	mips32_pracc_queue_free(&queue);
 
-	for (i = 0; i < count; i++)
-	{
-		/* Send the data out using fastdata (clears the access pending bit) */
-		if ((retval = mips_ejtag_fastdata_scan(ejtag_info, write_t, buf++)) != ERROR_OK)
-			return retval;
-	}
+	return retval;
+}
 
-	if ((retval = jtag_execute_queue()) != ERROR_OK)
-	{
-		LOG_ERROR("fastdata load failed");
+/* run the word write stub from RAM: the address and count are loaded
+ * from dmseg, then only the load of each word from dmseg is scanned */
+static int mips32_pracc_stub_write_mem32(struct mips_ejtag *ejtag_info,
+		uint32_t addr, int count, uint32_t *buf)
+{
+#define SAVE(n)	(MIPS32_PRACC_WRITE_MEM32_STUB_WORDS * 4 + (n) * 4)
+	static const uint32_t code[] = {
+		/* r15 points to the start of this code, DeSave holds the original $15 */
+		MIPS32_SW(1,SAVE(0),15),						/* save $1 */
+		MIPS32_SW(2,SAVE(1),15),						/* save $2 */
+		MIPS32_SW(3,SAVE(2),15),						/* save $3 */
+		MIPS32_SW(4,SAVE(3),15),						/* save $4 */
+		MIPS32_LUI(3,UPPER16(MIPS32_PRACC_PARAM_IN)),	/* $3 = MIPS32_PRACC_PARAM_IN */
+		MIPS32_ORI(3,3,LOWER16(MIPS32_PRACC_PARAM_IN)),
+		MIPS32_LW(1,0,3),								/* $1 = addr */
+		MIPS32_LW(2,4,3),								/* $2 = count */
+														/* loop: */
+		MIPS32_LW(4,8,3),								/* lw $4,8($3) */
+		MIPS32_ADDI(2,2,NEG16(1)),						/* $2-- */
+		MIPS32_SW(4,0,1),								/* sw $4,0($1) */
+		MIPS32_BNE(2,0,NEG16(4)),						/* bne $2,$0,loop */
+		MIPS32_ADDI(1,1,4),								/* $1 += 4 */
+
+		MIPS32_LW(4,SAVE(3),15),						/* restore $4 */
+		MIPS32_LW(3,SAVE(2),15),						/* restore $3 */
+		MIPS32_LW(2,SAVE(1),15),						/* restore $2 */
+		MIPS32_LW(1,SAVE(0),15),						/* restore $1 */
+		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_TEXT)),
+		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_TEXT)),
+		MIPS32_JR(15),									/* jr start */
+		MIPS32_MFC0(15,31,0),							/* move COP0 DeSave to $15 */
+	};
+#undef SAVE
+
+	struct mips32_pracc_queue queue;
+	uint32_t stub;
+	int retval;
+	int i;
+
+	if ((retval = mips32_pracc_stub_load(ejtag_info, MIPS32_PRACC_STUB_WRITE_MEM32,
+			code, ARRAY_SIZE(code), sizeof(code) + 4 * 4, &stub)) != ERROR_OK)
 		return retval;
-	}
 
-	if ((retval = wait_for_pracc_rw(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
 		return retval;
 
-	address = 0;
-	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
-	mips_ejtag_drscan_32(ejtag_info, &address);
+	mips32_pracc_queue_li(&queue, 15, stub);
+	mips32_pracc_queue_instr(&queue, MIPS32_JR(15));
+	mips32_pracc_queue_instr(&queue, MIPS32_NOP);
 
-	if (address != MIPS32_PRACC_TEXT)
-		LOG_ERROR("mini program did not return to start");
+	mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_IN, 0, addr, NULL, 0);
+	mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_IN + 4, 0, count, NULL, 0);
+	for (i = 0; i < count; i++)
+		mips32_pracc_queue_access(&queue, MIPS32_PRACC_PARAM_IN + 8, 0, buf[i], NULL, 0);
+
+	/* the stub has to be back at the debug vector */
+	mips32_pracc_queue_expect(&queue, MIPS32_PRACC_TEXT, 0);
+	retval = mips32_pracc_queue_flush(&queue);
+	mips32_pracc_queue_free(&queue);
 
 	return retval;
 }
+
+int mips32_pracc_write_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
+{
+	static const uint32_t code[] = {
+														/* start: */
+		MIPS32_LUI(2,UPPER16(MIPS32_PRACC_PARAM_IN)),	/* $2 = MIPS32_PRACC_PARAM_IN */
+		MIPS32_ORI(2,2,LOWER16(MIPS32_PRACC_PARAM_IN)),
+		MIPS32_LW(1,1*4,2),								/* lw $1,1*4($2) */
+		MIPS32_LW(15,15*4,2),							/* lw $15,15*4($2) */
+		MIPS32_MTC0(15,31,0),							/* move $15 to COP0 DeSave */
+		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_STACK)),		/* $15 = MIPS32_PRACC_STACK */
+		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_STACK)),
+		MIPS32_SW(1,0,15),								/* sw $1,($15) */
+		MIPS32_LUI(1,UPPER16(MIPS32_PRACC_PARAM_IN)),	/* $1 = MIPS32_PRACC_PARAM_IN */
+		MIPS32_ORI(1,1,LOWER16(MIPS32_PRACC_PARAM_IN)),
+		MIPS32_LW(3,3*4,1),								/* lw $3,3*4($1) */
+		MIPS32_LW(4,4*4,1),								/* lw $4,4*4($1) */
+		MIPS32_LW(5,5*4,1),								/* lw $5,5*4($1) */
+		MIPS32_LW(6,6*4,1),								/* lw $6,6*4($1) */
+		MIPS32_LW(7,7*4,1),								/* lw $7,7*4($1) */
+		MIPS32_LW(8,8*4,1),								/* lw $8,8*4($1) */
+		MIPS32_LW(9,9*4,1),								/* lw $9,9*4($1) */
+		MIPS32_LW(10,10*4,1),							/* lw $10,10*4($1) */
+		MIPS32_LW(11,11*4,1),							/* lw $11,11*4($1) */
+		MIPS32_LW(12,12*4,1),							/* lw $12,12*4($1) */
+		MIPS32_LW(13,13*4,1),							/* lw $13,13*4($1) */
+		MIPS32_LW(14,14*4,1),							/* lw $14,14*4($1) */
+		MIPS32_LW(16,16*4,1),							/* lw $16,16*4($1) */
+		MIPS32_LW(17,17*4,1),							/* lw $17,17*4($1) */
+		MIPS32_LW(18,18*4,1),							/* lw $18,18*4($1) */
+		MIPS32_LW(19,19*4,1),							/* lw $19,19*4($1) */
+		MIPS32_LW(20,20*4,1),							/* lw $20,20*4($1) */
+		MIPS32_LW(21,21*4,1),							/* lw $21,21*4($1) */
+		MIPS32_LW(22,22*4,1),							/* lw $22,22*4($1) */
+		MIPS32_LW(23,23*4,1),							/* lw $23,23*4($1) */
+		MIPS32_LW(24,24*4,1),							/* lw $24,24*4($1) */
+		MIPS32_LW(25,25*4,1),							/* lw $25,25*4($1) */
+		MIPS32_LW(26,26*4,1),							/* lw $26,26*4($1) */
+		MIPS32_LW(27,27*4,1),							/* lw $27,27*4($1) */
+		MIPS32_LW(28,28*4,1),							/* lw $28,28*4($1) */
+		MIPS32_LW(29,29*4,1),							/* lw $29,29*4($1) */
+		MIPS32_LW(30,30*4,1),							/* lw $30,30*4($1) */
+		MIPS32_LW(31,31*4,1),							/* lw $31,31*4($1) */
+
+		MIPS32_LW(2,32*4,1),							/* lw $2,32*4($1) */
+		MIPS32_MTC0(2,12,0),							/* move $2 to status */
+		MIPS32_LW(2,33*4,1),							/* lw $2,33*4($1) */
+		MIPS32_MTLO(2),									/* move $2 to lo */
+		MIPS32_LW(2,34*4,1),							/* lw $2,34*4($1) */
+		MIPS32_MTHI(2),									/* move $2 to hi */
+		MIPS32_LW(2,35*4,1),							/* lw $2,35*4($1) */
+		MIPS32_MTC0(2,8,0),								/* move $2 to badvaddr */
+		MIPS32_LW(2,36*4,1),							/* lw $2,36*4($1) */
+		MIPS32_MTC0(2,13,0),							/* move $2 to cause*/
+		MIPS32_LW(2,37*4,1),							/* lw $2,37*4($1) */
+		MIPS32_MTC0(2,24,0),							/* move $2 to depc (pc) */
+
+		MIPS32_LW(2,2*4,1),								/* lw $2,2*4($1) */
+		MIPS32_LW(1,0,15),								/* lw $1,($15) */
+		MIPS32_B(NEG16(53)),							/* b start */
+		MIPS32_MFC0(15,31,0),							/* move COP0 DeSave to $15 */
+	};
+
+	int retval;
+
+	/* use the resident stub while a stub working area is around */
+	if (ejtag_info->queued_pracc && (ejtag_info->stub_area != NULL))
+	{
+		retval = mips32_pracc_stub_write_regs(ejtag_info, regs);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
+	retval = mips32_pracc_exec(ejtag_info, ARRAY_SIZE(code), code, \
+			MIPS32NUMCOREREGS, regs, 0, NULL, 1);
+
+	return retval;
+}
+
+int mips32_pracc_read_regs(struct mips_ejtag *ejtag_info, uint32_t *regs)
+{
+	static const uint32_t code[] = {
+														/* start: */
+		MIPS32_MTC0(2,31,0),							/* move $2 to COP0 DeSave */
+		MIPS32_LUI(2,UPPER16(MIPS32_PRACC_PARAM_OUT)),	/* $2 = MIPS32_PRACC_PARAM_OUT */
+		MIPS32_ORI(2,2,LOWER16(MIPS32_PRACC_PARAM_OUT)),
+		MIPS32_SW(0,0*4,2),								/* sw $0,0*4($2) */
+		MIPS32_SW(1,1*4,2),								/* sw $1,1*4($2) */
+		MIPS32_SW(15,15*4,2),							/* sw $15,15*4($2) */
+		MIPS32_MFC0(2,31,0),							/* move COP0 DeSave to $2 */
+		MIPS32_MTC0(15,31,0),							/* move $15 to COP0 DeSave */
+		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_STACK)),		/* $15 = MIPS32_PRACC_STACK */
+		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_STACK)),
+		MIPS32_SW(1,0,15),								/* sw $1,($15) */
+		MIPS32_SW(2,0,15),								/* sw $2,($15) */
+		MIPS32_LUI(1,UPPER16(MIPS32_PRACC_PARAM_OUT)),	/* $1 = MIPS32_PRACC_PARAM_OUT */
+		MIPS32_ORI(1,1,LOWER16(MIPS32_PRACC_PARAM_OUT)),
+		MIPS32_SW(2,2*4,1),								/* sw $2,2*4($1) */
+		MIPS32_SW(3,3*4,1),								/* sw $3,3*4($1) */
+		MIPS32_SW(4,4*4,1),								/* sw $4,4*4($1) */
+		MIPS32_SW(5,5*4,1),								/* sw $5,5*4($1) */
+		MIPS32_SW(6,6*4,1),								/* sw $6,6*4($1) */
+		MIPS32_SW(7,7*4,1),								/* sw $7,7*4($1) */
+		MIPS32_SW(8,8*4,1),								/* sw $8,8*4($1) */
+		MIPS32_SW(9,9*4,1),								/* sw $9,9*4($1) */
+		MIPS32_SW(10,10*4,1),							/* sw $10,10*4($1) */
+		MIPS32_SW(11,11*4,1),							/* sw $11,11*4($1) */
+		MIPS32_SW(12,12*4,1),							/* sw $12,12*4($1) */
+		MIPS32_SW(13,13*4,1),							/* sw $13,13*4($1) */
+		MIPS32_SW(14,14*4,1),							/* sw $14,14*4($1) */
+		MIPS32_SW(16,16*4,1),							/* sw $16,16*4($1) */
+		MIPS32_SW(17,17*4,1),							/* sw $17,17*4($1) */
+		MIPS32_SW(18,18*4,1),							/* sw $18,18*4($1) */
+		MIPS32_SW(19,19*4,1),							/* sw $19,19*4($1) */
+		MIPS32_SW(20,20*4,1),							/* sw $20,20*4($1) */
+		MIPS32_SW(21,21*4,1),							/* sw $21,21*4($1) */
+		MIPS32_SW(22,22*4,1),							/* sw $22,22*4($1) */
+		MIPS32_SW(23,23*4,1),							/* sw $23,23*4($1) */
+		MIPS32_SW(24,24*4,1),							/* sw $24,24*4($1) */
+		MIPS32_SW(25,25*4,1),							/* sw $25,25*4($1) */
+		MIPS32_SW(26,26*4,1),							/* sw $26,26*4($1) */
+		MIPS32_SW(27,27*4,1),							/* sw $27,27*4($1) */
+		MIPS32_SW(28,28*4,1),							/* sw $28,28*4($1) */
+		MIPS32_SW(29,29*4,1),							/* sw $29,29*4($1) */
+		MIPS32_SW(30,30*4,1),							/* sw $30,30*4($1) */
+		MIPS32_SW(31,31*4,1),							/* sw $31,31*4($1) */
+
+		MIPS32_MFC0(2,12,0),							/* move status to $2 */
+		MIPS32_SW(2,32*4,1),							/* sw $2,32*4($1) */
+		MIPS32_MFLO(2),									/* move lo to $2 */
+		MIPS32_SW(2,33*4,1),							/* sw $2,33*4($1) */
+		MIPS32_MFHI(2),									/* move hi to $2 */
+		MIPS32_SW(2,34*4,1),							/* sw $2,34*4($1) */
+		MIPS32_MFC0(2,8,0),								/* move badvaddr to $2 */
+		MIPS32_SW(2,35*4,1),							/* sw $2,35*4($1) */
+		MIPS32_MFC0(2,13,0),							/* move cause to $2 */
+		MIPS32_SW(2,36*4,1),							/* sw $2,36*4($1) */
+		MIPS32_MFC0(2,24,0),							/* move depc (pc) to $2 */
+		MIPS32_SW(2,37*4,1),							/* sw $2,37*4($1) */
+
+		MIPS32_LW(2,0,15),								/* lw $2,($15) */
+		MIPS32_LW(1,0,15),								/* lw $1,($15) */
+		MIPS32_B(NEG16(58)),							/* b start */
+		MIPS32_MFC0(15,31,0),							/* move COP0 DeSave to $15 */
+	};
+
+	int retval;
+
+	/* use the resident stub while a stub working area is around */
+	if (ejtag_info->queued_pracc && (ejtag_info->stub_area != NULL))
+	{
+		retval = mips32_pracc_stub_read_regs(ejtag_info, regs);
+		if (retval != ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			return retval;
+	}
+
+	retval = mips32_pracc_exec(ejtag_info, ARRAY_SIZE(code), code, \
+		0, NULL, MIPS32NUMCOREREGS, regs, 1);
+
+	return retval;
+}
+
+/* moves between $1 and status, lo, hi, badvaddr, cause and depc (pc) */
+static const uint32_t mips32_pracc_special_read[] = {
+	MIPS32_MFC0(1,12,0),
+	MIPS32_MFLO(1),
+	MIPS32_MFHI(1),
+	MIPS32_MFC0(1,8,0),
+	MIPS32_MFC0(1,13,0),
+	MIPS32_MFC0(1,24,0),
+};
+
+static const uint32_t mips32_pracc_special_write[] = {
+	MIPS32_MTC0(1,12,0),
+	MIPS32_MTLO(1),
+	MIPS32_MTHI(1),
+	MIPS32_MTC0(1,8,0),
+	MIPS32_MTC0(1,13,0),
+	MIPS32_MTC0(1,24,0),
+};
+
+/* read only the core registers in mask, with one queued program */
+int mips32_pracc_read_regs_mask(struct mips_ejtag *ejtag_info, uint64_t mask, uint32_t *regs)
+{
+	struct mips32_pracc_queue queue;
+	int retval;
+	int i;
+
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+		return retval;
+
+	for (i = 1; i < 32; i++)
+	{
+		if ((i != 15) && (mask & MIPS32_PRACC_REG_BIT(i)))
+			mips32_pracc_queue_store(&queue, MIPS32_SW(i,0,15),		/* sw $i,($15) */
+					MIPS32_PRACC_STACK, &regs[i]);
+	}
+
+	/* $15 is held in DeSave, it and the special registers need $1 */
+	if (mask & MIPS32_PRACC_SCRATCH_REGS)
+	{
+		mips32_pracc_queue_push(&queue, 1);
+
+		if (mask & MIPS32_PRACC_REG_BIT(15))
+		{
+			mips32_pracc_queue_instr(&queue, MIPS32_MFC0(1,31,0));	/* move COP0 DeSave to $1 */
+			mips32_pracc_queue_store(&queue, MIPS32_SW(1,0,15),
+					MIPS32_PRACC_STACK, &regs[15]);
+		}
+
+		for (i = 32; i < MIPS32NUMCOREREGS; i++)
+		{
+			if (!(mask & MIPS32_PRACC_REG_BIT(i)))
+				continue;
+			mips32_pracc_queue_instr(&queue, mips32_pracc_special_read[i - 32]);
+			mips32_pracc_queue_store(&queue, MIPS32_SW(1,0,15),
+					MIPS32_PRACC_STACK, &regs[i]);
+		}
+
+		mips32_pracc_queue_pop(&queue, 1);
+	}
+
+	if (mask & MIPS32_PRACC_REG_BIT(0))
+		regs[0] = 0;
+
+	retval = mips32_pracc_queue_exec(&queue);
+	mips32_pracc_queue_free(&queue);
+
+	return retval;
+}
+
+/* write only the core registers in mask, with one queued program; the
+ * values are loaded as immediates, so nothing is read back from dmseg */
+int mips32_pracc_write_regs_mask(struct mips_ejtag *ejtag_info, uint64_t mask, uint32_t *regs)
+{
+	struct mips32_pracc_queue queue;
+	int retval;
+	int i;
+
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+		return retval;
+
+	if (mask & MIPS32_PRACC_SCRATCH_REGS)
+	{
+		/* $1 only needs saving if it is not written anyway */
+		if (!(mask & MIPS32_PRACC_REG_BIT(1)))
+			mips32_pracc_queue_push(&queue, 1);
+
+		/* the exit code moves DeSave back to $15 */
+		if (mask & MIPS32_PRACC_REG_BIT(15))
+		{
+			mips32_pracc_queue_li(&queue, 1, regs[15]);
+			mips32_pracc_queue_instr(&queue, MIPS32_MTC0(1,31,0));	/* move $1 to COP0 DeSave */
+		}
+
+		for (i = 32; i < MIPS32NUMCOREREGS; i++)
+		{
+			if (!(mask & MIPS32_PRACC_REG_BIT(i)))
+				continue;
+			mips32_pracc_queue_li(&queue, 1, regs[i]);
+			mips32_pracc_queue_instr(&queue, mips32_pracc_special_write[i - 32]);
+		}
+
+		if (!(mask & MIPS32_PRACC_REG_BIT(1)))
+			mips32_pracc_queue_pop(&queue, 1);
+	}
+
+	for (i = 1; i < 32; i++)
+	{
+		if ((i != 15) && (mask & MIPS32_PRACC_REG_BIT(i)))
+			mips32_pracc_queue_li(&queue, i, regs[i]);
+	}
+
+	retval = mips32_pracc_queue_exec(&queue);
+	mips32_pracc_queue_free(&queue);
+
+	return retval;
+}
+
+/* fastdata upload/download requires an initialized working area
+ * to load the download code; it should not be called otherwise
+ * fetch order from the fastdata area
+ * 1. start addr
+ * 2. end addr
+ * 3. data ...
+ */
+struct mips32_fastdata_xfer
+{
+	int write_t;
+	uint32_t *buf;
+	int count;
+
+	/* words the processor has accepted/delivered so far */
+	int done;
+
+	/* SPrAcc of each scan queued in the current flush */
+	uint8_t spracc[MIPS32_FASTDATA_CHUNK_SIZE * MIPS32_FASTDATA_CHUNKS];
+	int failed;
+
+	/* words that were written with the data of a later scan */
+	int retry_start;
+	int retry_end;
+};
+
+/* account the scans of one chunk once the queue has been executed */
+static int mips32_pracc_fastdata_check(jtag_callback_data_t arg,
+		jtag_callback_data_t first, jtag_callback_data_t num,
+		jtag_callback_data_t base)
+{
+	struct mips32_fastdata_xfer *xfer = (struct mips32_fastdata_xfer *)arg;
+	int i;
+
+	for (i = first; i < first + num; i++)
+	{
+		if (!(xfer->spracc[i] & 1))
+		{
+			/* the processor was not ready, every following scan of this
+			 * flush completes the access meant for the previous one */
+			if (xfer->write_t && !xfer->failed
+					&& (xfer->retry_start < 0 || xfer->done < xfer->retry_start))
+				xfer->retry_start = xfer->done;
+			xfer->failed = 1;
+			continue;
+		}
+
+		/* a read completes the oldest pending word, compact the buffer */
+		if (!xfer->write_t && (xfer->done != base + i))
+			xfer->buf[xfer->done] = xfer->buf[base + i];
+
+		xfer->done++;
+	}
+
+	return ERROR_OK;
+}
+
+/* feed the jump code to the handler one handshake at a time, the processor
+ * is left with its first access to the fastdata area pending */
+static int mips32_pracc_fastdata_jump(struct mips_ejtag *ejtag_info,
+		uint32_t *code, int code_len)
+{
+	uint32_t ejtag_ctrl, address;
+	int retval, i;
+
+	for (i = 0; i < code_len; i++)
+	{
+		if ((retval = wait_for_pracc_rw(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
+			return retval;
+
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_DATA);
+		mips_ejtag_drscan_32(ejtag_info, &code[i]);
+
+		/* Clear the access pending bit (let the processor eat!) */
+		ejtag_ctrl = ejtag_info->ejtag_ctrl & ~EJTAG_CTRL_PRACC;
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+		mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl);
+	}
+
+	if ((retval = wait_for_pracc_rw(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
+		return retval;
+
+	/* next access to dmseg should be in FASTDATA_AREA, check */
+	address = 0;
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+	mips_ejtag_drscan_32(ejtag_info, &address);
+
+	if (address != MIPS32_PRACC_FASTDATA_AREA)
+		return ERROR_FAIL;
+
+	return ERROR_OK;
+}
+
+static int mips32_pracc_fastdata_xfer_once(struct mips_ejtag *ejtag_info,
+		uint32_t handler, struct mips32_fastdata_xfer *xfer, uint32_t addr)
+{
+	struct mips32_pracc_queue queue;
+	uint8_t ctrl[4], address[4];
+	uint32_t ejtag_ctrl;
+	int stalls = 0;
+	int retval;
+	int i;
+
+	xfer->done = 0;
+	xfer->retry_start = -1;
+	xfer->retry_end = -1;
+
+	/* jump to the handler, with start address and end address loaded
+	 * into its registers, so no fastdata word can be taken for them */
+	if (!ejtag_info->queued_pracc)
+	{
+		uint32_t end = addr + (xfer->count - 1) * 4;
+		uint32_t jmp_code[] = {
+			MIPS32_MTC0(15,31,0),			/* move $15 to COP0 DeSave */
+			MIPS32_LUI(15,UPPER16(handler)),
+			MIPS32_ORI(15,15,LOWER16(handler)),
+			MIPS32_SW(8,MIPS32_FASTDATA_HANDLER_SIZE - 4,15),
+			MIPS32_SW(9,MIPS32_FASTDATA_HANDLER_SIZE - 8,15),
+			MIPS32_SW(10,MIPS32_FASTDATA_HANDLER_SIZE - 12,15),
+			MIPS32_SW(11,MIPS32_FASTDATA_HANDLER_SIZE - 16,15),
+			MIPS32_LUI(8,UPPER16(MIPS32_PRACC_FASTDATA_AREA)),	/* start of fastdata area in t0 */
+			MIPS32_ORI(8,8,LOWER16(MIPS32_PRACC_FASTDATA_AREA)),
+			MIPS32_LUI(9,UPPER16(addr)),		/* start addr in t1 */
+			MIPS32_ORI(9,9,LOWER16(addr)),
+			MIPS32_LUI(10,UPPER16(end)),		/* end addr in t2 */
+			MIPS32_ORI(10,10,LOWER16(end)),
+			MIPS32_JR(15),					/* jump to ram program */
+			MIPS32_NOP,
+		};
+
+		if ((retval = mips32_pracc_fastdata_jump(ejtag_info,
+				jmp_code, ARRAY_SIZE(jmp_code))) != ERROR_OK)
+			return retval;
+	}
+	else
+	{
+		if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+			return retval;
+
+		mips32_pracc_queue_li(&queue, 15, handler);
+		mips32_pracc_queue_instr(&queue, MIPS32_SW(8,MIPS32_FASTDATA_HANDLER_SIZE - 4,15));
+		mips32_pracc_queue_instr(&queue, MIPS32_SW(9,MIPS32_FASTDATA_HANDLER_SIZE - 8,15));
+		mips32_pracc_queue_instr(&queue, MIPS32_SW(10,MIPS32_FASTDATA_HANDLER_SIZE - 12,15));
+		mips32_pracc_queue_instr(&queue, MIPS32_SW(11,MIPS32_FASTDATA_HANDLER_SIZE - 16,15));
+		mips32_pracc_queue_li(&queue, 8, MIPS32_PRACC_FASTDATA_AREA);	/* start of fastdata area in t0 */
+		mips32_pracc_queue_li(&queue, 9, addr);						/* start addr in t1 */
+		mips32_pracc_queue_li(&queue, 10, addr + (xfer->count - 1) * 4);	/* end addr in t2 */
+		mips32_pracc_queue_instr(&queue, MIPS32_JR(15));				/* jump to ram program */
+		mips32_pracc_queue_instr(&queue, MIPS32_NOP);
+
+		/* next access to dmseg should be in FASTDATA_AREA, check */
+		mips32_pracc_queue_expect(&queue, MIPS32_PRACC_FASTDATA_AREA, !xfer->write_t);
+	}
+
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_FASTDATA);
+
+	while (xfer->done < xfer->count)
+	{
+		int base = xfer->done;
+		int num = xfer->count - base;
+		int last;
+
+		if (num > MIPS32_FASTDATA_CHUNK_SIZE * MIPS32_FASTDATA_CHUNKS)
+			num = MIPS32_FASTDATA_CHUNK_SIZE * MIPS32_FASTDATA_CHUNKS;
+		last = (base + num == xfer->count);
+
+		xfer->failed = 0;
+
+		for (i = 0; i < num; i += MIPS32_FASTDATA_CHUNK_SIZE)
+		{
+			int j, chunk = num - i;
+
+			if (chunk > MIPS32_FASTDATA_CHUNK_SIZE)
+				chunk = MIPS32_FASTDATA_CHUNK_SIZE;
+
+			for (j = i; j < i + chunk; j++)
+				mips_ejtag_fastdata_scan(ejtag_info, xfer->write_t,
+						&xfer->buf[base + j], &xfer->spracc[j]);
+
+			jtag_add_callback4(mips32_pracc_fastdata_check, (jtag_callback_data_t)xfer,
+					i, chunk, base);
+		}
+
+		/* if everything got through, the handler is back at the debug vector */
+		if (last && ejtag_info->queued_pracc)
+		{
+			mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+			mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl, ctrl);
+			mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+			mips_ejtag_drscan_32_queued(ejtag_info, 0, address);
+			mips_ejtag_set_instr(ejtag_info, EJTAG_INST_FASTDATA);
+		}
+
+		if ((base == 0) && ejtag_info->queued_pracc)
+		{
+			retval = mips32_pracc_queue_flush(&queue);
+			mips32_pracc_queue_free(&queue);
+		}
+		else
+			retval = jtag_execute_queue();
+
+		if (retval != ERROR_OK)
+		{
+			LOG_ERROR("fastdata load failed");
+			return retval;
+		}
+
+		if (xfer->failed)
+		{
+			LOG_DEBUG("fastdata: %d of %d words accepted, processor not ready",
+					xfer->done - base, num);
+			if (xfer->write_t)
+				xfer->retry_end = xfer->done;
+		}
+
+		if (xfer->done == base)
+		{
+			if (++stalls == MIPS32_FASTDATA_MAX_RETRIES)
+			{
+				LOG_ERROR("fastdata transfer stalled at word %d of %d",
+						xfer->done, xfer->count);
+				return ERROR_JTAG_DEVICE_ERROR;
+			}
+		}
+		else
+			stalls = 0;
+	}
+
+	if (!ejtag_info->queued_pracc)
+	{
+		if ((retval = wait_for_pracc_rw(ejtag_info, &ejtag_ctrl)) != ERROR_OK)
+			return retval;
+
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+		mips_ejtag_drscan_32_queued(ejtag_info, 0, address);
+		if ((retval = jtag_execute_queue()) != ERROR_OK)
+			return retval;
+	}
+	else
+		ejtag_ctrl = buf_get_u32(ctrl, 0, 32);
+
+	if (!(ejtag_ctrl & EJTAG_CTRL_PRACC) || (ejtag_ctrl & EJTAG_CTRL_PRNW)
+			|| (buf_get_u32(address, 0, 32) != MIPS32_PRACC_TEXT))
+		LOG_ERROR("mini program did not return to start");
+
+	return ERROR_OK;
+}
+
+int mips32_pracc_fastdata_xfer(struct mips_ejtag *ejtag_info,
+								int write_t, uint32_t addr, int count, uint32_t *buf)
+{
+	uint32_t handler_code[] = {
+		/* caution when editing, table is modified below */
+		/* r15 points to the start of this code, registers are saved and
+		 * t0..t2 loaded by the jump code in mips32_pracc_fastdata_xfer_once() */
+															/* loop: */
+		/* 0 */ MIPS32_LW(11,0,0),							/* lw t3,[t8 | r9] */
+		/* 1 */ MIPS32_SW(11,0,0),							/* sw t3,[r9 | r8] */
+		MIPS32_BNE(10,9,NEG16(3)),							/* bne $t2,t1,loop */
+		MIPS32_ADDI(9,9,4),									/* addi t1,t1,4 */
+
+		MIPS32_LW(8,MIPS32_FASTDATA_HANDLER_SIZE - 4,15),
+		MIPS32_LW(9,MIPS32_FASTDATA_HANDLER_SIZE - 8,15),
+		MIPS32_LW(10,MIPS32_FASTDATA_HANDLER_SIZE - 12,15),
+		MIPS32_LW(11,MIPS32_FASTDATA_HANDLER_SIZE - 16,15),
+
+		MIPS32_LUI(15,UPPER16(MIPS32_PRACC_TEXT)),
+		MIPS32_ORI(15,15,LOWER16(MIPS32_PRACC_TEXT)),
+		MIPS32_JR(15),										/* jr start */
+		MIPS32_MFC0(15,31,0),								/* move COP0 DeSave to $15 */
+	};
+
+	struct mips32_fastdata_xfer *xfer;
+	uint32_t handler;
+	int retval, retry;
+
+	if (count <= 0)
+		return ERROR_OK;
+
+	if (write_t)
+	{
+		handler_code[0] = MIPS32_LW(11,0,8);	/* load data from probe at fastdata area */
+		handler_code[1] = MIPS32_SW(11,0,9);	/* store data to RAM @ r9 */
+	}
+	else
+	{
+		handler_code[0] = MIPS32_LW(11,0,9);	/* load data from RAM @ r9 */
+		handler_code[1] = MIPS32_SW(11,0,8);	/* store data to probe at fastdata area */
+	}
+
+	/* write program into RAM, unless it is still there from a previous call */
+	if ((retval = mips32_pracc_stub_load(ejtag_info,
+			write_t ? MIPS32_PRACC_STUB_FASTDATA_WRITE : MIPS32_PRACC_STUB_FASTDATA_READ,
+			handler_code, ARRAY_SIZE(handler_code),
+			MIPS32_FASTDATA_HANDLER_SIZE, &handler)) != ERROR_OK)
+		return retval;
+
+	LOG_DEBUG("%s using 0x%.8" PRIx32 " for %s handler", __func__, handler,
+			write_t ? "write" : "read");
+
+	xfer = malloc(sizeof(struct mips32_fastdata_xfer));
+	if (xfer == NULL)
+		return ERROR_FAIL;
+
+	xfer->write_t = write_t;
+	xfer->buf = buf;
+	xfer->count = count;
+
+	for (retry = 0; retry < MIPS32_FASTDATA_MAX_RETRIES; retry++)
+	{
+		if ((retval = mips32_pracc_fastdata_xfer_once(ejtag_info, handler, xfer, addr)) != ERROR_OK)
+			break;
+
+		/* only the words written out of place are transferred again */
+		if ((xfer->retry_start < 0) || (xfer->retry_end <= xfer->retry_start))
+			break;
+
+		LOG_DEBUG("fastdata: rewriting words %d..%d", xfer->retry_start, xfer->retry_end - 1);
+
+		addr += xfer->retry_start * 4;
+		xfer->buf += xfer->retry_start;
+		xfer->count = xfer->retry_end - xfer->retry_start;
+	}
+
+	if (retval == ERROR_OK && retry == MIPS32_FASTDATA_MAX_RETRIES)
+	{
+		LOG_ERROR("fastdata write not verified after %d retries", retry);
+		retval = ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	free(xfer);
+
+	return retval;
+}
+
+/* wait for the processor to access addr; a write is served and its data
+ * returned, anything else is left pending for the next PrAcc program */
+static int mips32_pracc_stream_wait(struct mips_ejtag *ejtag_info,
+		uint32_t addr, int write, uint32_t *data, int timeout_ms)
+{
+	long long then = timeval_ms(), cur;
+	uint32_t ejtag_ctrl, address;
+
+	for (;;)
+	{
+		ejtag_ctrl = ejtag_info->ejtag_ctrl;
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+		mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl);
+		if (ejtag_ctrl & EJTAG_CTRL_PRACC)
+			break;
+
+		cur = timeval_ms();
+		if (cur - then > 500)
+			keep_alive();
+
+		if (cur - then > timeout_ms)
+		{
+			LOG_ERROR("timed out waiting for the stream loader");
+			return ERROR_TARGET_TIMEOUT;
+		}
+	}
+
+	address = 0;
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+	mips_ejtag_drscan_32(ejtag_info, &address);
+
+	if ((((ejtag_ctrl & EJTAG_CTRL_PRNW) ? 1 : 0) != write) || (address != addr))
+	{
+		LOG_ERROR("unexpected %s at 0x%8.8" PRIx32 ", expected %s at 0x%8.8" PRIx32 "",
+				(ejtag_ctrl & EJTAG_CTRL_PRNW) ? "write" : "read", address,
+				write ? "write" : "read", addr);
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	if (!write)
+		return ERROR_OK;
+
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_DATA);
+	mips_ejtag_drscan_32(ejtag_info, data);
+
+	/* Clear the access pending bit (let the processor eat!) */
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+	mips_ejtag_drscan_32_queued(ejtag_info,
+			ejtag_info->ejtag_ctrl & ~EJTAG_CTRL_PRACC, NULL);
+	jtag_add_clocks(5);
+
+	return jtag_execute_queue();
+}
+
+/* Run a debug mode loader from RAM while streaming count words to it
+ * through the fastdata area.
+ *
+ * The loader is entered at entry with $8 pointing to the fastdata area and
+ * args in $9 onwards; $8..$14, $24 and $25 are saved in the
+ * MIPS32_PRACC_STREAM_SAVE_SIZE bytes below entry and have to be restored
+ * by the loader. It has to take the words in a tight loop, store one status
+ * word to MIPS32_PRACC_PARAM_OUT and jump back to MIPS32_PRACC_TEXT with
+ * DeSave moved to $15 in the delay slot.
+ *
+ * Whatever the loader does after the last word, e.g. waiting for flash,
+ * overlaps with the host preparing the next call.
+ *
+ * Only available with queued_pracc, callers fall back to
+ * target_run_algorithm() otherwise. */
+int mips32_pracc_fastdata_stream(struct mips_ejtag *ejtag_info, uint32_t entry,
+		int num_args, const uint32_t *args, int count, uint32_t *buf,
+		uint32_t *status, int timeout_ms)
+{
+	static const int save_regs[] = {8, 9, 10, 11, 12, 13, 14, 24, 25};
+	struct mips32_pracc_queue queue;
+	struct mips32_fastdata_xfer *xfer;
+	int retval;
+	int i;
+
+	/* the jump code and the status wait are queued PrAcc accesses */
+	if (!ejtag_info->queued_pracc)
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	if (num_args > MIPS32_PRACC_STREAM_MAX_ARGS)
+		return ERROR_INVALID_ARGUMENTS;
+
+	xfer = malloc(sizeof(struct mips32_fastdata_xfer));
+	if (xfer == NULL)
+		return ERROR_FAIL;
+
+	xfer->write_t = 1;
+	xfer->buf = buf;
+	xfer->count = count;
+	xfer->done = 0;
+	xfer->retry_start = -1;
+	xfer->retry_end = -1;
+
+	if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+	{
+		free(xfer);
+		return retval;
+	}
+
+	/* jump code: save the loader registers and load its arguments */
+	mips32_pracc_queue_li(&queue, 15, entry);
+	for (i = 0; i < (int)ARRAY_SIZE(save_regs); i++)
+		mips32_pracc_queue_instr(&queue, MIPS32_SW(save_regs[i],
+				NEG16(MIPS32_PRACC_STREAM_SAVE_SIZE - i * 4), 15));
+	mips32_pracc_queue_li(&queue, 8, MIPS32_PRACC_FASTDATA_AREA);
+	for (i = 0; i < num_args; i++)
+		mips32_pracc_queue_li(&queue, 9 + i, args[i]);
+	mips32_pracc_queue_instr(&queue, MIPS32_JR(15));				/* jump to the loader */
+	mips32_pracc_queue_instr(&queue, MIPS32_NOP);
+
+	if (count > 0)
+	{
+		/* next access to dmseg should be in FASTDATA_AREA, check */
+		mips32_pracc_queue_expect(&queue, MIPS32_PRACC_FASTDATA_AREA, 0);
+		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_FASTDATA);
+	}
+
+	do
+	{
+		int base = xfer->done;
+		int num = count - base;
+
+		if (num > MIPS32_FASTDATA_CHUNK_SIZE * MIPS32_FASTDATA_CHUNKS)
+			num = MIPS32_FASTDATA_CHUNK_SIZE * MIPS32_FASTDATA_CHUNKS;
+
+		xfer->failed = 0;
+
+		for (i = 0; i < num; i += MIPS32_FASTDATA_CHUNK_SIZE)
+		{
+			int j, chunk = num - i;
+
+			if (chunk > MIPS32_FASTDATA_CHUNK_SIZE)
+				chunk = MIPS32_FASTDATA_CHUNK_SIZE;
+
+			for (j = i; j < i + chunk; j++)
+				mips_ejtag_fastdata_scan(ejtag_info, 1,
+						&xfer->buf[base + j], &xfer->spracc[j]);
+
+			jtag_add_callback4(mips32_pracc_fastdata_check, (jtag_callback_data_t)xfer,
+					i, chunk, base);
+		}
+
+		if (base == 0)
+		{
+			retval = mips32_pracc_queue_flush(&queue);
+			mips32_pracc_queue_free(&queue);
+		}
+		else
+			retval = jtag_execute_queue();
+
+		if (retval != ERROR_OK)
+			break;
+
+		/* a word the loader was not ready for can't be sent again,
+		 * it may already have taken the following ones */
+		if (xfer->failed)
+		{
+			LOG_ERROR("stream loader not ready for word %d of %d", xfer->done, count);
+			retval = ERROR_JTAG_DEVICE_ERROR;
+			break;
+		}
+	} while (xfer->done < count);
+
+	free(xfer);
+
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* the loader reports its status, then returns to the debug vector */
+	if ((retval = mips32_pracc_stream_wait(ejtag_info, MIPS32_PRACC_PARAM_OUT,
+			1, status, timeout_ms)) != ERROR_OK)
+		return retval;
+
+	return mips32_pracc_stream_wait(ejtag_info, MIPS32_PRACC_TEXT, 0, NULL, timeout_ms);
+}
@@ -34,9 +34,33 @@
 #define MIPS32_PRACC_PARAM_OUT			(MIPS32_PRACC_PARAM_IN + MIPS32_PRACC_PARAM_IN_SIZE)
 #define MIPS32_PRACC_PARAM_OUT_SIZE		0x1000
 
-#define MIPS32_FASTDATA_HANDLER_SIZE	0x80
-#define UPPER16(uint32_t) 				(uint32_t >> 16)
-#define LOWER16(uint32_t) 				(uint32_t & 0xFFFF)
+#define MIPS32_FASTDATA_HANDLER_SIZE	0x40
+
+/* working area size that holds all PrAcc stubs at once */
+#define MIPS32_PRACC_STUB_AREA_SIZE		0x400
+
+/* routines kept resident in ejtag_info->stub_area */
+enum mips32_pracc_stub
+{
+	MIPS32_PRACC_STUB_FASTDATA_WRITE,
+	MIPS32_PRACC_STUB_FASTDATA_READ,
+	MIPS32_PRACC_STUB_READ_REGS,
+	MIPS32_PRACC_STUB_WRITE_REGS,
+	MIPS32_PRACC_STUB_READ_MEM32,
+	MIPS32_PRACC_STUB_WRITE_MEM32,
+};
+
+/* word blocks at least this long run from a resident stub; shorter than
+ * any stub, so loading a stub never goes through the stubs itself */
+#define MIPS32_PRACC_STUB_MEM_MIN_WORDS	64
+
+/* words per SPrAcc check, and checks queued per jtag queue flush */
+#define MIPS32_FASTDATA_CHUNK_SIZE		64
+#define MIPS32_FASTDATA_CHUNKS			16
+/* flushes without progress, and retransfers of misplaced words */
+#define MIPS32_FASTDATA_MAX_RETRIES		8
+#define UPPER16(uint32_t) 				((uint32_t) >> 16)
+#define LOWER16(uint32_t) 				((uint32_t) & 0xFFFF)
 #define NEG16(v) 						(((~(v)) + 1) & 0xFFFF)
 /*#define NEG18(v) (((~(v)) + 1) & 0x3FFFF)*/
 
@@ -44,14 +68,114 @@ int mips32_pracc_read_mem(struct mips_ejtag *ejtag_info,
 		uint32_t addr, int size, int count, void *buf);
 int mips32_pracc_write_mem(struct mips_ejtag *ejtag_info,
 		uint32_t addr, int size, int count, void *buf);
-int mips32_pracc_fastdata_xfer(struct mips_ejtag *ejtag_info, struct working_area *source,
+int mips32_pracc_fastdata_xfer(struct mips_ejtag *ejtag_info,
 		int write_t, uint32_t addr, int count, uint32_t *buf);
 
+/* registers $8..$14, $24, $25 saved below the entry of a stream loader */
+#define MIPS32_PRACC_STREAM_SAVE_SIZE	(9 * 4)
+/* stream loader arguments are passed in $9..$14 */
+#define MIPS32_PRACC_STREAM_MAX_ARGS	6
+
+int mips32_pracc_fastdata_stream(struct mips_ejtag *ejtag_info, uint32_t entry,
+		int num_args, const uint32_t *args, int count, uint32_t *buf,
+		uint32_t *status, int timeout_ms);
+
+void mips32_pracc_stubs_invalidate(struct mips_ejtag *ejtag_info);
+
 int mips32_pracc_read_regs(struct mips_ejtag *ejtag_info, uint32_t *regs);
 int mips32_pracc_write_regs(struct mips_ejtag *ejtag_info, uint32_t *regs);
 
+/* register sets for the masked register access, bit n is core register n */
+#define MIPS32_PRACC_REG_BIT(num)		(1ULL << (num))
+/* $15 and status, lo, hi, badvaddr, cause, pc are moved through $1 */
+#define MIPS32_PRACC_SCRATCH_REGS		(MIPS32_PRACC_REG_BIT(15) | (0x3FULL << 32))
+
+int mips32_pracc_read_regs_mask(struct mips_ejtag *ejtag_info, uint64_t mask, uint32_t *regs);
+int mips32_pracc_write_regs_mask(struct mips_ejtag *ejtag_info, uint64_t mask, uint32_t *regs);
+
 int mips32_pracc_exec(struct mips_ejtag *ejtag_info, int code_len, const uint32_t *code,
 		int num_param_in, uint32_t *param_in,
 		int num_param_out, uint32_t *param_out, int cycle);
 
+/* memory patches applied together by mips32_pracc_patch() */
+enum mips32_pracc_patch_type
+{
+	/* write value */
+	MIPS32_PRACC_PATCH_WRITE,
+	/* read the old content into orig, write value, read it back into verify */
+	MIPS32_PRACC_PATCH_INSERT,
+	/* write orig back, unless the memory no longer holds value */
+	MIPS32_PRACC_PATCH_RESTORE,
+};
+
+struct mips32_pracc_patch
+{
+	enum mips32_pracc_patch_type type;
+	uint32_t address;
+	int size;			/* 2 or 4 bytes */
+	uint32_t value;
+	uint32_t orig;
+	uint32_t verify;
+};
+
+int mips32_pracc_patch(struct mips_ejtag *ejtag_info,
+		struct mips32_pracc_patch *patch, int count);
+
+/* number of processor accesses queued before the jtag queue is flushed */
+#define MIPS32_PRACC_QUEUE_DEPTH		1024
+/* size of the dmseg text area used by queued code, PRACC_TEXT up to
+ * PRACC_PARAM_IN; straight-line code branches back to PRACC_TEXT early
+ * enough for the branch and its delay slot to fit as well */
+#define MIPS32_PRACC_QUEUE_TEXT_SIZE	0xE00
+
+struct mips32_pracc_access;
+
+/**
+ * Queued PrAcc execution of a host built, straight-line mini program.
+ *
+ * Instructions and the dmseg stores they cause are queued as a whole;
+ * the PrAcc, read/write and address status of every access is checked
+ * by jtag callbacks once the queue is flushed. Input data is loaded
+ * with immediates, so the program never has to read from dmseg.
+ */
+struct mips32_pracc_queue
+{
+	struct mips_ejtag *ejtag_info;
+
+	/* access records of the current, not yet flushed, batch */
+	struct mips32_pracc_access *access;
+	int num_access;
+
+	/* address of the next instruction fetch */
+	uint32_t text;
+
+	/* dmseg store of the last queued instruction, performed by the
+	 * core after the following instruction fetch */
+	int pending;
+	uint32_t pending_addr;
+	uint32_t *pending_dest;
+
+	/* registers saved by mips32_pracc_queue_push() */
+	uint32_t stack[32];
+	int stack_offset;
+	int stack_queued;
+
+	int retval;
+};
+
+int mips32_pracc_queue_init(struct mips32_pracc_queue *queue,
+		struct mips_ejtag *ejtag_info);
+void mips32_pracc_queue_free(struct mips32_pracc_queue *queue);
+void mips32_pracc_queue_instr(struct mips32_pracc_queue *queue, uint32_t instr);
+void mips32_pracc_queue_li(struct mips32_pracc_queue *queue, int reg, uint32_t val);
+void mips32_pracc_queue_store(struct mips32_pracc_queue *queue, uint32_t instr,
+		uint32_t addr, uint32_t *dest);
+void mips32_pracc_queue_push(struct mips32_pracc_queue *queue, int reg);
+void mips32_pracc_queue_pop(struct mips32_pracc_queue *queue, int reg);
+/* check the processor is about to access addr, without serving it */
+void mips32_pracc_queue_expect(struct mips32_pracc_queue *queue,
+		uint32_t addr, int write);
+int mips32_pracc_queue_flush(struct mips32_pracc_queue *queue);
+int mips32_pracc_queue_exec(struct mips32_pracc_queue *queue);
+
 #endif
@@ -92,7 +92,12 @@ static int mips_ejtag_get_impcode(struct mips_ejtag *ejtag_info, uint32_t *impco
 	return ERROR_OK;
 }
 
-int mips_ejtag_drscan_32(struct mips_ejtag *ejtag_info, uint32_t *data)
+/**
+ * Queue a 32 bit data register scan without flushing the jtag queue.
+ * The captured value is stored into @a in (little endian, may be NULL)
+ * once the queue gets executed, so it has to stay valid until then.
+ */
+int mips_ejtag_drscan_32_queued(struct mips_ejtag *ejtag_info, uint32_t data, uint8_t *in)
 {
 	struct jtag_tap *tap;
 	tap  = ejtag_info->tap;
@@ -100,30 +105,45 @@ int mips_ejtag_drscan_32(struct mips_ejtag *ejtag_info, uint32_t *data)
 	if (tap == NULL)
 		return ERROR_FAIL;
 	struct scan_field field;
-	uint8_t t[4], r[4];
-	int retval;
+	uint8_t t[4];
 
 	field.num_bits = 32;
 	field.out_value = t;
-	buf_set_u32(t, 0, field.num_bits, *data);
-	field.in_value = r;
+	buf_set_u32(t, 0, field.num_bits, data);
+	field.in_value = in;
 
 	jtag_add_dr_scan(tap, 1, &field, TAP_IDLE);
 
-	if ((retval = jtag_execute_queue()) != ERROR_OK)
-	{
-		LOG_ERROR("register read failed");
-		return retval;
-	}
+	return ERROR_OK;
+}
 
-	*data = buf_get_u32(field.in_value, 0, 32);
+/** Queue an 8 bit data register scan, see mips_ejtag_drscan_32_queued(). */
+int mips_ejtag_drscan_8_queued(struct mips_ejtag *ejtag_info, uint32_t data, uint8_t *in)
+{
+	struct jtag_tap *tap;
+	tap  = ejtag_info->tap;
 
-	keep_alive();
+	if (tap == NULL)
+		return ERROR_FAIL;
+	struct scan_field field;
+	uint8_t t[4] = {0, 0, 0, 0};
+
+	field.num_bits = 8;
+	field.out_value = t;
+	buf_set_u32(t, 0, field.num_bits, data);
+	field.in_value = in;
+
+	jtag_add_dr_scan(tap, 1, &field, TAP_IDLE);
 
 	return ERROR_OK;
 }
 
-int mips_ejtag_drscan_8(struct mips_ejtag *ejtag_info, uint32_t *data)
+/**
+ * Queue a scan of the PCSAMPLE register, which has to be selected already.
+ * @a num_bits is EJTAG_PCSAMPLE_LEN, or EJTAG_PCSAMPLE_NOASID_LEN when the
+ * DCR reports PCnoASID. @a in has to stay valid until the queue executes.
+ */
+int mips_ejtag_pcsample_queued(struct mips_ejtag *ejtag_info, int num_bits, uint8_t *in)
 {
 	struct jtag_tap *tap;
 	tap  = ejtag_info->tap;
@@ -131,23 +151,53 @@ int mips_ejtag_drscan_8(struct mips_ejtag *ejtag_info, uint32_t *data)
 	if (tap == NULL)
 		return ERROR_FAIL;
 	struct scan_field field;
-	uint8_t t[4] = {0, 0, 0, 0}, r[4];
-	int retval;
+	uint8_t t[(EJTAG_PCSAMPLE_LEN + 7) / 8] = {0};
 
-	field.num_bits = 8;
+	field.num_bits = num_bits;
 	field.out_value = t;
-	buf_set_u32(t, 0, field.num_bits, *data);
-	field.in_value = r;
+	field.in_value = in;
 
 	jtag_add_dr_scan(tap, 1, &field, TAP_IDLE);
 
+	return ERROR_OK;
+}
+
+int mips_ejtag_drscan_32(struct mips_ejtag *ejtag_info, uint32_t *data)
+{
+	uint8_t r[4];
+	int retval;
+
+	if ((retval = mips_ejtag_drscan_32_queued(ejtag_info, *data, r)) != ERROR_OK)
+		return retval;
+
+	if ((retval = jtag_execute_queue()) != ERROR_OK)
+	{
+		LOG_ERROR("register read failed");
+		return retval;
+	}
+
+	*data = buf_get_u32(r, 0, 32);
+
+	keep_alive();
+
+	return ERROR_OK;
+}
+
+int mips_ejtag_drscan_8(struct mips_ejtag *ejtag_info, uint32_t *data)
+{
+	uint8_t r[4] = {0, 0, 0, 0};
+	int retval;
+
+	if ((retval = mips_ejtag_drscan_8_queued(ejtag_info, *data, r)) != ERROR_OK)
+		return retval;
+
 	if ((retval = jtag_execute_queue()) != ERROR_OK)
 	{
 		LOG_ERROR("register read failed");
 		return retval;
 	}
 
-	*data = buf_get_u32(field.in_value, 0, 32);
+	*data = buf_get_u32(r, 0, 32);
 
 	keep_alive();
 
@@ -156,6 +206,24 @@ int mips_ejtag_drscan_8(struct mips_ejtag *ejtag_info, uint32_t *data)
 
 static int mips_ejtag_step_enable(struct mips_ejtag *ejtag_info)
 {
+	if (ejtag_info->queued_pracc)
+	{
+		struct mips32_pracc_queue queue;
+		int retval;
+
+		if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+			return retval;
+
+		mips32_pracc_queue_instr(&queue, MIPS32_MFC0(15,23,0));		/* move COP0 Debug to $15 */
+		mips32_pracc_queue_instr(&queue, MIPS32_ORI(15,15,0x0100));	/* set SSt bit in debug reg */
+		mips32_pracc_queue_instr(&queue, MIPS32_MTC0(15,23,0));		/* move $15 to COP0 Debug */
+
+		retval = mips32_pracc_queue_exec(&queue);
+		mips32_pracc_queue_free(&queue);
+
+		return retval;
+	}
+
 	static const uint32_t code[] = {
 			MIPS32_MTC0(1,31,0),			/* move $1 to COP0 DeSave */
 			MIPS32_MFC0(1,23,0),			/* move COP0 Debug to $1 */
@@ -173,6 +241,25 @@ static int mips_ejtag_step_enable(struct mips_ejtag *ejtag_info)
 
 static int mips_ejtag_step_disable(struct mips_ejtag *ejtag_info)
 {
+	if (ejtag_info->queued_pracc)
+	{
+		struct mips32_pracc_queue queue;
+		int retval;
+
+		if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+			return retval;
+
+		mips32_pracc_queue_instr(&queue, MIPS32_MFC0(15,23,0));		/* move COP0 Debug to $15 */
+		mips32_pracc_queue_instr(&queue, MIPS32_ORI(15,15,0x0100));	/* clear SSt bit in debug reg */
+		mips32_pracc_queue_instr(&queue, MIPS32_XORI(15,15,0x0100));
+		mips32_pracc_queue_instr(&queue, MIPS32_MTC0(15,23,0));		/* move $15 to COP0 Debug */
+
+		retval = mips32_pracc_queue_exec(&queue);
+		mips32_pracc_queue_free(&queue);
+
+		return retval;
+	}
+
 	static const uint32_t code[] = {
 			MIPS32_MTC0(15,31,0),							/* move $15 to COP0 DeSave */
 			MIPS32_LUI(15,UPPER16(MIPS32_PRACC_STACK)),		/* $15 = MIPS32_PRACC_STACK */
@@ -205,16 +292,25 @@ int mips_ejtag_config_step(struct mips_ejtag *ejtag_info, int enable_step)
 
 int mips_ejtag_enter_debug(struct mips_ejtag *ejtag_info)
 {
+	uint8_t r[4];
 	uint32_t ejtag_ctrl;
+	int retval;
+
 	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
 
 	/* set debug break bit */
-	ejtag_ctrl = ejtag_info->ejtag_ctrl | EJTAG_CTRL_JTAGBRK;
-	mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl);
+	mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl | EJTAG_CTRL_JTAGBRK, NULL);
 
 	/* break bit will be cleared by hardware */
-	ejtag_ctrl = ejtag_info->ejtag_ctrl;
-	mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl);
+	mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl, r);
+
+	if ((retval = jtag_execute_queue()) != ERROR_OK)
+	{
+		LOG_ERROR("register read failed");
+		return retval;
+	}
+
+	ejtag_ctrl = buf_get_u32(r, 0, 32);
 	LOG_DEBUG("ejtag_ctrl: 0x%8.8" PRIx32 "", ejtag_ctrl);
 	if ((ejtag_ctrl & EJTAG_CTRL_BRKST) == 0)
 		LOG_DEBUG("Failed to enter Debug Mode!");
@@ -224,17 +320,74 @@ int mips_ejtag_enter_debug(struct mips_ejtag *ejtag_info)
 
 int mips_ejtag_exit_debug(struct mips_ejtag *ejtag_info)
 {
-	uint32_t inst;
-	inst = MIPS32_DRET;
+	uint8_t ctrl[4], address[4];
+	uint32_t ejtag_ctrl;
+	int retval;
+
+	if (!ejtag_info->queued_pracc)
+	{
+		uint32_t inst;
+		inst = MIPS32_DRET;
+
+		/* execute our dret instruction */
+		return mips32_pracc_exec(ejtag_info, 1, &inst, 0, NULL, 0, NULL, 0);
+	}
+
+	/* serve the pending fetch at the debug vector with our dret instruction */
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+	mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl, ctrl);
+
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_ADDRESS);
+	mips_ejtag_drscan_32_queued(ejtag_info, 0, address);
+
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_DATA);
+	mips_ejtag_drscan_32_queued(ejtag_info, MIPS32_DRET, NULL);
+
+	/* Clear the access pending bit (let the processor eat!) */
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+	mips_ejtag_drscan_32_queued(ejtag_info, ejtag_info->ejtag_ctrl & ~EJTAG_CTRL_PRACC, NULL);
+
+	jtag_add_clocks(5);
+
+	if ((retval = jtag_execute_queue()) != ERROR_OK)
+		return retval;
 
-	/* execute our dret instruction */
-	mips32_pracc_exec(ejtag_info, 1, &inst, 0, NULL, 0, NULL, 0);
+	ejtag_ctrl = buf_get_u32(ctrl, 0, 32);
+	if (!(ejtag_ctrl & EJTAG_CTRL_PRACC) || (ejtag_ctrl & EJTAG_CTRL_PRNW))
+	{
+		LOG_DEBUG("DEBUGMODULE: No memory access in progress!");
+		return ERROR_JTAG_DEVICE_ERROR;
+	}
+
+	if (buf_get_u32(address, 0, 32) != MIPS32_PRACC_TEXT)
+		LOG_DEBUG("dret fetched from 0x%8.8" PRIx32 "", buf_get_u32(address, 0, 32));
 
 	return ERROR_OK;
 }
 
 int mips_ejtag_read_debug(struct mips_ejtag *ejtag_info, uint32_t* debug_reg)
 {
+	if (ejtag_info->queued_pracc)
+	{
+		struct mips32_pracc_queue queue;
+		int retval;
+
+		if ((retval = mips32_pracc_queue_init(&queue, ejtag_info)) != ERROR_OK)
+			return retval;
+
+		mips32_pracc_queue_push(&queue, 8);
+		mips32_pracc_queue_instr(&queue, MIPS32_MFC0(8,23,0));		/* move COP0 Debug to $8 */
+		mips32_pracc_queue_store(&queue,
+				MIPS32_SW(8,NEG16(MIPS32_PRACC_STACK-MIPS32_PRACC_PARAM_OUT),15),
+				MIPS32_PRACC_PARAM_OUT, debug_reg);
+		mips32_pracc_queue_pop(&queue, 8);
+
+		retval = mips32_pracc_queue_exec(&queue);
+		mips32_pracc_queue_free(&queue);
+
+		return retval;
+	}
+
 	/* read ejtag ECR */
 	static const uint32_t code[] = {
 			MIPS32_MTC0(15,31,0),							/* move $15 to COP0 DeSave */
@@ -300,12 +453,18 @@ int mips_ejtag_init(struct mips_ejtag *ejtag_info)
 
 	/* set initial state for ejtag control reg */
 	ejtag_info->ejtag_ctrl = EJTAG_CTRL_ROCC | EJTAG_CTRL_PRACC | EJTAG_CTRL_PROBEN | EJTAG_CTRL_SETDEV;
-	ejtag_info->fast_access_save = -1;
+	mips32_pracc_stubs_invalidate(ejtag_info);
 
 	return ERROR_OK;
 }
 
-int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t, uint32_t *data)
+/**
+ * Queue one FASTDATA scan. The SPrAcc bit captured in bit 0 of @a spracc
+ * (may be NULL) tells whether the processor actually had an access
+ * pending, i.e. whether the word was transferred.
+ */
+int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t,
+		uint32_t *data, uint8_t *spracc)
 {
 	struct jtag_tap *tap;
 	tap = ejtag_info->tap;
@@ -314,13 +473,13 @@ int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t, uint32_
 		return ERROR_FAIL;
 
 	struct scan_field fields[2];
-	uint8_t spracc = 0;
+	uint8_t spracc_out = 0;
 	uint8_t t[4] = {0, 0, 0, 0};
 
 	/* fastdata 1-bit register */
 	fields[0].num_bits = 1;
-	fields[0].out_value = &spracc;
-	fields[0].in_value = NULL;
+	fields[0].out_value = &spracc_out;
+	fields[0].in_value = spracc;
 
 	/* processor access data register 32 bit */
 	fields[1].num_bits = 32;
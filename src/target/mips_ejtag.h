@@ -38,6 +38,7 @@
 #define EJTAG_INST_TCBCONTROLA	0x10
 #define EJTAG_INST_TCBCONTROLB	0x11
 #define EJTAG_INST_TCBDATA		0x12
+#define EJTAG_INST_PCSAMPLE		0x14
 #define EJTAG_INST_BYPASS		0xFF
 
 /* microchip PIC32MX specific instructions */
@@ -109,8 +110,17 @@
 #define EJTAG_DCR_ENM			(1 << 29)
 #define EJTAG_DCR_DB			(1 << 17)
 #define EJTAG_DCR_IB			(1 << 16)
+#define EJTAG_DCR_PCNOASID		(1 << 25)
+#define EJTAG_DCR_PCS			(1 << 9)
+#define EJTAG_DCR_PCR_MASK		(7 << 6)
+#define EJTAG_DCR_PCSE			(1 << 5)
 #define EJTAG_DCR_INTE			(1 << 4)
 
+/* PCSAMPLE register, the pc sits above the optional 8 bit ASID field */
+#define EJTAG_PCSAMPLE_NEW		(1 << 0)
+#define EJTAG_PCSAMPLE_LEN		41
+#define EJTAG_PCSAMPLE_NOASID_LEN	33
+
 /* breakpoint support */
 #define EJTAG_IBS				0xFF301000
 #define EJTAG_IBA1				0xFF301100
@@ -122,13 +132,27 @@
 #define	EJTAG_DBCn_BLM_SHIFT	4
 #define	EJTAG_DBCn_BE			(1 << 0)
 
+/* number of PrAcc stubs that can be kept resident in the working area */
+#define MIPS_EJTAG_NUM_STUBS	6
+
+struct working_area;
+
 struct mips_ejtag
 {
 	struct jtag_tap *tap;
 	uint32_t impcode;
 	uint32_t idcode;
 	uint32_t ejtag_ctrl;
-	int fast_access_save;
+
+	/* working area holding resident PrAcc stubs, nulled when the target
+	 * frees its working areas (resume, reset) */
+	struct working_area *stub_area;
+	/* offset of each stub in stub_area, -1 if not loaded */
+	int stub_offset[MIPS_EJTAG_NUM_STUBS];
+	uint32_t stub_used;
+
+	/* queue complete PrAcc mini programs instead of flushing per access */
+	bool queued_pracc;
 };
 
 int mips_ejtag_set_instr(struct mips_ejtag *ejtag_info,
@@ -138,7 +162,11 @@ int mips_ejtag_exit_debug(struct mips_ejtag *ejtag_info);
 int mips_ejtag_get_idcode(struct mips_ejtag *ejtag_info, uint32_t *idcode);
 int mips_ejtag_drscan_32(struct mips_ejtag *ejtag_info, uint32_t *data);
 int mips_ejtag_drscan_8(struct mips_ejtag *ejtag_info, uint32_t *data);
-int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t, uint32_t *data);
+int mips_ejtag_drscan_32_queued(struct mips_ejtag *ejtag_info, uint32_t data, uint8_t *in);
+int mips_ejtag_drscan_8_queued(struct mips_ejtag *ejtag_info, uint32_t data, uint8_t *in);
+int mips_ejtag_fastdata_scan(struct mips_ejtag *ejtag_info, int write_t,
+		uint32_t *data, uint8_t *spracc);
+int mips_ejtag_pcsample_queued(struct mips_ejtag *ejtag_info, int num_bits, uint8_t *in);
 
 int mips_ejtag_init(struct mips_ejtag *ejtag_info);
 int mips_ejtag_config_step(struct mips_ejtag *ejtag_info, int enable_step);
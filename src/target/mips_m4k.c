@@ -31,6 +31,7 @@
 #include "mips32_dmaacc.h"
 #include "target_type.h"
 #include "register.h"
+#include <helper/time_support.h>
 
 static void mips_m4k_enable_breakpoints(struct target *target);
 static void mips_m4k_enable_watchpoints(struct target *target);
@@ -39,6 +40,135 @@ static int mips_m4k_set_breakpoint(struct target *target,
 static int mips_m4k_unset_breakpoint(struct target *target,
 		struct breakpoint *breakpoint);
 
+/* Breakpoint and watchpoint changes are collected and applied together
+ * by mips_m4k_flush_breakpoints() in one PrAcc program, before the target
+ * runs again or its memory is accessed. Without queued PrAcc support they
+ * are written right away. */
+static bool mips_m4k_bp_batched(struct target *target)
+{
+	return target_to_mips32(target)->ejtag_info.queued_pracc;
+}
+
+static int mips_m4k_bp_patch_add(struct target *target,
+		enum mips32_pracc_patch_type type, uint32_t address, int size,
+		uint32_t value, uint32_t orig, struct breakpoint *owner)
+{
+	struct mips_m4k_common *mips_m4k = target_to_m4k(target);
+	struct mips32_pracc_patch *patch;
+
+	if (mips_m4k->num_bp_patch == mips_m4k->max_bp_patch)
+	{
+		int max = mips_m4k->max_bp_patch ? (mips_m4k->max_bp_patch * 2) : 32;
+		struct mips32_pracc_patch *new_patch;
+		struct breakpoint **new_owner;
+
+		new_patch = realloc(mips_m4k->bp_patch, max * sizeof(*new_patch));
+		if (new_patch == NULL)
+			return ERROR_FAIL;
+		mips_m4k->bp_patch = new_patch;
+
+		new_owner = realloc(mips_m4k->bp_owner, max * sizeof(*new_owner));
+		if (new_owner == NULL)
+			return ERROR_FAIL;
+		mips_m4k->bp_owner = new_owner;
+
+		mips_m4k->max_bp_patch = max;
+	}
+
+	patch = &mips_m4k->bp_patch[mips_m4k->num_bp_patch];
+	patch->type = type;
+	patch->address = address;
+	patch->size = size;
+	patch->value = value;
+	patch->orig = orig;
+	patch->verify = 0;
+	mips_m4k->bp_owner[mips_m4k->num_bp_patch++] = owner;
+
+	return ERROR_OK;
+}
+
+/* drop the pending insertion of a software breakpoint, if any */
+static bool mips_m4k_bp_patch_cancel(struct target *target,
+		struct breakpoint *breakpoint)
+{
+	struct mips_m4k_common *mips_m4k = target_to_m4k(target);
+	int i, tail;
+
+	for (i = 0; i < mips_m4k->num_bp_patch; i++)
+	{
+		if (mips_m4k->bp_owner[i] != breakpoint)
+			continue;
+
+		tail = mips_m4k->num_bp_patch - i - 1;
+		memmove(&mips_m4k->bp_patch[i], &mips_m4k->bp_patch[i + 1],
+				tail * sizeof(*mips_m4k->bp_patch));
+		memmove(&mips_m4k->bp_owner[i], &mips_m4k->bp_owner[i + 1],
+				tail * sizeof(*mips_m4k->bp_owner));
+		mips_m4k->num_bp_patch--;
+		return true;
+	}
+
+	return false;
+}
+
+/* write a break unit register */
+static int mips_m4k_write_bu_reg(struct target *target, uint32_t address, uint32_t value)
+{
+	if (mips_m4k_bp_batched(target))
+		return mips_m4k_bp_patch_add(target, MIPS32_PRACC_PATCH_WRITE,
+				address, 4, value, 0, NULL);
+
+	return target_write_u32(target, address, value);
+}
+
+/* apply all pending breakpoint and watchpoint changes, and verify the
+ * inserted software breakpoints */
+static int mips_m4k_flush_breakpoints(struct target *target)
+{
+	struct mips_m4k_common *mips_m4k = target_to_m4k(target);
+	struct mips_ejtag *ejtag_info = &mips_m4k->mips32.ejtag_info;
+	int retval, i;
+
+	if ((mips_m4k->num_bp_patch == 0) || (target->state != TARGET_HALTED))
+		return ERROR_OK;
+
+	LOG_DEBUG("applying %d breakpoint changes", mips_m4k->num_bp_patch);
+
+	retval = mips32_pracc_patch(ejtag_info, mips_m4k->bp_patch, mips_m4k->num_bp_patch);
+	if (retval != ERROR_OK)
+	{
+		LOG_ERROR("failed to apply %d breakpoint changes", mips_m4k->num_bp_patch);
+		mips_m4k->num_bp_patch = 0;
+		return retval;
+	}
+
+	for (i = 0; i < mips_m4k->num_bp_patch; i++)
+	{
+		struct mips32_pracc_patch *patch = &mips_m4k->bp_patch[i];
+		struct breakpoint *breakpoint = mips_m4k->bp_owner[i];
+
+		if (breakpoint == NULL)
+			continue;
+
+		/* original instruction is kept in target endianness */
+		if (patch->size == 4)
+			target_buffer_set_u32(target, breakpoint->orig_instr, patch->orig);
+		else
+			target_buffer_set_u16(target, breakpoint->orig_instr, patch->orig);
+
+		if (patch->verify != patch->value)
+		{
+			LOG_ERROR("Unable to set %dbit breakpoint at address %08" PRIx32
+					" - check that memory is read/writable",
+					patch->size * 8, breakpoint->address);
+		}
+	}
+
+	mips_m4k->num_bp_patch = 0;
+
+	return ERROR_OK;
+}
+
 static int mips_m4k_examine_debug_reason(struct target *target)
 {
 	uint32_t break_status;
@@ -128,10 +258,9 @@ static int mips_m4k_poll(struct target *target)
 	{
 		/* we have detected a reset, clear flag
 		 * otherwise ejtag will not work */
-		ejtag_ctrl = ejtag_info->ejtag_ctrl & ~EJTAG_CTRL_ROCC;
-
 		mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
-		mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl);
+		mips_ejtag_drscan_32_queued(ejtag_info,
+				ejtag_info->ejtag_ctrl & ~EJTAG_CTRL_ROCC, NULL);
 		LOG_DEBUG("Reset Detected");
 	}
 
@@ -254,27 +383,23 @@ static int mips_m4k_assert_reset(struct target *target)
 	{
 		if (mips_m4k->is_pic32mx)
 		{
-			uint32_t mchip_cmd;
-
 			LOG_DEBUG("Using MTAP reset to reset processor...");
 
 			/* use microchip specific MTAP reset */
 			mips_ejtag_set_instr(ejtag_info, MTAP_SW_MTAP);
 			mips_ejtag_set_instr(ejtag_info, MTAP_COMMAND);
 
-			mchip_cmd = MCHP_ASERT_RST;
-			mips_ejtag_drscan_8(ejtag_info, &mchip_cmd);
-			mchip_cmd = MCHP_DE_ASSERT_RST;
-			mips_ejtag_drscan_8(ejtag_info, &mchip_cmd);
+			mips_ejtag_drscan_8_queued(ejtag_info, MCHP_ASERT_RST, NULL);
+			mips_ejtag_drscan_8_queued(ejtag_info, MCHP_DE_ASSERT_RST, NULL);
 			mips_ejtag_set_instr(ejtag_info, MTAP_SW_ETAP);
 		}
 		else
 		{
 			/* use ejtag reset - not supported by all cores */
-			uint32_t ejtag_ctrl = ejtag_info->ejtag_ctrl | EJTAG_CTRL_PRRST | EJTAG_CTRL_PERRST;
 			LOG_DEBUG("Using EJTAG reset (PRRST) to reset processor...");
 			mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
-			mips_ejtag_drscan_32(ejtag_info, &ejtag_ctrl);
+			mips_ejtag_drscan_32_queued(ejtag_info,
+					ejtag_info->ejtag_ctrl | EJTAG_CTRL_PRRST | EJTAG_CTRL_PERRST, NULL);
 		}
 	}
 
@@ -336,6 +461,7 @@ static int mips_m4k_resume(struct target *target, int current,
 	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
 	struct breakpoint *breakpoint = NULL;
 	uint32_t resume_pc;
+	int retval;
 
 	if (target->state != TARGET_HALTED)
 	{
@@ -374,11 +500,17 @@ static int mips_m4k_resume(struct target *target, int current,
 		{
 			LOG_DEBUG("unset breakpoint at 0x%8.8" PRIx32 "", breakpoint->address);
 			mips_m4k_unset_breakpoint(target, breakpoint);
+			if ((retval = mips_m4k_flush_breakpoints(target)) != ERROR_OK)
+				return retval;
 			mips_m4k_single_step_core(target);
 			mips_m4k_set_breakpoint(target, breakpoint);
 		}
 	}
 
+	/* all breakpoint changes in one go */
+	if ((retval = mips_m4k_flush_breakpoints(target)) != ERROR_OK)
+		return retval;
+
 	/* enable interrupts if we are running */
 	mips32_enable_interrupts(target, !debug_execution);
 
@@ -412,6 +544,7 @@ static int mips_m4k_step(struct target *target, int current,
 	struct mips32_common *mips32 = target_to_mips32(target);
 	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
 	struct breakpoint *breakpoint = NULL;
+	int retval;
 
 	if (target->state != TARGET_HALTED)
 	{
@@ -431,6 +564,9 @@ static int mips_m4k_step(struct target *target, int current,
 			mips_m4k_unset_breakpoint(target, breakpoint);
 	}
 
+	if ((retval = mips_m4k_flush_breakpoints(target)) != ERROR_OK)
+		return retval;
+
 	/* restore context */
 	mips32_restore_context(target);
 
@@ -502,9 +638,9 @@ static int mips_m4k_set_breakpoint(struct target *target,
 		breakpoint->set = bp_num + 1;
 		comparator_list[bp_num].used = 1;
 		comparator_list[bp_num].bp_value = breakpoint->address;
-		target_write_u32(target, comparator_list[bp_num].reg_address, comparator_list[bp_num].bp_value);
-		target_write_u32(target, comparator_list[bp_num].reg_address + 0x08, 0x00000000);
-		target_write_u32(target, comparator_list[bp_num].reg_address + 0x18, 1);
+		mips_m4k_write_bu_reg(target, comparator_list[bp_num].reg_address, comparator_list[bp_num].bp_value);
+		mips_m4k_write_bu_reg(target, comparator_list[bp_num].reg_address + 0x08, 0x00000000);
+		mips_m4k_write_bu_reg(target, comparator_list[bp_num].reg_address + 0x18, 1);
 		LOG_DEBUG("bpid: %d, bp_num %i bp_value 0x%" PRIx32 "",
 				  breakpoint->unique_id,
 				  bp_num, comparator_list[bp_num].bp_value);
@@ -512,7 +648,18 @@ static int mips_m4k_set_breakpoint(struct target *target,
 	else if (breakpoint->type == BKPT_SOFT)
 	{
 		LOG_DEBUG("bpid: %d", breakpoint->unique_id );
-		if (breakpoint->length == 4)
+		if (mips_m4k_bp_batched(target))
+		{
+			/* inserted and verified by mips_m4k_flush_breakpoints() */
+			if ((retval = mips_m4k_bp_patch_add(target, MIPS32_PRACC_PATCH_INSERT,
+					breakpoint->address, breakpoint->length,
+					(breakpoint->length == 4) ? MIPS32_SDBBP : MIPS16_SDBBP,
+					0, breakpoint)) != ERROR_OK)
+			{
+				return retval;
+			}
+		}
+		else if (breakpoint->length == 4)
 		{
 			uint32_t verify = 0xffffffff;
 
@@ -595,14 +742,32 @@ static int mips_m4k_unset_breakpoint(struct target *target,
 				  bp_num );
 		comparator_list[bp_num].used = 0;
 		comparator_list[bp_num].bp_value = 0;
-		target_write_u32(target, comparator_list[bp_num].reg_address + 0x18, 0);
+		mips_m4k_write_bu_reg(target, comparator_list[bp_num].reg_address + 0x18, 0);
 
 	}
 	else
 	{
 		/* restore original instruction (kept in target endianness) */
 		LOG_DEBUG("bpid: %d", breakpoint->unique_id);
-		if (breakpoint->length == 4)
+		if (mips_m4k_bp_batched(target))
+		{
+			/* not on the target yet, or restored unless the user program
+			 * has modified the breakpoint instruction */
+			if (!mips_m4k_bp_patch_cancel(target, breakpoint))
+			{
+				if ((retval = mips_m4k_bp_patch_add(target, MIPS32_PRACC_PATCH_RESTORE,
+						breakpoint->address, breakpoint->length,
+						(breakpoint->length == 4) ? MIPS32_SDBBP : MIPS16_SDBBP,
+						(breakpoint->length == 4) ?
+							target_buffer_get_u32(target, breakpoint->orig_instr) :
+							target_buffer_get_u16(target, breakpoint->orig_instr),
+						NULL)) != ERROR_OK)
+				{
+					return retval;
+				}
+			}
+		}
+		else if (breakpoint->length == 4)
 		{
 			uint32_t current_instr;
 
@@ -746,11 +911,11 @@ static int mips_m4k_set_watchpoint(struct target *target,
 	watchpoint->set = wp_num + 1;
 	comparator_list[wp_num].used = 1;
 	comparator_list[wp_num].bp_value = watchpoint->address;
-	target_write_u32(target, comparator_list[wp_num].reg_address, comparator_list[wp_num].bp_value);
-	target_write_u32(target, comparator_list[wp_num].reg_address + 0x08, 0x00000000);
-	target_write_u32(target, comparator_list[wp_num].reg_address + 0x10, 0x00000000);
-	target_write_u32(target, comparator_list[wp_num].reg_address + 0x18, enable);
-	target_write_u32(target, comparator_list[wp_num].reg_address + 0x20, 0);
+	mips_m4k_write_bu_reg(target, comparator_list[wp_num].reg_address, comparator_list[wp_num].bp_value);
+	mips_m4k_write_bu_reg(target, comparator_list[wp_num].reg_address + 0x08, 0x00000000);
+	mips_m4k_write_bu_reg(target, comparator_list[wp_num].reg_address + 0x10, 0x00000000);
+	mips_m4k_write_bu_reg(target, comparator_list[wp_num].reg_address + 0x18, enable);
+	mips_m4k_write_bu_reg(target, comparator_list[wp_num].reg_address + 0x20, 0);
 	LOG_DEBUG("wp_num %i bp_value 0x%" PRIx32 "", wp_num, comparator_list[wp_num].bp_value);
 
 	return ERROR_OK;
@@ -777,7 +942,7 @@ static int mips_m4k_unset_watchpoint(struct target *target,
 	}
 	comparator_list[wp_num].used = 0;
 	comparator_list[wp_num].bp_value = 0;
-	target_write_u32(target, comparator_list[wp_num].reg_address + 0x18, 0);
+	mips_m4k_write_bu_reg(target, comparator_list[wp_num].reg_address + 0x18, 0);
 	watchpoint->set = 0;
 
 	return ERROR_OK;
@@ -839,6 +1004,7 @@ static int mips_m4k_read_memory(struct target *target, uint32_t address,
 {
 	struct mips32_common *mips32 = target_to_mips32(target);
 	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	int retval;
 
 	LOG_DEBUG("address: 0x%8.8" PRIx32 ", size: 0x%8.8" PRIx32 ", count: 0x%8.8" PRIx32 "", address, size, count);
 
@@ -848,6 +1014,10 @@ static int mips_m4k_read_memory(struct target *target, uint32_t address,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* keep pending breakpoint changes ordered with this access */
+	if ((retval = mips_m4k_flush_breakpoints(target)) != ERROR_OK)
+		return retval;
+
 	/* sanitize arguments */
 	if (((size != 4) && (size != 2) && (size != 1)) || (count == 0) || !(buffer))
 		return ERROR_INVALID_ARGUMENTS;
@@ -856,7 +1026,6 @@ static int mips_m4k_read_memory(struct target *target, uint32_t address,
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
 	/* if noDMA off, use DMAACC mode for memory read */
-	int retval;
 	if (ejtag_info->impcode & EJTAG_IMP_NODMA)
 		retval = mips32_pracc_read_mem(ejtag_info, address, size, count, (void *)buffer);
 	else
@@ -872,6 +1041,7 @@ static int mips_m4k_write_memory(struct target *target, uint32_t address,
 {
 	struct mips32_common *mips32 = target_to_mips32(target);
 	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	int retval;
 
 	LOG_DEBUG("address: 0x%8.8" PRIx32 ", size: 0x%8.8" PRIx32 ", count: 0x%8.8" PRIx32 "",
 			address, size, count);
@@ -882,6 +1052,10 @@ static int mips_m4k_write_memory(struct target *target, uint32_t address,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	/* keep pending breakpoint changes ordered with this access */
+	if ((retval = mips_m4k_flush_breakpoints(target)) != ERROR_OK)
+		return retval;
+
 	/* sanitize arguments */
 	if (((size != 4) && (size != 2) && (size != 1)) || (count == 0) || !(buffer))
 		return ERROR_INVALID_ARGUMENTS;
@@ -927,6 +1101,18 @@ static int mips_m4k_target_create(struct target *target, Jim_Interp *interp)
 	return ERROR_OK;
 }
 
+static void mips_m4k_deinit_target(struct target *target)
+{
+	struct mips_m4k_common *mips_m4k = target_to_m4k(target);
+
+	free(mips_m4k->bp_patch);
+	mips_m4k->bp_patch = NULL;
+	free(mips_m4k->bp_owner);
+	mips_m4k->bp_owner = NULL;
+	mips_m4k->num_bp_patch = 0;
+	mips_m4k->max_bp_patch = 0;
+}
+
 static int mips_m4k_examine(struct target *target)
 {
 	int retval;
@@ -959,6 +1145,40 @@ static int mips_m4k_examine(struct target *target)
 	return ERROR_OK;
 }
 
+static int mips_m4k_get_fast_data_area(struct target *target)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	int retval;
+
+	if (ejtag_info->stub_area != NULL)
+		return ERROR_OK;
+
+	/* Get memory for the PrAcc stubs (fastdata handlers, register access)
+	 * we preserve this area between calls, so the stubs are downloaded once
+	 * this will be released/nulled by the system when the target is resumed or reset */
+	retval = target_alloc_working_area_try(target,
+			MIPS32_PRACC_STUB_AREA_SIZE,
+			&ejtag_info->stub_area);
+	if (retval != ERROR_OK)
+	{
+		/* a small area still fits one fastdata handler at a time */
+		retval = target_alloc_working_area_try(target,
+				MIPS32_FASTDATA_HANDLER_SIZE,
+				&ejtag_info->stub_area);
+		if (retval != ERROR_OK)
+		{
+			LOG_DEBUG("no working area for the PrAcc stubs");
+			return retval;
+		}
+	}
+
+	/* the area is new, so are its contents */
+	mips32_pracc_stubs_invalidate(ejtag_info);
+
+	return ERROR_OK;
+}
+
 static int mips_m4k_bulk_write_memory(struct target *target, uint32_t address,
 		uint32_t count, uint8_t *buffer)
 {
@@ -975,27 +1195,17 @@ static int mips_m4k_bulk_write_memory(struct target *target, uint32_t address,
 		return ERROR_TARGET_NOT_HALTED;
 	}
 
+	if ((retval = mips_m4k_flush_breakpoints(target)) != ERROR_OK)
+		return retval;
+
 	/* check alignment */
 	if (address & 0x3u)
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
-	if (mips32->fast_data_area == NULL)
+	if (mips_m4k_get_fast_data_area(target) != ERROR_OK)
 	{
-		/* Get memory for block write handler
-		 * we preserve this area between calls and gain a speed increase
-		 * of about 3kb/sec when writing flash
-		 * this will be released/nulled by the system when the target is resumed or reset */
-		retval = target_alloc_working_area(target,
-				MIPS32_FASTDATA_HANDLER_SIZE,
-				&mips32->fast_data_area);
-		if (retval != ERROR_OK)
-		{
-			LOG_WARNING("No working area available, falling back to non-bulk write");
-			return mips_m4k_write_memory(target, address, 4, count, buffer);
-		}
-
-		/* reset fastadata state so the algo get reloaded */
-		ejtag_info->fast_access_save = -1;
+		LOG_WARNING("No working area available, falling back to non-bulk write");
+		return mips_m4k_write_memory(target, address, 4, count, buffer);
 	}
 
 	/* TAP data register is loaded LSB first (little endian) */
@@ -1009,7 +1219,7 @@ static int mips_m4k_bulk_write_memory(struct target *target, uint32_t address,
 		}
 	}
 
-	retval = mips32_pracc_fastdata_xfer(ejtag_info, mips32->fast_data_area, write_t, address,
+	retval = mips32_pracc_fastdata_xfer(ejtag_info, write_t, address,
 			count, (uint32_t*) (void *)buffer);
 	if (retval != ERROR_OK)
 	{
@@ -1021,6 +1231,249 @@ static int mips_m4k_bulk_write_memory(struct target *target, uint32_t address,
 	return retval;
 }
 
+static int mips_m4k_bulk_read_memory(struct target *target, uint32_t address,
+		uint32_t count, uint8_t *buffer)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	int retval;
+	int write_t = 0;
+
+	LOG_DEBUG("address: 0x%8.8" PRIx32 ", count: 0x%8.8" PRIx32 "", address, count);
+
+	if (target->state != TARGET_HALTED)
+	{
+		LOG_WARNING("target not halted");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if ((retval = mips_m4k_flush_breakpoints(target)) != ERROR_OK)
+		return retval;
+
+	/* check alignment */
+	if (address & 0x3u)
+		return ERROR_TARGET_UNALIGNED_ACCESS;
+
+	if (mips_m4k_get_fast_data_area(target) != ERROR_OK)
+	{
+		LOG_WARNING("No working area available, falling back to non-bulk read");
+		return mips_m4k_read_memory(target, address, 4, count, buffer);
+	}
+
+	while (count > 0)
+	{
+		/* limit the number of scans queued per transfer */
+		uint32_t blocksize = count;
+		if (blocksize > MIPS_M4K_BULK_READ_BLOCK)
+			blocksize = MIPS_M4K_BULK_READ_BLOCK;
+
+		retval = mips32_pracc_fastdata_xfer(ejtag_info, write_t, address,
+				blocksize, (uint32_t*) (void *)buffer);
+		if (retval != ERROR_OK)
+		{
+			/* FASTDATA access failed, try normal memory read */
+			LOG_DEBUG("Fastdata access Failed, falling back to non-bulk read");
+			return mips_m4k_read_memory(target, address, 4, count, buffer);
+		}
+
+		/* TAP data register is unloaded LSB first (little endian) */
+		if (target->endianness == TARGET_BIG_ENDIAN)
+		{
+			uint32_t i, t32;
+			for(i = 0; i < (blocksize * 4); i += 4)
+			{
+				t32 = le_to_h_u32(&buffer[i]);
+				h_u32_to_be(&buffer[i], t32);
+			}
+		}
+
+		count -= blocksize;
+		address += blocksize * 4;
+		buffer += blocksize * 4;
+	}
+
+	return ERROR_OK;
+}
+
+/* put the DCR back, halting and resuming the target around it if it runs */
+static int mips_m4k_profiling_restore(struct target *target, uint32_t dcr)
+{
+	int resume = 0;
+	int retval;
+
+	if (target->state != TARGET_HALTED)
+	{
+		if ((retval = target_halt(target)) != ERROR_OK)
+			return retval;
+		if ((retval = target_wait_state(target, TARGET_HALTED, 1000)) != ERROR_OK)
+			return retval;
+		resume = 1;
+	}
+
+	retval = target_write_u32(target, EJTAG_DCR, dcr);
+
+	if (resume)
+	{
+		int resume_retval = target_resume(target, 1, 0, 0, 0);
+		if (retval == ERROR_OK)
+			retval = resume_retval;
+	}
+
+	return retval;
+}
+
+/* Profile with the EJTAG PCSAMPLE register: the core samples its pc
+ * while running and the samples are scanned out back to back, without
+ * ever halting the core after the DCR has been set up. Samples are kept
+ * in a ring, so a long run keeps the most recent max_num_samples. */
+static int mips_m4k_profiling(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples,
+		uint32_t *sample_rate, uint32_t seconds)
+{
+	struct mips32_common *mips32 = target_to_mips32(target);
+	struct mips_ejtag *ejtag_info = &mips32->ejtag_info;
+	uint8_t (*scans)[(EJTAG_PCSAMPLE_LEN + 7) / 8];
+	uint32_t orig_dcr, dcr, total = 0, stale = 0;
+	int num_bits, i;
+	long long then, elapsed;
+	int retval, restore_retval;
+
+	if (target->state == TARGET_RUNNING)
+	{
+		/* the DCR is only accessible in debug mode */
+		if ((retval = target_halt(target)) != ERROR_OK)
+			return retval;
+		if ((retval = target_wait_state(target, TARGET_HALTED, 1000)) != ERROR_OK)
+			return retval;
+	}
+	if (target->state != TARGET_HALTED)
+	{
+		LOG_WARNING("target not halted or running");
+		return ERROR_TARGET_NOT_HALTED;
+	}
+
+	if ((retval = target_read_u32(target, EJTAG_DCR, &orig_dcr)) != ERROR_OK)
+		return retval;
+
+	if (!(orig_dcr & EJTAG_DCR_PCS))
+	{
+		LOG_INFO("core has no PC sampling, halting and resuming instead");
+		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+	}
+
+	num_bits = (orig_dcr & EJTAG_DCR_PCNOASID) ?
+			EJTAG_PCSAMPLE_NOASID_LEN : EJTAG_PCSAMPLE_LEN;
+
+	scans = malloc(MIPS_M4K_PCSAMPLE_BATCH * sizeof(*scans));
+	if (scans == NULL)
+		return ERROR_FAIL;
+
+	/* sample at the highest rate, every 2^5 cycles */
+	dcr = (orig_dcr & ~EJTAG_DCR_PCR_MASK) | EJTAG_DCR_PCSE;
+	if ((retval = target_write_u32(target, EJTAG_DCR, dcr)) != ERROR_OK)
+	{
+		free(scans);
+		mips_m4k_profiling_restore(target, orig_dcr);
+		return retval;
+	}
+
+	if ((retval = target_resume(target, 1, 0, 0, 0)) != ERROR_OK)
+	{
+		free(scans);
+		mips_m4k_profiling_restore(target, orig_dcr);
+		return retval;
+	}
+
+	LOG_INFO("Starting profiling, sampling the pc through EJTAG PCSAMPLE...");
+
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_PCSAMPLE);
+
+	then = timeval_ms();
+	while ((timeval_ms() - then) < (long long)seconds * 1000)
+	{
+		for (i = 0; i < MIPS_M4K_PCSAMPLE_BATCH; i++)
+			mips_ejtag_pcsample_queued(ejtag_info, num_bits, scans[i]);
+
+		if ((retval = jtag_execute_queue()) != ERROR_OK)
+			break;
+
+		for (i = 0; i < MIPS_M4K_PCSAMPLE_BATCH; i++)
+		{
+			/* the core has not taken a new sample since the last scan */
+			if (!(scans[i][0] & EJTAG_PCSAMPLE_NEW))
+			{
+				stale++;
+				continue;
+			}
+
+			samples[total % max_num_samples] = buf_get_u32(scans[i], num_bits - 32, 32);
+			total++;
+		}
+
+		keep_alive();
+	}
+	elapsed = timeval_ms() - then;
+
+	free(scans);
+
+	/* leave the ejtag tap the way the rest of the code expects it */
+	mips_ejtag_set_instr(ejtag_info, EJTAG_INST_CONTROL);
+
+	/* stop sampling, the target is left running */
+	restore_retval = mips_m4k_profiling_restore(target, orig_dcr);
+	if (retval == ERROR_OK)
+		retval = restore_retval;
+	if (retval != ERROR_OK)
+		return retval;
+
+	LOG_INFO("%" PRIu32 " pc samples, %" PRIu32 " scans without a new sample",
+			total, stale);
+
+	*sample_rate = (elapsed > 0) ? (uint32_t)((total * 1000LL) / elapsed) : total;
+	if (*sample_rate == 0)
+		*sample_rate = 1;
+
+	if (total > max_num_samples)
+	{
+		/* the ring wrapped, rotate the oldest sample to the front */
+		uint32_t first = total % max_num_samples;
+
+		LOG_INFO("sample buffer wrapped, keeping the last %" PRIu32 " of %" PRIu32 " samples",
+				max_num_samples, total);
+
+		if (first != 0)
+		{
+			uint32_t *head = malloc(first * sizeof(uint32_t));
+
+			if (head == NULL)
+			{
+				LOG_ERROR("not enough memory to order the pc samples");
+				return ERROR_FAIL;
+			}
+
+			memcpy(head, samples, first * sizeof(uint32_t));
+			memmove(samples, samples + first,
+					(max_num_samples - first) * sizeof(uint32_t));
+			memcpy(samples + max_num_samples - first, head,
+					first * sizeof(uint32_t));
+			free(head);
+		}
+
+		total = max_num_samples;
+	}
+
+	*num_samples = total;
+
+	return ERROR_OK;
+}
+
+static const struct command_registration mips_m4k_command_handlers[] = {
+	{
+		.chain = mips32_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 struct target_type mips_m4k_target =
 {
 	.name = "mips_m4k",
@@ -1043,17 +1496,22 @@ struct target_type mips_m4k_target =
 	.read_memory = mips_m4k_read_memory,
 	.write_memory = mips_m4k_write_memory,
 	.bulk_write_memory = mips_m4k_bulk_write_memory,
+	.bulk_read_memory = mips_m4k_bulk_read_memory,
 	.checksum_memory = mips32_checksum_memory,
 	.blank_check_memory = mips32_blank_check_memory,
 
 	.run_algorithm = mips32_run_algorithm,
 
+	.profiling = mips_m4k_profiling,
+
 	.add_breakpoint = mips_m4k_add_breakpoint,
 	.remove_breakpoint = mips_m4k_remove_breakpoint,
 	.add_watchpoint = mips_m4k_add_watchpoint,
 	.remove_watchpoint = mips_m4k_remove_watchpoint,
 
+	.commands = mips_m4k_command_handlers,
 	.target_create = mips_m4k_target_create,
 	.init_target = mips_m4k_init_target,
+	.deinit_target = mips_m4k_deinit_target,
 	.examine = mips_m4k_examine,
 };
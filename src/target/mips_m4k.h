@@ -29,11 +29,24 @@ struct target;
 
 #define MIPSM4K_COMMON_MAGIC	0xB321B321
 
+/* words read per fastdata transfer, bounds the memory used by the jtag queue */
+#define MIPS_M4K_BULK_READ_BLOCK	0x4000
+
+/* PCSAMPLE scans queued per jtag_execute_queue() while profiling */
+#define MIPS_M4K_PCSAMPLE_BATCH		256
+
 struct mips_m4k_common
 {
 	int common_magic;
 	bool is_pic32mx;
 	struct mips32_common mips32;
+
+	/* breakpoint and watchpoint changes not yet applied to the target,
+	 * bp_owner is the software breakpoint an insertion belongs to */
+	struct mips32_pracc_patch *bp_patch;
+	struct breakpoint **bp_owner;
+	int num_bp_patch;
+	int max_bp_patch;
 };
 
 static inline struct mips_m4k_common *
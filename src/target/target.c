@@ -568,6 +568,12 @@ static int default_check_reset(struct target *target)
 	return ERROR_OK;
 }
 
+static int default_bulk_read_memory(struct target *target,
+		uint32_t address, uint32_t count, uint8_t *buffer)
+{
+	return target_read_memory(target, address, 4, count, buffer);
+}
+
 int target_examine_one(struct target *target)
 {
 	return target->type->examine(target);
@@ -720,6 +726,12 @@ int target_bulk_write_memory(struct target *target,
 	return target->type->bulk_write_memory(target, address, count, buffer);
 }
 
+int target_bulk_read_memory(struct target *target,
+		uint32_t address, uint32_t count, uint8_t *buffer)
+{
+	return target->type->bulk_read_memory(target, address, count, buffer);
+}
+
 int target_add_breakpoint(struct target *target,
 		struct breakpoint *breakpoint)
 {
@@ -801,6 +813,9 @@ static int target_init_one(struct command_context *cmd_ctx,
 	if (type->check_reset== NULL)
 		type->check_reset = default_check_reset;
 
+	if (type->bulk_read_memory == NULL)
+		type->bulk_read_memory = default_bulk_read_memory;
+
 	int retval = type->init_target(cmd_ctx, target);
 	if (ERROR_OK != retval)
 	{
@@ -1309,6 +1324,17 @@ void target_free_all_working_areas(struct target *target)
 	target_free_all_working_areas_restore(target, 1);
 }
 
+void target_quit(void)
+{
+	struct target *target;
+
+	for (target = all_targets; target; target = target->next)
+	{
+		if (target->type->deinit_target)
+			target->type->deinit_target(target);
+	}
+}
+
 int target_arch_state(struct target *target)
 {
 	int retval;
@@ -1464,8 +1490,17 @@ int target_read_buffer(struct target *target, uint32_t address, uint32_t size, u
 	{
 		int aligned = size - (size % 4);
 
-		if ((retval = target_read_memory(target, address, 4, aligned / 4, buffer)) != ERROR_OK)
-			return retval;
+		/* use bulk reads above a certain limit, same as for writes */
+		if (aligned > 128)
+		{
+			if ((retval = target_bulk_read_memory(target, address, aligned / 4, buffer)) != ERROR_OK)
+				return retval;
+		}
+		else
+		{
+			if ((retval = target_read_memory(target, address, 4, aligned / 4, buffer)) != ERROR_OK)
+				return retval;
+		}
 
 		buffer += aligned;
 		address += aligned;
@@ -2770,16 +2805,16 @@ static COMMAND_HELPER(handle_verify_image_command_internal, int verify)
 				}
 
 				data = (uint8_t*)malloc(buf_cnt);
-
-				/* Can we use 32bit word accesses? */
-				int size = 1;
-				int count = buf_cnt;
-				if ((count % 4) == 0)
+				if (data == NULL)
 				{
-					size *= 4;
-					count /= 4;
+					LOG_ERROR("not enough memory");
+					free(buffer);
+					retval = ERROR_FAIL;
+					break;
 				}
-				retval = target_read_memory(target, image.sections[i].base_address, size, count, data);
+
+				/* word and bulk accesses for the aligned part */
+				retval = target_read_buffer(target, image.sections[i].base_address, buf_cnt, data);
 				if (retval == ERROR_OK)
 				{
 					uint32_t t;
@@ -3065,7 +3100,8 @@ static void writeString(FILE *f, char *s)
 }
 
 /* Dump a gmon.out histogram file. */
-static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filename)
+static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filename,
+		uint32_t sampleRate)
 {
 	uint32_t i;
 	FILE *f = fopen(filename, "w");
@@ -3124,7 +3160,7 @@ static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filenam
 	writeLong(f, min); 			/* low_pc */
 	writeLong(f, max);			/* high_pc */
 	writeLong(f, length);		/* # of samples */
-	writeLong(f, 100); 			/* KLUDGE! We lie, ca. 100Hz best case. */
+	writeLong(f, sampleRate);	/* samples per second */
 	writeString(f, "seconds");
 	for (i = 0; i < (15-strlen("seconds")); i++)
 		writeData(f, &zero, 1);
@@ -3157,48 +3193,42 @@ static void writeGmon(uint32_t *samples, uint32_t sampleNum, const char *filenam
 	fclose(f);
 }
 
+/* Dump the samples as they were taken, as little endian 32 bit words. */
+static void writeRawSamples(uint32_t *samples, uint32_t sampleNum, const char *filename)
+{
+	uint32_t i;
+	FILE *f = fopen(filename, "w");
+	if (f == NULL)
+		return;
+	for (i = 0; i < sampleNum; i++)
+		writeLong(f, samples[i]);
+	fclose(f);
+}
+
 /* profiling samples the CPU PC as quickly as OpenOCD is able,
  * which will be used as a random sampling of PC */
-COMMAND_HANDLER(handle_profile_command)
+static int target_profiling_default(struct target *target, uint32_t *samples,
+		uint32_t max_num_samples, uint32_t *num_samples, uint32_t seconds)
 {
-	struct target *target = get_current_target(CMD_CTX);
 	struct timeval timeout, now;
+	uint32_t sample_count = 0;
+	int retval = ERROR_OK;
 
 	gettimeofday(&timeout, NULL);
-	if (CMD_ARGC != 2)
-	{
-		return ERROR_COMMAND_SYNTAX_ERROR;
-	}
-	unsigned offset;
-	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], offset);
+	timeval_add_time(&timeout, seconds, 0);
 
-	timeval_add_time(&timeout, offset, 0);
+	LOG_INFO("Starting profiling. Halting and resuming the target as often as we can...");
 
-	/**
-	 * @todo: Some cores let us sample the PC without the
-	 * annoying halt/resume step; for example, ARMv7 PCSR.
-	 * Provide a way to use that more efficient mechanism.
-	 */
-
-	command_print(CMD_CTX, "Starting profiling. Halting and resuming the target as often as we can...");
-
-	static const int maxSample = 10000;
-	uint32_t *samples = malloc(sizeof(uint32_t)*maxSample);
-	if (samples == NULL)
-		return ERROR_OK;
-
-	int numSamples = 0;
 	/* hopefully it is safe to cache! We want to stop/restart as quickly as possible. */
 	struct reg *reg = register_get_by_name(target->reg_cache, "pc", 1);
 
 	for (;;)
 	{
-		int retval;
 		target_poll(target);
 		if (target->state == TARGET_HALTED)
 		{
 			uint32_t t=*((uint32_t *)reg->value);
-			samples[numSamples++]=t;
+			samples[sample_count++]=t;
 			retval = target_resume(target, 1, 0, 0, 0); /* current pc, addr = 0, do not handle breakpoints, not debugging */
 			target_poll(target);
 			alive_sleep(10); /* sleep 10ms, i.e. <100 samples/second. */
@@ -3206,13 +3236,10 @@ COMMAND_HANDLER(handle_profile_command)
 		{
 			/* We want to quickly sample the PC. */
 			if ((retval = target_halt(target)) != ERROR_OK)
-			{
-				free(samples);
 				return retval;
-			}
 		} else
 		{
-			command_print(CMD_CTX, "Target not halted or running");
+			LOG_INFO("Target not halted or running");
 			retval = ERROR_OK;
 			break;
 		}
@@ -3222,28 +3249,76 @@ COMMAND_HANDLER(handle_profile_command)
 		}
 
 		gettimeofday(&now, NULL);
-		if ((numSamples >= maxSample) || ((now.tv_sec >= timeout.tv_sec) && (now.tv_usec >= timeout.tv_usec)))
+		if ((sample_count >= max_num_samples) || ((now.tv_sec >= timeout.tv_sec) && (now.tv_usec >= timeout.tv_usec)))
 		{
-			command_print(CMD_CTX, "Profiling completed. %d samples.", numSamples);
 			if ((retval = target_poll(target)) != ERROR_OK)
-			{
-				free(samples);
 				return retval;
-			}
 			if (target->state == TARGET_HALTED)
 			{
 				target_resume(target, 1, 0, 0, 0); /* current pc, addr = 0, do not handle breakpoints, not debugging */
 			}
 			if ((retval = target_poll(target)) != ERROR_OK)
-			{
-				free(samples);
 				return retval;
-			}
-			writeGmon(samples, numSamples, CMD_ARGV[1]);
-			command_print(CMD_CTX, "Wrote %s", CMD_ARGV[1]);
 			break;
 		}
 	}
+
+	*num_samples = sample_count;
+	return retval;
+}
+
+COMMAND_HANDLER(handle_profile_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	uint32_t *samples;
+	uint32_t max_num_samples, num_samples = 0, sample_rate;
+	int retval = ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
+
+	if ((CMD_ARGC != 2) && (CMD_ARGC != 3))
+	{
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	unsigned offset;
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], offset);
+
+	/* sampling without halting the target is much faster, keep more */
+	max_num_samples = target->type->profiling ? (1024 * 1024) : 10000;
+	samples = malloc(sizeof(uint32_t) * max_num_samples);
+	if (samples == NULL)
+		return ERROR_OK;
+
+	if (target->type->profiling)
+	{
+		retval = target->type->profiling(target, samples, max_num_samples,
+				&num_samples, &sample_rate, offset);
+		if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+			max_num_samples = 10000;
+	}
+	if (retval == ERROR_TARGET_RESOURCE_NOT_AVAILABLE)
+	{
+		sample_rate = 100; /* KLUDGE! We lie, ca. 100Hz best case. */
+		retval = target_profiling_default(target, samples, max_num_samples,
+				&num_samples, offset);
+	}
+
+	if (retval != ERROR_OK)
+	{
+		free(samples);
+		return retval;
+	}
+
+	command_print(CMD_CTX, "Profiling completed. %" PRIu32 " samples.", num_samples);
+	if (num_samples > 0)
+	{
+		writeGmon(samples, num_samples, CMD_ARGV[1], sample_rate);
+		command_print(CMD_CTX, "Wrote %s", CMD_ARGV[1]);
+
+		if (CMD_ARGC == 3)
+		{
+			writeRawSamples(samples, num_samples, CMD_ARGV[2]);
+			command_print(CMD_CTX, "Wrote %s", CMD_ARGV[2]);
+		}
+	}
 	free(samples);
 
 	return ERROR_OK;
@@ -3386,7 +3461,7 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 	/* index counter */
 	n = 0;
 
-	size_t buffersize = 4096;
+	size_t buffersize = 32768;
 	uint8_t *buffer = malloc(buffersize);
 	if (buffer == NULL)
 		return JIM_ERR;
@@ -3401,7 +3476,12 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 			count = (buffersize/width);
 		}
 
-		retval = target_read_memory(target, addr, width, count, buffer);
+		/* word reads can go through the bulk path; narrower
+		 * widths keep their access size for peripheral registers */
+		if (width == 4)
+			retval = target_read_buffer(target, addr, count * width, buffer);
+		else
+			retval = target_read_memory(target, addr, width, count, buffer);
 		if (retval != ERROR_OK) {
 			/* BOO !*/
 			LOG_ERROR("mem2array: Read @ 0x%08x, w=%d, cnt=%d, failed",
@@ -3429,6 +3509,7 @@ static int target_mem2array(Jim_Interp *interp, struct target *target, int argc,
 				new_int_array_element(interp, varname, n, v);
 			}
 			len -= count;
+			addr += count * width;
 		}
 	}
 
@@ -5192,6 +5273,7 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.handler = handle_profile_command,
 		.mode = COMMAND_EXEC,
 		.help = "profiling samples the CPU PC",
+		.usage = "seconds gmon_filename [raw_filename]",
 	},
 	/** @todo don't register virt2phys() unless target supports it */
 	{
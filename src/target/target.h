@@ -415,6 +415,16 @@ int target_write_memory(struct target *target,
 int target_bulk_write_memory(struct target *target,
 		uint32_t address, uint32_t count, uint8_t *buffer);
 
+/**
+ * Read @a count items of 4 bytes from the memory of @a target at
+ * the @a address given.  Because it operates only on whole words,
+ * this should be faster than target_read_memory().
+ *
+ * This routine is wrapper for target->type->bulk_read_memory.
+ */
+int target_bulk_read_memory(struct target *target,
+		uint32_t address, uint32_t count, uint8_t *buffer);
+
 /*
  * Write to target memory using the virtual address.
  *
@@ -476,6 +486,9 @@ int target_alloc_working_area_try(struct target *target,
 int target_free_working_area(struct target *target, struct working_area *area);
 void target_free_all_working_areas(struct target *target);
 
+/** Let the targets free their private data before exiting. */
+void target_quit(void);
+
 extern struct target *all_targets;
 
 uint32_t target_buffer_get_u32(struct target *target, const uint8_t *buffer);
@@ -125,6 +125,13 @@ struct target_type
 	 * function directly, use target_bulk_write_memory() instead.
 	 */
 	int (*bulk_write_memory)(struct target *target, uint32_t address, uint32_t count, uint8_t *buffer);
+	/**
+	 * Read target memory in multiples of 4 bytes, optimized for
+	 * reading large quantities of data.  Optional; defaults to
+	 * read_memory() with a size of 4.  Do @b not call this
+	 * function directly, use target_bulk_read_memory() instead.
+	 */
+	int (*bulk_read_memory)(struct target *target, uint32_t address, uint32_t count, uint8_t *buffer);
 
 	int (*checksum_memory)(struct target *target, uint32_t address, uint32_t count, uint32_t* checksum);
 	int (*blank_check_memory)(struct target *target, uint32_t address, uint32_t count, uint32_t* blank);
@@ -201,6 +208,12 @@ struct target_type
 	 * */
 	int (*init_target)(struct command_context *cmd_ctx, struct target *target);
 
+	/* Free what the target allocated for itself, on exit.
+	 *
+	 * Optional. It is illegal to talk to the target at this stage.
+	 * */
+	void (*deinit_target)(struct target *target);
+
 	/* translate from virtual to physical address. Default implementation is successful
 	 * no-op(i.e. virtual==physical).
 	 */
@@ -230,6 +243,19 @@ struct target_type
 	 * circumstances.
 	 */
 	int (*check_reset)(struct target *target);
+
+	/**
+	 * Sample the pc of the running target for @a seconds without
+	 * halting it, e.g. through a hardware pc sampling register.
+	 * Optional; the profile command halts and resumes the target when
+	 * this is NULL or returns ERROR_TARGET_RESOURCE_NOT_AVAILABLE.
+	 * At most @a max_num_samples samples are returned, oldest first;
+	 * @a sample_rate is the number of samples per second actually taken,
+	 * which also covers samples dropped when the buffer was full.
+	 */
+	int (*profiling)(struct target *target, uint32_t *samples,
+			uint32_t max_num_samples, uint32_t *num_samples,
+			uint32_t *sample_rate, uint32_t seconds);
 };
 
 #endif // TARGET_TYPE_H